@@ -0,0 +1,543 @@
+/*      $Id$
+
+        This program is free software; you can redistribute it and/or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation; either version 2, or (at your option)
+        any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program; if not, write to the Free Software
+        Foundation, Inc., Inc., 51 Franklin Street, Fifth Floor, Boston,
+        MA 02110-1301, USA.
+
+        xfwm4    - (c) 2002-2011 Olivier Fourdan
+
+ */
+
+/*
+ * Synthetic load for the compositor benchmark.
+ *
+ * Maps a number of opaque and ARGB windows, damages them following a
+ * scripted pattern at a fixed rate and, given the pid of xfwm4, reads
+ * the compositor counters before and after the run to report what it
+ * cost the window manager.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <X11/X.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SCROLL_STEP     16
+#define CURSOR_WIDTH    2
+#define CURSOR_HEIGHT   16
+#define RESIZE_STEPS    64
+#define STATS_TIMEOUT   5
+
+typedef enum
+{
+    PATTERN_IDLE = 0,
+    PATTERN_VIDEO,
+    PATTERN_SCROLL,
+    PATTERN_BLINK
+} Pattern;
+
+typedef struct _BenchWindow BenchWindow;
+struct _BenchWindow
+{
+    Window id;
+    GC gc;
+    int argb;
+    unsigned int width;
+    unsigned int height;
+};
+
+typedef struct _Stats Stats;
+struct _Stats
+{
+    long frames;
+    long frame_time;
+    long shadows_built;
+    long shadow_time;
+    long cpu_time;
+    long requests;
+    long wm_cpu_time;
+};
+
+static const char *pattern_names[] = { "idle", "video", "scroll", "blink" };
+
+static void
+usage (const char *name)
+{
+    fprintf (stderr,
+             "Usage: %s [options]\n"
+             "  -n <count>   number of windows (default 10)\n"
+             "  -a <count>   how many of them use an ARGB visual (default 0)\n"
+             "  -g <WxH>     window size (default 400x300)\n"
+             "  -p <name>    damage pattern: idle, video, scroll or blink (default video)\n"
+             "  -u <count>   windows updated per tick, round robin (default all)\n"
+             "  -r <rate>    ticks per second (default 60)\n"
+             "  -t <secs>    duration of the run (default 10)\n"
+             "  -R           resize the updated windows on each tick\n"
+             "  -P <pid>     pid of xfwm4, to report its compositor counters\n",
+             name);
+}
+
+static double
+now_seconds (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sleep_until (double deadline)
+{
+    struct timespec ts;
+    double delay;
+
+    delay = deadline - now_seconds ();
+    if (delay <= 0)
+    {
+        return;
+    }
+    ts.tv_sec = (time_t) delay;
+    ts.tv_nsec = (long) ((delay - ts.tv_sec) * 1e9);
+    while ((nanosleep (&ts, &ts) != 0) && (errno == EINTR));
+}
+
+static unsigned long
+make_pixel (BenchWindow *bw, unsigned int tick)
+{
+    unsigned long r, g, b;
+
+    r = (tick * 7) & 0xff;
+    g = (tick * 13 + 85) & 0xff;
+    b = (tick * 29 + 170) & 0xff;
+    if (bw->argb)
+    {
+        /* Half transparent, premultiplied */
+        return (0x80UL << 24) | ((r >> 1) << 16) | ((g >> 1) << 8) | (b >> 1);
+    }
+
+    return (r << 16) | (g << 8) | b;
+}
+
+static long
+get_wm_cpu_time (pid_t pid)
+{
+    char path[64];
+    char buf[1024];
+    char *p;
+    unsigned long utime, stime;
+    FILE *f;
+    size_t len;
+
+    /* Linux only, utime and stime are fields 14 and 15 of /proc/<pid>/stat */
+    snprintf (path, sizeof (path), "/proc/%d/stat", (int) pid);
+    f = fopen (path, "r");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    len = fread (buf, 1, sizeof (buf) - 1, f);
+    fclose (f);
+    buf[len] = '\0';
+
+    /* The command name may contain spaces, skip past it */
+    p = strrchr (buf, ')');
+    if ((p == NULL) ||
+        (sscanf (p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                 &utime, &stime) != 2))
+    {
+        return -1;
+    }
+
+    return (long) ((utime + stime) * 1000000ULL / sysconf (_SC_CLK_TCK));
+}
+
+static int
+read_stats (Display *dpy, pid_t pid, Stats *stats)
+{
+    Atom stats_atom, poke_atom, type;
+    Window root;
+    XEvent ev;
+    unsigned char *data;
+    unsigned long nitems, bytes_after;
+    long *values;
+    long buckets;
+    int format;
+    double deadline;
+
+    root = DefaultRootWindow (dpy);
+    stats_atom = XInternAtom (dpy, "_XFWM4_COMPOSITOR_STATS", False);
+    poke_atom = XInternAtom (dpy, "_XFWM4_BENCH", False);
+
+    XSelectInput (dpy, root, PropertyChangeMask);
+    XSync (dpy, False);
+    while (XCheckTypedWindowEvent (dpy, root, PropertyNotify, &ev));
+
+    /* xfwm4 dumps its counters once idle, the property change wakes it up */
+    stats->wm_cpu_time = get_wm_cpu_time (pid);
+    kill (pid, SIGUSR2);
+    XChangeProperty (dpy, root, poke_atom, XA_CARDINAL, 32, PropModeReplace,
+                     (unsigned char *) &stats->wm_cpu_time, 1);
+    XFlush (dpy);
+
+    deadline = now_seconds () + STATS_TIMEOUT;
+    for (;;)
+    {
+        if (XCheckTypedWindowEvent (dpy, root, PropertyNotify, &ev) &&
+            (ev.xproperty.atom == stats_atom))
+        {
+            break;
+        }
+        if (now_seconds () > deadline)
+        {
+            fprintf (stderr, "No compositor statistics from pid %d\n", (int) pid);
+            return 0;
+        }
+        sleep_until (now_seconds () + 0.01);
+    }
+    XSelectInput (dpy, root, NoEventMask);
+
+    data = NULL;
+    if ((XGetWindowProperty (dpy, root, stats_atom, 0, 1024, False, XA_CARDINAL,
+                             &type, &format, &nitems, &bytes_after, &data) != Success) ||
+        (data == NULL) || (format != 32) || (nitems < 14))
+    {
+        if (data)
+        {
+            XFree (data);
+        }
+        return 0;
+    }
+
+    /* See dump_screen_stats() in src/compositor.c for the layout */
+    values = (long *) data;
+    buckets = values[13];
+    stats->frames = values[0];
+    stats->frame_time = values[1];
+    stats->shadows_built = values[6];
+    stats->cpu_time = (nitems > (unsigned long) (16 + buckets)) ? values[16 + buckets] : 0;
+    stats->requests = (nitems > (unsigned long) (17 + buckets)) ? values[17 + buckets] : 0;
+    stats->shadow_time = (nitems > (unsigned long) (18 + buckets)) ? values[18 + buckets] : 0;
+    XFree (data);
+
+    return 1;
+}
+
+static void
+report_stats (Stats *before, Stats *after, double elapsed)
+{
+    long frames;
+    long shadows;
+
+    frames = after->frames - before->frames;
+    shadows = after->shadows_built - before->shadows_built;
+    printf ("frames=%ld fps=%.1f", frames, frames / elapsed);
+    if (frames > 0)
+    {
+        printf (" paint_us_per_frame=%ld cpu_us_per_frame=%ld requests_per_frame=%.1f",
+                (after->frame_time - before->frame_time) / frames,
+                (after->cpu_time - before->cpu_time) / frames,
+                (double) (after->requests - before->requests) / frames);
+    }
+    if ((before->wm_cpu_time >= 0) && (after->wm_cpu_time >= 0))
+    {
+        printf (" wm_cpu_pct=%.1f",
+                (after->wm_cpu_time - before->wm_cpu_time) / (elapsed * 10000.0));
+    }
+    printf (" shadows_built=%ld", shadows);
+    if (shadows > 0)
+    {
+        printf (" shadow_us_per_build=%.1f",
+                (double) (after->shadow_time - before->shadow_time) / shadows);
+    }
+}
+
+static void
+update_window (Display *dpy, BenchWindow *bw, Pattern pattern, unsigned int tick)
+{
+    XSetForeground (dpy, bw->gc, make_pixel (bw, tick));
+    switch (pattern)
+    {
+        case PATTERN_VIDEO:
+            XFillRectangle (dpy, bw->id, bw->gc, 0, 0, bw->width, bw->height);
+            break;
+        case PATTERN_SCROLL:
+            if (bw->height > SCROLL_STEP)
+            {
+                XCopyArea (dpy, bw->id, bw->id, bw->gc, 0, SCROLL_STEP,
+                           bw->width, bw->height - SCROLL_STEP, 0, 0);
+            }
+            XFillRectangle (dpy, bw->id, bw->gc, 0, (int) bw->height - SCROLL_STEP,
+                            bw->width, SCROLL_STEP);
+            break;
+        case PATTERN_BLINK:
+            if (tick & 1)
+            {
+                XSetForeground (dpy, bw->gc, bw->argb ? 0xff000000UL : 0);
+            }
+            XFillRectangle (dpy, bw->id, bw->gc, 8, 8, CURSOR_WIDTH, CURSOR_HEIGHT);
+            break;
+        default:
+            break;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    Display *dpy;
+    BenchWindow *windows;
+    XSetWindowAttributes attrs;
+    XVisualInfo argb_visual;
+    XSizeHints hints;
+    XGCValues gcv;
+    XEvent ev;
+    Colormap argb_colormap;
+    Pattern pattern;
+    Stats before, after;
+    Window root;
+    char name[64];
+    unsigned int width, height;
+    unsigned int tick, next;
+    double rate, duration;
+    double start, elapsed;
+    int count, argb_count, update_count;
+    int screen_width, screen_height;
+    int resize, mapped, have_stats;
+    int i, opt;
+    pid_t pid;
+
+    count = 10;
+    argb_count = 0;
+    update_count = -1;
+    width = 400;
+    height = 300;
+    pattern = PATTERN_VIDEO;
+    rate = 60.0;
+    duration = 10.0;
+    resize = 0;
+    pid = 0;
+
+    while ((opt = getopt (argc, argv, "n:a:g:p:u:r:t:RP:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                count = atoi (optarg);
+                break;
+            case 'a':
+                argb_count = atoi (optarg);
+                break;
+            case 'g':
+                if (sscanf (optarg, "%ux%u", &width, &height) != 2)
+                {
+                    usage (argv[0]);
+                    return 1;
+                }
+                break;
+            case 'p':
+                for (i = 0; i < (int) (sizeof (pattern_names) / sizeof (pattern_names[0])); i++)
+                {
+                    if (!strcmp (optarg, pattern_names[i]))
+                    {
+                        break;
+                    }
+                }
+                if (i == (int) (sizeof (pattern_names) / sizeof (pattern_names[0])))
+                {
+                    usage (argv[0]);
+                    return 1;
+                }
+                pattern = (Pattern) i;
+                break;
+            case 'u':
+                update_count = atoi (optarg);
+                break;
+            case 'r':
+                rate = atof (optarg);
+                break;
+            case 't':
+                duration = atof (optarg);
+                break;
+            case 'R':
+                resize = 1;
+                break;
+            case 'P':
+                pid = (pid_t) atoi (optarg);
+                break;
+            default:
+                usage (argv[0]);
+                return 1;
+        }
+    }
+    if ((count < 1) || (width < 1) || (height < 1) || (rate <= 0.0) || (duration <= 0.0))
+    {
+        usage (argv[0]);
+        return 1;
+    }
+    if ((update_count < 0) || (update_count > count))
+    {
+        update_count = count;
+    }
+
+    dpy = XOpenDisplay (NULL);
+    if (dpy == NULL)
+    {
+        fprintf (stderr, "Cannot open display\n");
+        return 1;
+    }
+    root = DefaultRootWindow (dpy);
+    screen_width = DisplayWidth (dpy, DefaultScreen (dpy));
+    screen_height = DisplayHeight (dpy, DefaultScreen (dpy));
+
+    argb_colormap = None;
+    if (argb_count > 0)
+    {
+        if (!XMatchVisualInfo (dpy, DefaultScreen (dpy), 32, TrueColor, &argb_visual))
+        {
+            fprintf (stderr, "No ARGB visual, using opaque windows only\n");
+            argb_count = 0;
+        }
+        else
+        {
+            argb_colormap = XCreateColormap (dpy, root, argb_visual.visual, AllocNone);
+        }
+    }
+
+    /* Cascade the windows so that they overlap like on a busy desktop */
+    windows = calloc (count, sizeof (BenchWindow));
+    for (i = 0; i < count; i++)
+    {
+        BenchWindow *bw = &windows[i];
+        int x, y;
+
+        bw->argb = (i < argb_count);
+        bw->width = width;
+        bw->height = height;
+        x = (screen_width > (int) width) ? (i * 37) % (screen_width - width) : 0;
+        y = (screen_height > (int) height) ? (i * 29) % (screen_height - height) : 0;
+
+        attrs.background_pixel = 0;
+        attrs.border_pixel = 0;
+        attrs.event_mask = StructureNotifyMask;
+        if (bw->argb)
+        {
+            attrs.colormap = argb_colormap;
+            bw->id = XCreateWindow (dpy, root, x, y, width, height, 0,
+                                    32, InputOutput, argb_visual.visual,
+                                    CWBackPixel | CWBorderPixel | CWColormap | CWEventMask,
+                                    &attrs);
+        }
+        else
+        {
+            bw->id = XCreateWindow (dpy, root, x, y, width, height, 0,
+                                    CopyFromParent, InputOutput, CopyFromParent,
+                                    CWBackPixel | CWBorderPixel | CWEventMask, &attrs);
+        }
+        snprintf (name, sizeof (name), "xfwm4-bench %s %i", bw->argb ? "argb" : "opaque", i);
+        XStoreName (dpy, bw->id, name);
+        /* Same layout on every run, whatever the placement policy */
+        hints.flags = USPosition;
+        hints.x = x;
+        hints.y = y;
+        XSetWMNormalHints (dpy, bw->id, &hints);
+
+        gcv.graphics_exposures = False;
+        bw->gc = XCreateGC (dpy, bw->id, GCGraphicsExposures, &gcv);
+        XMapWindow (dpy, bw->id);
+    }
+
+    /* Wait for all the windows to show up, then let the compositor settle */
+    mapped = 0;
+    while (mapped < count)
+    {
+        XNextEvent (dpy, &ev);
+        if (ev.type == MapNotify)
+        {
+            mapped++;
+        }
+    }
+    for (i = 0; i < count; i++)
+    {
+        update_window (dpy, &windows[i], PATTERN_VIDEO, 0);
+    }
+    XSync (dpy, False);
+    sleep_until (now_seconds () + 1.0);
+
+    have_stats = (pid > 0) && read_stats (dpy, pid, &before);
+
+    start = now_seconds ();
+    next = 0;
+    for (tick = 0; now_seconds () - start < duration; tick++)
+    {
+        for (i = 0; i < update_count; i++)
+        {
+            BenchWindow *bw = &windows[next];
+
+            if (resize)
+            {
+                /* Each new size needs a new shadow */
+                bw->width = width + tick % RESIZE_STEPS;
+                bw->height = height + tick % RESIZE_STEPS;
+                XResizeWindow (dpy, bw->id, bw->width, bw->height);
+            }
+            update_window (dpy, bw, pattern, tick);
+            next = (next + 1) % count;
+        }
+        XSync (dpy, False);
+        while (XPending (dpy))
+        {
+            XNextEvent (dpy, &ev);
+        }
+        sleep_until (start + (tick + 1) / rate);
+    }
+    elapsed = now_seconds () - start;
+
+    printf ("windows=%i argb=%i size=%ux%u pattern=%s ticks=%u elapsed=%.2f",
+            count, argb_count, width, height, pattern_names[pattern], tick, elapsed);
+    /* Give the compositor the time to paint the last damage */
+    sleep_until (now_seconds () + 0.2);
+    if (have_stats && read_stats (dpy, pid, &after))
+    {
+        printf (" ");
+        report_stats (&before, &after, elapsed);
+    }
+    printf ("\n");
+
+    for (i = 0; i < count; i++)
+    {
+        XFreeGC (dpy, windows[i].gc);
+        XDestroyWindow (dpy, windows[i].id);
+    }
+    free (windows);
+    if (argb_colormap)
+    {
+        XFreeColormap (dpy, argb_colormap);
+    }
+    XCloseDisplay (dpy);
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+#!/bin/sh
+#
+# Compositor benchmark, runs xfwm4 on a virtual X server once per vblank
+# method and scenario, and prints what each run cost the compositor.
+#
+# Usage: xfwm4-bench.sh [scenario...]
+#
+# Environment:
+#   XFWM4       xfwm4 binary to test (default ../src/xfwm4)
+#   BASELINE    another xfwm4 binary, run after XFWM4 with the same load
+#               to compare against (default none)
+#   CLIENT      load generator (default ./xfwm4-bench-client)
+#   SERVER      "xvfb", or "xephyr" to measure Present against the host
+#   METHODS     vblank methods to compare (default "off glx-scene xpresent")
+#   DURATION    length of each run in seconds (default 10)
+#   GEOMETRY    screen size (default 1920x1080)
+#   BENCH_DISPLAY  display number to use (default 99)
+#
+# "off" paints with XRender, "glx-scene" with GL (llvmpipe on Xvfb) and
+# "xpresent" with XRender and Present.
+#
+# Runs use their own, default, settings. Scenarios that need other values
+# set them with xfconf-query when it is available.
+
+XFWM4=${XFWM4:-../src/xfwm4}
+BASELINE=${BASELINE:-}
+CLIENT=${CLIENT:-./xfwm4-bench-client}
+SERVER=${SERVER:-xvfb}
+METHODS=${METHODS:-"off glx-scene xpresent"}
+DURATION=${DURATION:-10}
+GEOMETRY=${GEOMETRY:-1920x1080}
+BENCH_DISPLAY=${BENCH_DISPLAY:-99}
+
+SCENARIOS=${*:-"scroll video blink desktop"}
+
+# Never read nor touch the settings of the session
+if [ -z "$_BENCH_CONFIG_HOME" ]; then
+    _BENCH_CONFIG_HOME=$(mktemp -d) || exit 1
+    XDG_CONFIG_HOME=$_BENCH_CONFIG_HOME
+    export _BENCH_CONFIG_HOME XDG_CONFIG_HOME
+fi
+
+# xfwm4 reads its settings from xfconf, which needs a session bus
+if [ -z "$DBUS_SESSION_BUS_ADDRESS" ] && command -v dbus-run-session >/dev/null; then
+    exec dbus-run-session -- sh "$0" "$@"
+fi
+
+scenario_args ()
+{
+    case "$1" in
+        # A terminal scrolling, a few translucent ones around
+        scroll) echo "-n 8 -a 2 -g 800x600 -p scroll -u 1 -r 60" ;;
+        # Full window damage at video rate
+        video)  echo "-n 4 -a 1 -g 1280x720 -p video -r 60" ;;
+        # Mostly idle desktop with blinking cursors
+        blink)  echo "-n 20 -a 4 -g 640x480 -p blink -r 2" ;;
+        # 50 overlapping windows, a few of them busy, to count requests per frame
+        desktop|desktop-translucent)
+                echo "-n 50 -a 10 -g 640x480 -p scroll -u 3 -r 30" ;;
+        # Windows of the given size resized on each tick, each size needs a new shadow
+        shadow-*)
+                echo "-n 4 -g ${1#shadow-} -p idle -R -r 30" ;;
+        *)      return 1 ;;
+    esac
+}
+
+# "shadows" times the full shadow builds, from tooltips to menu bars and
+# side panels. Windows with both sides over the gaussian size (36 pixels
+# with the default radius) use the nine slice shadows instead, built once
+# per opacity, so they are left out.
+expand_scenarios ()
+{
+    for scenario in "$@"; do
+        case "$scenario" in
+            shadows)
+                echo "shadow-16x16 shadow-32x32 shadow-120x24 shadow-640x24 shadow-24x480" ;;
+            *)
+                echo "$scenario" ;;
+        esac
+    done
+}
+
+# Settings for the scenario, as "property type value" lines
+scenario_settings ()
+{
+    case "$1" in
+        # Translucent frames take the separate frame composite path
+        desktop-translucent) echo "/general/frame_opacity int 80" ;;
+    esac
+}
+
+apply_settings ()
+{
+    if ! command -v xfconf-query >/dev/null; then
+        return
+    fi
+    xfconf-query -c xfwm4 -p /general -r -R 2>/dev/null
+    scenario_settings "$1" | while read -r property type value; do
+        xfconf-query -c xfwm4 -p "$property" -n -t "$type" -s "$value"
+    done
+}
+
+wait_for ()
+{
+    tries=50
+    while ! "$@" >/dev/null 2>&1; do
+        tries=$((tries - 1))
+        if [ $tries -le 0 ]; then
+            return 1
+        fi
+        sleep 0.1
+    done
+}
+
+start_server ()
+{
+    case "$SERVER" in
+        xvfb)
+            Xvfb ":$BENCH_DISPLAY" -screen 0 "${GEOMETRY}x24" -nolisten tcp \
+                 +extension GLX +extension Composite >/dev/null 2>&1 &
+            ;;
+        xephyr)
+            Xephyr ":$BENCH_DISPLAY" -screen "$GEOMETRY" -ac -nolisten tcp >/dev/null 2>&1 &
+            ;;
+        *)
+            echo "Unknown server $SERVER" >&2
+            return 1
+            ;;
+    esac
+    server_pid=$!
+    wait_for xprop -display ":$BENCH_DISPLAY" -root
+}
+
+wm_running ()
+{
+    xprop -display ":$BENCH_DISPLAY" -root _NET_SUPPORTING_WM_CHECK | grep -q "window id"
+}
+
+stop ()
+{
+    [ -n "$wm_pid" ] && kill "$wm_pid" 2>/dev/null && wait "$wm_pid" 2>/dev/null
+    [ -n "$server_pid" ] && kill "$server_pid" 2>/dev/null && wait "$server_pid" 2>/dev/null
+    wm_pid=
+    server_pid=
+}
+
+cleanup ()
+{
+    stop
+    rm -rf "$_BENCH_CONFIG_HOME"
+}
+
+trap cleanup EXIT INT TERM
+
+# One run of xfwm4 binary $1 with vblank method $2 on scenario $3, sets
+# result to what the load generator reported
+run ()
+{
+    if ! start_server; then
+        echo "Cannot start $SERVER on :$BENCH_DISPLAY" >&2
+        stop
+        exit 1
+    fi
+    apply_settings "$3"
+    DISPLAY=":$BENCH_DISPLAY" "$1" --compositor=on --vblank="$2" >/dev/null 2>&1 &
+    wm_pid=$!
+    if ! wait_for wm_running; then
+        echo "$1 did not start on :$BENCH_DISPLAY" >&2
+        stop
+        exit 1
+    fi
+    # shellcheck disable=SC2086
+    result=$(DISPLAY=":$BENCH_DISPLAY" "$CLIENT" $args -t "$DURATION" -P "$wm_pid")
+    stop
+}
+
+# shellcheck disable=SC2086
+for scenario in $(expand_scenarios $SCENARIOS); do
+    if ! args=$(scenario_args "$scenario"); then
+        echo "Unknown scenario $scenario" >&2
+        exit 1
+    fi
+    for method in $METHODS; do
+        run "$XFWM4" "$method" "$scenario"
+        if [ -z "$BASELINE" ]; then
+            printf "%-10s %-10s %s\n" "$scenario" "$method" "$result"
+            continue
+        fi
+        printf "%-10s %-10s %-8s %s\n" "$scenario" "$method" "test" "$result"
+        run "$BASELINE" "$method" "$scenario"
+        printf "%-10s %-10s %-8s %s\n" "$scenario" "$method" "baseline" "$result"
+    done
+done
@@ -262,6 +262,7 @@ clientUpdateName (Client *c)
 
     if (refresh)
     {
+        frameClearTitleLayout (c);
         frameQueueDraw (c, TRUE);
     }
 }
@@ -871,6 +872,8 @@ clientConfigure (Client *c, XWindowChanges * wc, unsigned long mask, unsigned sh
     c->applied_geometry.y = c->y;
     c->applied_geometry.width = c->width;
     c->applied_geometry.height = c->height;
+
+    clientUpdatePlacementRect (c);
 }
 
 void
@@ -1355,10 +1358,7 @@ clientFree (Client *c)
     {
         g_source_remove (c->icon_timeout_id);
     }
-    if (c->frame_timeout_id)
-    {
-        g_source_remove (c->frame_timeout_id);
-    }
+    frameClearQueueDraw (c);
     if (c->ping_timeout_id)
     {
         clientRemoveNetWMPing (c);
@@ -1379,6 +1379,7 @@ clientFree (Client *c)
         g_free (c->startup_id);
     }
 #endif /* HAVE_LIBSTARTUP_NOTIFICATION */
+    frameClearTitleLayout (c);
     if (c->name)
     {
         g_free (c->name);
@@ -1614,6 +1615,23 @@ clientRestoreSizePos (Client *c)
     return FALSE;
 }
 
+static void
+clientCreateFramePart (Client *c, xfwmWindow *part, Cursor cursor)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = c->screen_info;
+    if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME))
+    {
+        xfwmWindowCreateVirtual (screen_info, c->visual, c->depth, part, cursor);
+    }
+    else
+    {
+        xfwmWindowCreate (screen_info, c->visual, c->depth, c->frame,
+            part, NoEventMask, cursor);
+    }
+}
+
 Client *
 clientFrame (DisplayInfo *display_info, Window w, gboolean recapture)
 {
@@ -1772,8 +1790,6 @@ clientFrame (DisplayInfo *display_info, Window w, gboolean recapture)
 
     /* Timout for asynchronous icon update */
     c->icon_timeout_id = 0;
-    /* Timout for asynchronous frame update */
-    c->frame_timeout_id = 0;
     /* Timeout for blinking on urgency */
     c->blink_timeout_id = 0;
     /* Ping timeout  */
@@ -1882,8 +1898,22 @@ clientFrame (DisplayInfo *display_info, Window w, gboolean recapture)
      */
     clientApplyInitialState (c);
 
+    /*
+       Without subwindows for the title, sides and corners, the frame draws
+       them and tracks the pointer to set the cursor, see frameDrawWin()
+     */
+    if ((screen_info->params->composited_decorations) &&
+        (attr.depth == screen_info->depth) && compositorIsActive (screen_info))
+    {
+        FLAG_SET (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME);
+    }
+
     valuemask = CWEventMask|CWBitGravity|CWWinGravity;
     attributes.event_mask = (FRAME_EVENT_MASK | POINTER_EVENT_MASK);
+    if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME))
+    {
+        attributes.event_mask |= LeaveWindowMask | ExposureMask;
+    }
     attributes.win_gravity = StaticGravity;
     attributes.bit_gravity = StaticGravity;
 
@@ -1963,32 +1993,29 @@ clientFrame (DisplayInfo *display_info, Window w, gboolean recapture)
         if (i == SIDE_TOP)
             continue;  /* Keep SIDE_TOP for later */
 
-        xfwmWindowCreate (screen_info, c->visual, c->depth, c->frame,
-            &c->sides[i], NoEventMask,
+        clientCreateFramePart (c, &c->sides[i],
             myDisplayGetCursorResize(screen_info->display_info, CORNER_COUNT + i));
     }
 
     for (i = 0; i < CORNER_COUNT; i++)
     {
-        xfwmWindowCreate (screen_info, c->visual, c->depth, c->frame,
-            &c->corners[i], NoEventMask,
+        clientCreateFramePart (c, &c->corners[i],
             myDisplayGetCursorResize(screen_info->display_info, i));
     }
 
-    xfwmWindowCreate (screen_info, c->visual, c->depth, c->frame,
-        &c->title, NoEventMask, None);
+    clientCreateFramePart (c, &c->title, None);
 
     /*create the top side window AFTER the title window since they overlap
        and the top side window should be on top */
 
-    xfwmWindowCreate (screen_info, c->visual, c->depth, c->frame,
-        &c->sides[SIDE_TOP], NoEventMask,
+    clientCreateFramePart (c, &c->sides[SIDE_TOP],
         myDisplayGetCursorResize(screen_info->display_info, CORNER_COUNT + SIDE_TOP));
 
     for (i = 0; i < BUTTON_COUNT; i++)
     {
         xfwmWindowCreate (screen_info, c->visual, c->depth, c->frame,
             &c->buttons[i], BUTTON_EVENT_MASK, None);
+        myDisplayAddClientWindow (display_info, MYWINDOW_XWINDOW (c->buttons[i]), c);
     }
     clientUpdateIconPix (c);
 
@@ -2141,6 +2168,7 @@ clientUnframe (Client *c, gboolean remap)
     {
         xfwmWindowDelete (&c->buttons[i]);
     }
+    frameFreePixmaps (c);
     if (FLAG_TEST (c->flags, CLIENT_FLAG_HAS_STRUT))
     {
         workspaceUpdateArea (c->screen_info);
@@ -2388,6 +2416,12 @@ clientShowSingle (Client *c, gboolean deiconify)
     {
         TRACE ("showing client \"%s\" (0x%lx)", c->name, c->window);
         FLAG_SET (c->xfwm_flags, XFWM_FLAG_VISIBLE);
+        clientUpdatePlacementRect (c);
+        /* Catch up with a redraw deferred while the window was hidden */
+        if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAW_QUEUED))
+        {
+            frameDraw (c, FALSE);
+        }
         myDisplayErrorTrapPush (display_info);
         XMapWindow (display_info->dpy, c->frame);
         if (!FLAG_TEST (c->flags, CLIENT_FLAG_SHADED))
@@ -2451,6 +2485,7 @@ clientWithdrawSingle (Client *c, GList *exclude_list, gboolean iconify)
     if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE))
     {
         FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_VISIBLE);
+        clientRemovePlacementRect (c);
         c->ignore_unmap++;
         /* Adjust to urgency state as the window is not visible */
         clientUpdateUrgency (c);
@@ -132,6 +132,7 @@
 #define XFWM_FLAG_IS_RESIZABLE          (1L<<9)
 #define XFWM_FLAG_MAP_PENDING           (1L<<10)
 #define XFWM_FLAG_VISIBLE               (1L<<11)
+#define XFWM_FLAG_DRAWN_FRAME           (1L<<12)
 #define XFWM_FLAG_MANAGED               (1L<<13)
 #define XFWM_FLAG_SESSION_MANAGED       (1L<<14)
 #define XFWM_FLAG_WORKSPACE_SET         (1L<<15)
@@ -143,6 +144,7 @@
 #define XFWM_FLAG_MOVING_RESIZING       (1L<<21)
 #define XFWM_FLAG_NEEDS_REDRAW          (1L<<22)
 #define XFWM_FLAG_OPACITY_LOCKED        (1L<<23)
+#define XFWM_FLAG_DRAW_QUEUED           (1L<<24)
 
 #define CLIENT_FLAG_HAS_STRUT           (1L<<0)
 #define CLIENT_FLAG_HAS_STRUT_PARTIAL   (1L<<1)
@@ -273,6 +275,21 @@ typedef enum
 }
 tilePositionType;
 
+typedef struct _FrameSideEntry FrameSideEntry;
+
+/* Decoration pixmaps of a frame in one state, kept between redraws */
+typedef struct _FramePixmap FramePixmap;
+struct _FramePixmap
+{
+    xfwmPixmap pm_title;
+    xfwmPixmap pm_top;
+    /* Left, right and bottom sides, shared by frames of the same size */
+    FrameSideEntry *sides[SIDE_COUNT];
+    /* Allocated sizes, the pixmaps may be larger than the part in use */
+    gint title_size[2];
+    gint top_size[2];
+};
+
 struct _Client
 {
     /* Reference to our screen structure */
@@ -292,6 +309,12 @@ struct _Client
     Window client_leader;
     Window group_leader;
     xfwmPixmap appmenu[STATE_TOGGLED];
+    FramePixmap frame_pix[2];
+    /* Cursor set on drawn frames, see XFWM_FLAG_DRAWN_FRAME */
+    Cursor frame_cursor;
+    /* Shaped title, kept until the name or the font changes */
+    PangoLayout *title_layout;
+    guint title_font_serial;
     unsigned long win_layer;
     unsigned long serial;
     unsigned long initial_layer;
@@ -341,8 +364,6 @@ struct _Client
     gint dialog_fd;
     /* Timout for asynchronous icon update */
     guint icon_timeout_id;
-    /* Timout for asynchronous frame update */
-    guint frame_timeout_id;
     /* Timout to manage blinking decorations for urgent windows */
     guint blink_timeout_id;
     /* Timout for asynchronous icon update */
@@ -34,6 +34,7 @@
 #include <glib.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 #include <libxfce4util/libxfce4util.h>
 
 #ifdef HAVE_EPOXY
@@ -44,6 +45,10 @@
 #endif /* HAVE_XSYNC_EXTENSION */
 #endif /* HAVE_EPOXY */
 
+#ifdef HAVE_XI2
+#include <X11/extensions/XInput2.h>
+#endif /* HAVE_XI2 */
+
 #ifdef HAVE_PRESENT_EXTENSION
 #ifndef PRESENT_FUTURE_VERSION
 #define PRESENT_FUTURE_VERSION 0
@@ -61,6 +66,8 @@
 #ifdef HAVE_COMPOSITOR
 #include "common/xfwm-common.h"
 
+#include <gdk/gdk.h>
+#include <cairo/cairo-xlib-xrender.h>
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xrender.h>
@@ -101,6 +108,7 @@
 #define WIN_IS_DAMAGED(cw)              (cw->damaged)
 #define WIN_IS_REDIRECTED(cw)           (cw->redirected)
 #define WIN_IS_SHADED(cw)               (WIN_HAS_CLIENT(cw) && FLAG_TEST (cw->c->flags, CLIENT_FLAG_SHADED))
+#define WIN_HAS_SHADOW(cw)              ((cw->shadow) || (cw->shadow_slices))
 
 #ifndef TIMEOUT_REPAINT_PRIORITY
 #define TIMEOUT_REPAINT_PRIORITY   G_PRIORITY_DEFAULT
@@ -118,10 +126,107 @@
 #define TIMEOUT_THROTTLED_REPAINT_MS   500
 #endif /* TIMEOUT_THROTTLED_REPAINT_MS */
 
+/* Refresh interval assumed until the actual one is measured, in μs */
+#ifndef DEFAULT_REFRESH_INTERVAL
+#define DEFAULT_REFRESH_INTERVAL   16667
+#endif /* DEFAULT_REFRESH_INTERVAL */
+
+/* Vblank timestamps older than that are not used for prediction, in μs */
+#ifndef MAX_VBLANK_AGE
+#define MAX_VBLANK_AGE   G_USEC_PER_SEC
+#endif /* MAX_VBLANK_AGE */
+
 #ifndef MONITOR_ROOT_PIXMAP
 #define MONITOR_ROOT_PIXMAP   1
 #endif /* MONITOR_ROOT_PIXMAP */
 
+/*
+ * Present partial updates with glXCopySubBufferMESA() when buffer age
+ * is not available, the copy is not synchronized to the vblank though.
+ */
+#ifndef USE_GLX_COPY_SUB_BUFFER
+#define USE_GLX_COPY_SUB_BUFFER   0
+#endif /* USE_GLX_COPY_SUB_BUFFER */
+
+/* Number of presented frames measured before adapting the buffer count */
+#ifndef BUFFER_ADAPT_FRAMES
+#define BUFFER_ADAPT_FRAMES   120
+#endif /* BUFFER_ADAPT_FRAMES */
+
+/* Time a fullscreen window must qualify before being unredirected, in μs */
+#ifndef SCANOUT_ENTER_DELAY
+#define SCANOUT_ENTER_DELAY   (G_USEC_PER_SEC / 2)
+#endif /* SCANOUT_ENTER_DELAY */
+
+/* Time before unredirecting again after going back to compositing, in μs */
+#ifndef SCANOUT_RETRY_DELAY
+#define SCANOUT_RETRY_DELAY   (2 * G_USEC_PER_SEC)
+#endif /* SCANOUT_RETRY_DELAY */
+
+/* Damages per second for a window to qualify without asking for bypass */
+#ifndef SCANOUT_MIN_DAMAGE_RATE
+#define SCANOUT_MIN_DAMAGE_RATE   20
+#endif /* SCANOUT_MIN_DAMAGE_RATE */
+
+/* Damaged window thumbnails are not regenerated more often than that, in μs */
+#ifndef THUMBNAIL_REFRESH_INTERVAL
+#define THUMBNAIL_REFRESH_INTERVAL   G_USEC_PER_SEC
+#endif /* THUMBNAIL_REFRESH_INTERVAL */
+
+/* Number of cursor images kept for the zoomed cursor */
+#ifndef CURSOR_CACHE_SIZE
+#define CURSOR_CACHE_SIZE   32
+#endif /* CURSOR_CACHE_SIZE */
+
+#ifndef SHADOW_NINE_SLICE
+#define SHADOW_NINE_SLICE   1
+#endif /* SHADOW_NINE_SLICE */
+
+/* Sum the gaussian map with a summed-area table, 0 uses the nested loops
+ * instead, to compare the shadow build times against */
+#ifndef SHADOW_SUMMED_AREA
+#define SHADOW_SUMMED_AREA   1
+#endif /* SHADOW_SUMMED_AREA */
+
+#ifndef SHADOW_CACHE_MAX_BYTES
+#define SHADOW_CACHE_MAX_BYTES   (16 * 1024 * 1024)
+#endif /* SHADOW_CACHE_MAX_BYTES */
+
+#ifndef SHADOW_CACHE_OPACITY_STEPS
+#define SHADOW_CACHE_OPACITY_STEPS   100
+#endif /* SHADOW_CACHE_OPACITY_STEPS */
+
+typedef struct _ShadowEntry ShadowEntry;
+struct _ShadowEntry
+{
+    /* Key */
+    gint width;
+    gint height;
+    gint opacity;
+
+    Picture picture;
+    gint shadow_width;
+    gint shadow_height;
+#ifdef HAVE_EPOXY
+    /* Built on first use by the GL scene */
+    GLuint texture;
+#endif /* HAVE_EPOXY */
+
+    guint ref_count;
+    /* Link in the screen LRU queue, only set when unused */
+    GList *lru_link;
+};
+
+typedef struct _CursorEntry CursorEntry;
+struct _CursorEntry
+{
+    Picture picture;
+    gint xhot;
+    gint yhot;
+    gint width;
+    gint height;
+};
+
 typedef struct _CWindow CWindow;
 struct _CWindow
 {
@@ -143,19 +248,26 @@ struct _CWindow
     Damage damage;
 #if HAVE_NAME_WINDOW_PIXMAP
     Pixmap name_window_pixmap;
+    /* Last contents of the unmapped window, for its thumbnail */
+    Pixmap saved_pixmap;
 #endif /* HAVE_NAME_WINDOW_PIXMAP */
     Picture picture;
-    Picture saved_picture;
     Picture shadow;
+    ShadowEntry *shadow_entry;
+    shadow_slices *shadow_slices;
     Picture alphaPict;
     Picture shadowPict;
     Picture alphaBorderPict;
 
-    XserverRegion borderSize;
-    XserverRegion clientSize;
-    XserverRegion borderClip;
-    XserverRegion extents;
-    XserverRegion opaque_region;
+    cairo_region_t *borderSize;
+    cairo_region_t *clientSize;
+    cairo_region_t *borderClip;
+    cairo_region_t *extents;
+    cairo_region_t *opaque_region;
+    /* opaque_region on screen, limited to the window, kept with clientSize */
+    cairo_region_t *opaqueClip;
+    /* Part of the window not covered by opaque windows above, on screen */
+    cairo_region_t *visible_region;
 
     gint shadow_dx;
     gint shadow_dy;
@@ -164,8 +276,39 @@ struct _CWindow
 
     guint32 opacity;
     guint32 bypass_compositor;
+
+    guint damage_count;
+
+#ifdef HAVE_EPOXY
+    /* GL scene mode only */
+    GLXPixmap glx_pixmap;
+    GLuint texture;
+#endif /* HAVE_EPOXY */
+
+    /* Last scaled copy of the window, kept on the server */
+    cairo_surface_t *thumbnail;
+    guint thumbnail_width;
+    guint thumbnail_height;
+    gboolean thumbnail_stale;
+    gint64 thumbnail_time;
 };
 
+static gint
+find_stack_index (ScreenInfo *screen_info, CWindow *cw)
+{
+    guint i;
+
+    for (i = 0; i < screen_info->cwindows->len; i++)
+    {
+        if (g_ptr_array_index (screen_info->cwindows, i) == cw)
+        {
+            return (gint) i;
+        }
+    }
+
+    return -1;
+}
+
 static CWindow*
 find_cwindow_in_screen (ScreenInfo *screen_info, Window id)
 {
@@ -342,8 +485,95 @@ make_gaussian_map (gdouble r)
 *  center  +-----+-------------------+-----+
 */
 
+#if SHADOW_SUMMED_AREA
+static guchar
+sum_gaussian (ScreenInfo *screen_info, gdouble opacity, gint x, gint y, gint width, gint height)
+{
+    gdouble *g_sum;
+    gdouble v;
+    gint fx_start, fx_end;
+    gint fy_start, fy_end;
+    gint g_size, center, stride;
+
+    g_return_val_if_fail (screen_info->gaussianSum != NULL, (guchar) 255.0);
+    TRACE ("(%i,%i) [%i×%i]", x, y, width, height);
+
+    g_sum = screen_info->gaussianSum;
+    g_size = screen_info->gaussianMap->size;
+    stride = g_size + 1;
+    center = g_size / 2;
+    fx_start = center - x;
+    if (fx_start < 0)
+    {
+        fx_start = 0;
+    }
+    fx_end = width + center - x;
+    if (fx_end > g_size)
+    {
+        fx_end = g_size;
+    }
+
+    fy_start = center - y;
+    if (fy_start < 0)
+    {
+        fy_start = 0;
+    }
+    fy_end = height + center - y;
+    if (fy_end > g_size)
+    {
+        fy_end = g_size;
+    }
+
+    if ((fx_end <= fx_start) || (fy_end <= fy_start))
+    {
+        return 0;
+    }
+
+    /* Sum of the map over [fx_start, fx_end) × [fy_start, fy_end) */
+    v = g_sum[fy_end * stride + fx_end]
+      - g_sum[fy_start * stride + fx_end]
+      - g_sum[fy_end * stride + fx_start]
+      + g_sum[fy_start * stride + fx_start];
+    if (v > 1)
+    {
+        v = 1;
+    }
+    else if (v < 0)
+    {
+        v = 0;
+    }
+
+    return ((guchar) (v * opacity * 255.0));
+}
+
+/* summed-area table of the gaussian map, so any partial sum costs O(1) */
+static gdouble *
+make_gaussian_sum (gaussian_conv *map)
+{
+    gdouble *g_sum;
+    gdouble row;
+    gint size, stride;
+    gint x, y;
+
+    size = map->size;
+    stride = size + 1;
+    g_sum = g_new0 (gdouble, stride * stride);
+
+    for (y = 0; y < size; y++)
+    {
+        row = 0.0;
+        for (x = 0; x < size; x++)
+        {
+            row += map->data[y * size + x];
+            g_sum[(y + 1) * stride + x + 1] = g_sum[y * stride + x + 1] + row;
+        }
+    }
+
+    return g_sum;
+}
+#else /* SHADOW_SUMMED_AREA */
 static guchar
-sum_gaussian (gaussian_conv *map, gdouble opacity, gint x, gint y, gint width, gint height)
+sum_gaussian (ScreenInfo *screen_info, gdouble opacity, gint x, gint y, gint width, gint height)
 {
     gdouble *g_data, *g_line;
     gdouble v;
@@ -352,11 +582,11 @@ sum_gaussian (gaussian_conv *map, gdouble opacity, gint x, gint y, gint width, g
     gint fy_start, fy_end;
     gint g_size, center;
 
-    g_return_val_if_fail (map != NULL, (guchar) 255.0);
+    g_return_val_if_fail (screen_info->gaussianMap != NULL, (guchar) 255.0);
     TRACE ("(%i,%i) [%i×%i]", x, y, width, height);
 
-    g_line = map->data;
-    g_size = map->size;
+    g_line = screen_info->gaussianMap->data;
+    g_size = screen_info->gaussianMap->size;
     center = g_size / 2;
     fx_start = center - x;
     if (fx_start < 0)
@@ -399,6 +629,7 @@ sum_gaussian (gaussian_conv *map, gdouble opacity, gint x, gint y, gint width, g
 
     return ((guchar) (v * opacity * 255.0));
 }
+#endif /* SHADOW_SUMMED_AREA */
 
 /* precompute shadow corners and sides to save time for large windows */
 static void
@@ -424,6 +655,13 @@ presum_gaussian (ScreenInfo *screen_info)
     {
         g_free (screen_info->shadowTop);
     }
+    if (screen_info->gaussianSum)
+    {
+        g_free (screen_info->gaussianSum);
+    }
+#if SHADOW_SUMMED_AREA
+    screen_info->gaussianSum = make_gaussian_sum (map);
+#endif /* SHADOW_SUMMED_AREA */
 
     screen_info->shadowCorner = (guchar *) (g_malloc0 ((screen_info->gaussianSize + 1)
                                                     * (screen_info->gaussianSize + 1) * 26));
@@ -432,7 +670,7 @@ presum_gaussian (ScreenInfo *screen_info)
     for (x = 0; x <= screen_info->gaussianSize; x++)
     {
         screen_info->shadowTop[25 * (screen_info->gaussianSize + 1) + x] =
-            sum_gaussian (map, 1, x - center, center,
+            sum_gaussian (screen_info, 1, x - center, center,
                           screen_info->gaussianSize * 2,
                           screen_info->gaussianSize * 2);
 
@@ -447,10 +685,10 @@ presum_gaussian (ScreenInfo *screen_info)
             screen_info->shadowCorner[25 * (screen_info->gaussianSize + 1)
                                          * (screen_info->gaussianSize + 1)
                                      + y * (screen_info->gaussianSize + 1) + x]
-                = sum_gaussian (map, 1, x - center,
-                                        y - center,
-                                        screen_info->gaussianSize * 2,
-                                        screen_info->gaussianSize * 2);
+                = sum_gaussian (screen_info, 1, x - center,
+                                                y - center,
+                                                screen_info->gaussianSize * 2,
+                                                screen_info->gaussianSize * 2);
             screen_info->shadowCorner[25 * (screen_info->gaussianSize + 1)
                                          * (screen_info->gaussianSize + 1)
                                      + x * (screen_info->gaussianSize + 1) + y]
@@ -474,12 +712,46 @@ presum_gaussian (ScreenInfo *screen_info)
     }
 }
 
+static void
+get_shadow_size (ScreenInfo *screen_info, gint width, gint height, gint *swidth, gint *sheight)
+{
+    gint gaussianSize;
+
+    gaussianSize = screen_info->gaussianMap->size;
+    *swidth = width + gaussianSize - screen_info->params->shadow_delta_width - screen_info->params->shadow_delta_x;
+    *sheight = height + gaussianSize - screen_info->params->shadow_delta_height - screen_info->params->shadow_delta_y;
+}
+
+static XImage *
+create_a8_image (ScreenInfo *screen_info, gint width, gint height)
+{
+    DisplayInfo *display_info;
+    XImage *ximage;
+    guchar *data;
+
+    display_info = screen_info->display_info;
+    data = g_malloc0 (width * height * sizeof (guchar));
+
+    ximage = XCreateImage (display_info->dpy,
+                        DefaultVisual(display_info->dpy, screen_info->screen),
+                        8, ZPixmap, 0, (char *) data,
+                        width, height, 8, width * sizeof (guchar));
+    if (ximage == NULL)
+    {
+        g_free (data);
+        g_warning ("(ximage != NULL) failed");
+        return NULL;
+    }
+
+    return ximage;
+}
+
 static XImage *
 make_shadow (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
 {
-    DisplayInfo *display_info;
     XImage *ximage;
     guchar *data;
+    guchar *line;
     guchar d;
     gint gaussianSize;
     gint ylimit, xlimit;
@@ -489,16 +761,12 @@ make_shadow (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
     gint x, y;
     gint x_diff;
     gint opacity_int;
-    gint x_swidth;
-    gint y_swidth;
 
     g_return_val_if_fail (screen_info != NULL, NULL);
     TRACE ("entering");
 
-    display_info = screen_info->display_info;
     gaussianSize = screen_info->gaussianMap->size;
-    swidth = width + gaussianSize - screen_info->params->shadow_delta_width - screen_info->params->shadow_delta_x;
-    sheight = height + gaussianSize - screen_info->params->shadow_delta_height - screen_info->params->shadow_delta_y;
+    get_shadow_size (screen_info, width, height, &swidth, &sheight);
     center = gaussianSize / 2;
     opacity_int = (gint) (opacity * 25);
 
@@ -507,35 +775,17 @@ make_shadow (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
         return NULL;
     }
 
-    data = g_malloc0 (swidth * sheight * sizeof (guchar));
-
-    ximage = XCreateImage (display_info->dpy,
-                        DefaultVisual(display_info->dpy, screen_info->screen),
-                        8, ZPixmap, 0, (char *) data,
-                        swidth, sheight, 8, swidth * sizeof (guchar));
+    ximage = create_a8_image (screen_info, swidth, sheight);
     if (ximage == NULL)
     {
-        g_free (data);
-        g_warning ("(ximage != NULL) failed");
         return NULL;
     }
+    data = (guchar *) ximage->data;
 
     /*
-    * Build the gaussian in sections
-    */
-
-    if (screen_info->gaussianSize > 0)
-    {
-        d = screen_info->shadowTop[opacity_int * (screen_info->gaussianSize + 1) + screen_info->gaussianSize];
-    }
-    else
-    {
-        d = sum_gaussian (screen_info->gaussianMap, opacity, center, center, width, height);
-    }
-    memset(data, d, sheight * swidth);
-
-    /*
-    * corners
+    * Build the gaussian in sections, each row is filled in one pass
+    * and copied over to the identical rows, so that all stores are
+    * whole lines rather than per pixel.
     */
 
     ylimit = gaussianSize;
@@ -548,8 +798,15 @@ make_shadow (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
     {
         xlimit = (swidth + 1) / 2;
     }
+    x_diff = swidth - (gaussianSize * 2);
+
+    /*
+    * corners and top/bottom
+    */
+
     for (y = 0; y < ylimit; y++)
     {
+        line = data + y * swidth;
         for (x = 0; x < xlimit; x++)
         {
             if ((xlimit == screen_info->gaussianSize) && (ylimit == screen_info->gaussianSize))
@@ -560,25 +817,14 @@ make_shadow (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
             }
             else
             {
-                d = sum_gaussian (screen_info->gaussianMap, opacity,
-                                x - center, y - center, width, height);
+                d = sum_gaussian (screen_info, opacity,
+                                  x - center, y - center, width, height);
             }
-
-            data[y * swidth + x] = d;
-            data[(sheight - y - 1) * swidth + x] = d;
-            data[(sheight - y - 1) * swidth + (swidth - x - 1)] = d;
-            data[y * swidth + (swidth - x - 1)] = d;
+            line[x] = d;
+            line[swidth - x - 1] = d;
         }
-    }
 
-    /*
-    * top/bottom
-    */
-
-    x_diff = swidth - (gaussianSize * 2);
-    if (x_diff > 0 && ylimit > 0)
-    {
-        for (y = 0; y < ylimit; y++)
+        if (x_diff > 0)
         {
             if (ylimit == screen_info->gaussianSize)
             {
@@ -586,33 +832,45 @@ make_shadow (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
             }
             else
             {
-                d = sum_gaussian (screen_info->gaussianMap, opacity, center, y - center, width, height);
+                d = sum_gaussian (screen_info, opacity, center, y - center, width, height);
             }
-            memset (&data[y * swidth + gaussianSize], d, x_diff);
-            memset (&data[(sheight - y - 1) * swidth + gaussianSize], d, x_diff);
+            memset (line + gaussianSize, d, x_diff);
+        }
+
+        /* The bottom edge mirrors the top edge */
+        if (sheight - y - 1 != y)
+        {
+            memcpy (data + (sheight - y - 1) * swidth, line, swidth);
         }
     }
 
     /*
-    * sides
+    * sides and center
     */
 
-    for (x = 0; x < xlimit; x++)
+    if (sheight > gaussianSize * 2)
     {
-        if (xlimit == screen_info->gaussianSize)
-        {
-            d = screen_info->shadowTop[opacity_int * (screen_info->gaussianSize + 1) + x];
-        }
-        else
+        line = data + gaussianSize * swidth;
+        d = screen_info->shadowTop[opacity_int * (screen_info->gaussianSize + 1) + screen_info->gaussianSize];
+        memset (line, d, swidth);
+
+        for (x = 0; x < xlimit; x++)
         {
-            d = sum_gaussian (screen_info->gaussianMap, opacity, x - center, center, width, height);
+            if (xlimit == screen_info->gaussianSize)
+            {
+                d = screen_info->shadowTop[opacity_int * (screen_info->gaussianSize + 1) + x];
+            }
+            else
+            {
+                d = sum_gaussian (screen_info, opacity, x - center, center, width, height);
+            }
+            line[x] = d;
+            line[swidth - x - 1] = d;
         }
-        x_swidth = swidth - x - 1;
-        for (y = gaussianSize; y < sheight - gaussianSize; y++)
+
+        for (y = gaussianSize + 1; y < sheight - gaussianSize; y++)
         {
-            y_swidth = y * swidth;
-            data[y_swidth + x] = d;
-            data[y_swidth + x_swidth] = d;
+            memcpy (data + y * swidth, line, swidth);
         }
     }
 
@@ -620,153 +878,770 @@ make_shadow (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
 }
 
 static Picture
-shadow_picture (ScreenInfo *screen_info, gdouble opacity,
-                gint width, gint height, gint *wp, gint *hp)
+a8_image_to_picture (ScreenInfo *screen_info, XImage *ximage, gboolean repeat)
 {
     DisplayInfo *display_info;
-    XImage *shadowImage;
-    Pixmap shadowPixmap;
-    Picture shadowPicture;
+    Pixmap pixmap;
+    Picture picture;
     XRenderPictFormat *render_format;
+    XRenderPictureAttributes pa;
     GC gc;
 
     g_return_val_if_fail (screen_info != NULL, None);
+    g_return_val_if_fail (ximage != NULL, None);
     TRACE ("entering");
 
     display_info = screen_info->display_info;
     render_format = XRenderFindStandardFormat (display_info->dpy, PictStandardA8);
     g_return_val_if_fail (render_format != NULL, None);
 
-    shadowImage = make_shadow (screen_info, opacity, width, height);
-    if (shadowImage == NULL)
-    {
-        *wp = *hp = 0;
-        g_warning ("(shadowImage != NULL) failed");
-        return (None);
-    }
-
-    shadowPixmap = XCreatePixmap (display_info->dpy, screen_info->output,
-                                shadowImage->width, shadowImage->height, 8);
-    if (shadowPixmap == None)
+    pixmap = XCreatePixmap (display_info->dpy, screen_info->output,
+                            ximage->width, ximage->height, 8);
+    if (pixmap == None)
     {
-        XDestroyImage (shadowImage);
-        g_warning ("(shadowPixmap != None) failed");
+        g_warning ("(pixmap != None) failed");
         return None;
     }
 
-    shadowPicture = XRenderCreatePicture (display_info->dpy,
-                                        shadowPixmap, render_format, 0, NULL);
-    if (shadowPicture == None)
+    pa.repeat = repeat;
+    picture = XRenderCreatePicture (display_info->dpy, pixmap, render_format,
+                                    repeat ? CPRepeat : 0, &pa);
+    if (picture == None)
     {
-        XDestroyImage (shadowImage);
-        XFreePixmap (display_info->dpy, shadowPixmap);
-        g_warning ("(shadowPicture != None) failed");
+        XFreePixmap (display_info->dpy, pixmap);
+        g_warning ("(picture != None) failed");
         return None;
     }
 
-    gc = XCreateGC (display_info->dpy, shadowPixmap, 0, NULL);
-    XPutImage (display_info->dpy, shadowPixmap, gc, shadowImage, 0, 0, 0, 0,
-            shadowImage->width, shadowImage->height);
-
-    *wp = shadowImage->width;
-    *hp = shadowImage->height;
-
+    gc = XCreateGC (display_info->dpy, pixmap, 0, NULL);
+    XPutImage (display_info->dpy, pixmap, gc, ximage, 0, 0, 0, 0,
+               ximage->width, ximage->height);
     XFreeGC (display_info->dpy, gc);
-    XDestroyImage (shadowImage);
-    XFreePixmap (display_info->dpy, shadowPixmap);
+    XFreePixmap (display_info->dpy, pixmap);
 
-    return shadowPicture;
+    return picture;
 }
 
-static Picture
-solid_picture (ScreenInfo *screen_info, gboolean argb,
-               gdouble a, gdouble r, gdouble g, gdouble b)
+#ifdef HAVE_EPOXY
+static GLuint
+a8_image_to_texture (ScreenInfo *screen_info, XImage *ximage)
 {
-    DisplayInfo *display_info;
-    Pixmap pixmap;
-    Picture picture;
-    XRenderPictureAttributes pa;
-    XRenderPictFormat *render_format;
-    XRenderColor c;
+    GLuint texture;
 
-    g_return_val_if_fail (screen_info, None);
+    g_return_val_if_fail (screen_info != NULL, 0);
+    g_return_val_if_fail (ximage != NULL, 0);
     TRACE ("entering");
 
-    display_info = screen_info->display_info;
-    render_format = XRenderFindStandardFormat (display_info->dpy,
-                                    argb ? PictStandardARGB32 : PictStandardA8);
-    g_return_val_if_fail (render_format != NULL , None);
-
-    pixmap = XCreatePixmap (display_info->dpy,
-                            screen_info->output, 1, 1, argb ? 32 : 8);
-    g_return_val_if_fail (pixmap != None, None);
-
-    pa.repeat = TRUE;
-    picture = XRenderCreatePicture (display_info->dpy, pixmap,
-                                    render_format, CPRepeat, &pa);
-    if (picture == None)
+    if (!screen_info->use_glx_scene || !screen_info->glx_context)
     {
-        XFreePixmap (display_info->dpy, pixmap);
-        g_warning ("(picture != None) failed");
-        return None;
+        return 0;
     }
 
-    c.alpha = a * 0xffff;
-    c.red   = r * 0xffff;
-    c.green = g * 0xffff;
-    c.blue  = b * 0xffff;
-
-    XRenderFillRectangle (display_info->dpy, PictOpSrc,
-                          picture, &c, 0, 0, 1, 1);
-    XFreePixmap (display_info->dpy, pixmap);
+    glGenTextures (1, &texture);
+    glBindTexture (screen_info->texture_type, texture);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei (GL_UNPACK_ROW_LENGTH, ximage->bytes_per_line);
+    glTexImage2D (screen_info->texture_type, 0, GL_ALPHA,
+                  ximage->width, ximage->height, 0,
+                  GL_ALPHA, GL_UNSIGNED_BYTE, ximage->data);
+    glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture (screen_info->texture_type, 0);
 
-    return picture;
+    return texture;
 }
+#endif /* HAVE_EPOXY */
 
-static void
-translate_to_client_region (CWindow *cw, XserverRegion region)
+static Picture
+shadow_picture (ScreenInfo *screen_info, gdouble opacity,
+                gint width, gint height, gint *wp, gint *hp)
 {
-    DisplayInfo *display_info;
-    ScreenInfo *screen_info;
-    int x, y;
-
-    g_return_if_fail (cw != NULL);
-    TRACE ("window 0x%lx", cw->id);
+    XImage *shadowImage;
+    Picture shadowPicture;
 
-    screen_info = cw->screen_info;
-    display_info = screen_info->display_info;
+    g_return_val_if_fail (screen_info != NULL, None);
+    TRACE ("entering");
 
-    if (WIN_HAS_FRAME(cw))
+    shadowImage = make_shadow (screen_info, opacity, width, height);
+    if (shadowImage == NULL)
     {
-        x = frameX (cw->c) + frameLeft (cw->c);
-        y = frameY (cw->c) + frameTop (cw->c);
+        *wp = *hp = 0;
+        g_warning ("(shadowImage != NULL) failed");
+        return (None);
     }
-    else
+
+    shadowPicture = a8_image_to_picture (screen_info, shadowImage, FALSE);
+    if (shadowPicture == None)
+    {
+        *wp = *hp = 0;
+        XDestroyImage (shadowImage);
+        return None;
+    }
+
+    *wp = shadowImage->width;
+    *hp = shadowImage->height;
+    XDestroyImage (shadowImage);
+
+    return shadowPicture;
+}
+
+#if SHADOW_NINE_SLICE
+#ifdef HAVE_EPOXY
+/*
+ * The GL scene gets the slices laid out in one texture of twice the
+ * gaussian size plus one, the middle row and column holding the edges
+ * and the center, which are stretched at paint time.
+ */
+static GLuint
+make_glx_shadow_slices (ScreenInfo *screen_info, gint opacity_int)
+{
+    XImage *ximage;
+    GLuint texture;
+    guchar *corner_data;
+    guchar *top_data;
+    guchar *line;
+    guchar d;
+    gint gaussianSize;
+    gint size;
+    gint x, y;
+
+    gaussianSize = screen_info->gaussianSize;
+    corner_data = screen_info->shadowCorner + opacity_int * (gaussianSize + 1) * (gaussianSize + 1);
+    top_data = screen_info->shadowTop + opacity_int * (gaussianSize + 1);
+    size = 2 * gaussianSize + 1;
+
+    ximage = create_a8_image (screen_info, size, size);
+    if (ximage == NULL)
+    {
+        return 0;
+    }
+
+    for (y = 0; y <= gaussianSize; y++)
+    {
+        line = (guchar *) ximage->data + y * ximage->bytes_per_line;
+        for (x = 0; x <= gaussianSize; x++)
+        {
+            if ((x < gaussianSize) && (y < gaussianSize))
+            {
+                d = corner_data[y * (gaussianSize + 1) + x];
+            }
+            else
+            {
+                d = top_data[MIN (x, y)];
+            }
+            line[x] = d;
+            line[size - x - 1] = d;
+        }
+        /* The bottom half mirrors the top half */
+        if (size - y - 1 != y)
+        {
+            memcpy (ximage->data + (size - y - 1) * ximage->bytes_per_line, line, size);
+        }
+    }
+
+    texture = a8_image_to_texture (screen_info, ximage);
+    XDestroyImage (ximage);
+
+    return texture;
+}
+#endif /* HAVE_EPOXY */
+
+/*
+ * Shadows of windows larger than twice the gaussian size are made of
+ * four corners, four edges repeated along the window sides and a
+ * constant center. Those are built once per opacity level from the
+ * presummed tables and composited at paint time, so resizing a window
+ * does not require any new shadow picture.
+ */
+static shadow_slices *
+make_shadow_slices (ScreenInfo *screen_info, gint opacity_int)
+{
+    shadow_slices *slices;
+    XImage *corners, *top, *bottom, *left, *right, *center;
+    guchar *corner_data;
+    guchar *top_data;
+    guchar d;
+    gint64 start;
+    gint gaussianSize;
+    gint x, y;
+
+    g_return_val_if_fail (screen_info != NULL, NULL);
+    g_return_val_if_fail (screen_info->gaussianSize > 0, NULL);
+    TRACE ("opacity %i", opacity_int);
+
+    start = g_get_monotonic_time ();
+    gaussianSize = screen_info->gaussianSize;
+    corner_data = screen_info->shadowCorner + opacity_int * (gaussianSize + 1) * (gaussianSize + 1);
+    top_data = screen_info->shadowTop + opacity_int * (gaussianSize + 1);
+
+    corners = create_a8_image (screen_info, 2 * gaussianSize, 2 * gaussianSize);
+    top = create_a8_image (screen_info, 1, gaussianSize);
+    bottom = create_a8_image (screen_info, 1, gaussianSize);
+    left = create_a8_image (screen_info, gaussianSize, 1);
+    right = create_a8_image (screen_info, gaussianSize, 1);
+    center = create_a8_image (screen_info, 1, 1);
+
+    slices = NULL;
+    if (corners && top && bottom && left && right && center)
+    {
+        for (y = 0; y < gaussianSize; y++)
+        {
+            for (x = 0; x < gaussianSize; x++)
+            {
+                d = corner_data[y * (gaussianSize + 1) + x];
+                corners->data[y * corners->bytes_per_line + x] = d;
+                corners->data[y * corners->bytes_per_line + (2 * gaussianSize - x - 1)] = d;
+                corners->data[(2 * gaussianSize - y - 1) * corners->bytes_per_line + x] = d;
+                corners->data[(2 * gaussianSize - y - 1) * corners->bytes_per_line + (2 * gaussianSize - x - 1)] = d;
+            }
+        }
+
+        for (x = 0; x < gaussianSize; x++)
+        {
+            d = top_data[x];
+            top->data[x * top->bytes_per_line] = d;
+            bottom->data[(gaussianSize - x - 1) * bottom->bytes_per_line] = d;
+            left->data[x] = d;
+            right->data[gaussianSize - x - 1] = d;
+        }
+        center->data[0] = top_data[gaussianSize];
+
+        slices = g_new0 (shadow_slices, 1);
+        screen_info->stats.shadows_built++;
+        slices->corners = a8_image_to_picture (screen_info, corners, FALSE);
+        slices->top = a8_image_to_picture (screen_info, top, TRUE);
+        slices->bottom = a8_image_to_picture (screen_info, bottom, TRUE);
+        slices->left = a8_image_to_picture (screen_info, left, TRUE);
+        slices->right = a8_image_to_picture (screen_info, right, TRUE);
+        slices->center = a8_image_to_picture (screen_info, center, TRUE);
+#ifdef HAVE_EPOXY
+        if (screen_info->use_glx_scene)
+        {
+            slices->texture = make_glx_shadow_slices (screen_info, opacity_int);
+        }
+#endif /* HAVE_EPOXY */
+    }
+
+    if (corners)
+    {
+        XDestroyImage (corners);
+    }
+    if (top)
+    {
+        XDestroyImage (top);
+    }
+    if (bottom)
+    {
+        XDestroyImage (bottom);
+    }
+    if (left)
+    {
+        XDestroyImage (left);
+    }
+    if (right)
+    {
+        XDestroyImage (right);
+    }
+    if (center)
+    {
+        XDestroyImage (center);
+    }
+    screen_info->stats.shadow_time += g_get_monotonic_time () - start;
+
+    return slices;
+}
+
+static shadow_slices *
+get_shadow_slices (ScreenInfo *screen_info, gdouble opacity)
+{
+    gint opacity_int;
+
+    g_return_val_if_fail (screen_info != NULL, NULL);
+
+    opacity_int = CLAMP ((gint) (opacity * 25), 0, SHADOW_SLICE_LEVELS - 1);
+    if (screen_info->shadowSlices[opacity_int] == NULL)
+    {
+        screen_info->shadowSlices[opacity_int] = make_shadow_slices (screen_info, opacity_int);
+    }
+
+    return screen_info->shadowSlices[opacity_int];
+}
+#endif /* SHADOW_NINE_SLICE */
+
+static void
+free_shadow_slices (ScreenInfo *screen_info)
+{
+    DisplayInfo *display_info;
+    shadow_slices *slices;
+    gint i;
+
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("entering");
+
+    display_info = screen_info->display_info;
+    myDisplayErrorTrapPush (display_info);
+    for (i = 0; i < SHADOW_SLICE_LEVELS; i++)
+    {
+        slices = screen_info->shadowSlices[i];
+        if (slices == NULL)
+        {
+            continue;
+        }
+        if (slices->corners)
+        {
+            XRenderFreePicture (display_info->dpy, slices->corners);
+        }
+        if (slices->top)
+        {
+            XRenderFreePicture (display_info->dpy, slices->top);
+        }
+        if (slices->bottom)
+        {
+            XRenderFreePicture (display_info->dpy, slices->bottom);
+        }
+        if (slices->left)
+        {
+            XRenderFreePicture (display_info->dpy, slices->left);
+        }
+        if (slices->right)
+        {
+            XRenderFreePicture (display_info->dpy, slices->right);
+        }
+        if (slices->center)
+        {
+            XRenderFreePicture (display_info->dpy, slices->center);
+        }
+#ifdef HAVE_EPOXY
+        if (slices->texture && screen_info->glx_context)
+        {
+            glDeleteTextures (1, &slices->texture);
+        }
+#endif /* HAVE_EPOXY */
+        g_free (slices);
+        screen_info->shadowSlices[i] = NULL;
+    }
+    myDisplayErrorTrapPopIgnored (display_info);
+}
+
+static guint
+shadow_entry_hash (gconstpointer key)
+{
+    const ShadowEntry *entry = (const ShadowEntry *) key;
+
+    return ((guint) entry->width * 31 + (guint) entry->height) * 131 + (guint) entry->opacity;
+}
+
+static gboolean
+shadow_entry_equal (gconstpointer a, gconstpointer b)
+{
+    const ShadowEntry *entry_a = (const ShadowEntry *) a;
+    const ShadowEntry *entry_b = (const ShadowEntry *) b;
+
+    return ((entry_a->width == entry_b->width) &&
+            (entry_a->height == entry_b->height) &&
+            (entry_a->opacity == entry_b->opacity));
+}
+
+static gsize
+shadow_entry_bytes (ShadowEntry *entry)
+{
+    /* Shadows are A8 pictures, one byte per pixel */
+    return (gsize) entry->shadow_width * (gsize) entry->shadow_height;
+}
+
+static void
+shadow_entry_free (ScreenInfo *screen_info, ShadowEntry *entry)
+{
+    DisplayInfo *display_info;
+
+    display_info = screen_info->display_info;
+    screen_info->shadow_cache_bytes -= shadow_entry_bytes (entry);
+
+    if (entry->picture)
+    {
+        myDisplayErrorTrapPush (display_info);
+        XRenderFreePicture (display_info->dpy, entry->picture);
+        myDisplayErrorTrapPopIgnored (display_info);
+    }
+#ifdef HAVE_EPOXY
+    if (entry->texture && screen_info->glx_context)
+    {
+        glDeleteTextures (1, &entry->texture);
+    }
+#endif /* HAVE_EPOXY */
+    g_slice_free (ShadowEntry, entry);
+}
+
+static void
+shadow_cache_trim (ScreenInfo *screen_info, gsize max_bytes)
+{
+    ShadowEntry *entry;
+
+    /* Only unused entries are in the LRU queue, oldest at the tail */
+    while ((screen_info->shadow_cache_bytes > max_bytes) &&
+           !g_queue_is_empty (screen_info->shadow_lru))
+    {
+        entry = (ShadowEntry *) g_queue_pop_tail (screen_info->shadow_lru);
+        entry->lru_link = NULL;
+        g_hash_table_remove (screen_info->shadow_cache, entry);
+        TRACE ("evicting shadow %ix%i opacity %i", entry->width, entry->height, entry->opacity);
+        shadow_entry_free (screen_info, entry);
+    }
+}
+
+static gboolean
+shadow_cache_remove_cb (gpointer key, gpointer value, gpointer user_data)
+{
+    ShadowEntry *entry = (ShadowEntry *) value;
+    ScreenInfo *screen_info = (ScreenInfo *) user_data;
+
+    shadow_entry_free (screen_info, entry);
+
+    return TRUE;
+}
+
+static void
+shadow_cache_flush (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("entering");
+
+    if (screen_info->shadow_cache == NULL)
+    {
+        return;
+    }
+
+    /* Entries still in use by windows are kept, they go once released */
+    shadow_cache_trim (screen_info, 0);
+}
+
+static void
+shadow_cache_destroy (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("entering");
+
+    if (screen_info->shadow_cache == NULL)
+    {
+        return;
+    }
+
+    g_queue_free (screen_info->shadow_lru);
+    screen_info->shadow_lru = NULL;
+    g_hash_table_foreach_remove (screen_info->shadow_cache, shadow_cache_remove_cb, screen_info);
+    g_hash_table_destroy (screen_info->shadow_cache);
+    screen_info->shadow_cache = NULL;
+    screen_info->shadow_cache_bytes = 0;
+}
+
+static ShadowEntry *
+shadow_cache_lookup (ScreenInfo *screen_info, gdouble opacity, gint width, gint height)
+{
+    ShadowEntry key;
+    ShadowEntry *entry;
+    gint64 start;
+
+    g_return_val_if_fail (screen_info != NULL, NULL);
+    TRACE ("%ix%i opacity %.2f", width, height, opacity);
+
+    key.width = width;
+    key.height = height;
+    key.opacity = (gint) (CLAMP (opacity, 0.0, 1.0) * SHADOW_CACHE_OPACITY_STEPS + 0.5);
+
+    entry = g_hash_table_lookup (screen_info->shadow_cache, &key);
+    if (entry)
+    {
+        if (entry->lru_link)
+        {
+            g_queue_delete_link (screen_info->shadow_lru, entry->lru_link);
+            entry->lru_link = NULL;
+        }
+        entry->ref_count++;
+
+        return entry;
+    }
+
+    entry = g_slice_new0 (ShadowEntry);
+    entry->width = key.width;
+    entry->height = key.height;
+    entry->opacity = key.opacity;
+    start = g_get_monotonic_time ();
+    entry->picture = shadow_picture (screen_info,
+                                     (gdouble) key.opacity / SHADOW_CACHE_OPACITY_STEPS,
+                                     width, height,
+                                     &entry->shadow_width, &entry->shadow_height);
+    screen_info->stats.shadow_time += g_get_monotonic_time () - start;
+    if (entry->picture == None)
+    {
+        g_slice_free (ShadowEntry, entry);
+        return NULL;
+    }
+    entry->ref_count = 1;
+    screen_info->stats.shadows_built++;
+
+    g_hash_table_insert (screen_info->shadow_cache, entry, entry);
+    screen_info->shadow_cache_bytes += shadow_entry_bytes (entry);
+    DBG ("shadow cache size %lu bytes, %u entries",
+         (unsigned long) screen_info->shadow_cache_bytes,
+         g_hash_table_size (screen_info->shadow_cache));
+
+    return entry;
+}
+
+static void
+shadow_cache_release (ScreenInfo *screen_info, ShadowEntry *entry)
+{
+    g_return_if_fail (screen_info != NULL);
+    g_return_if_fail (entry != NULL);
+    g_return_if_fail (entry->ref_count > 0);
+
+    entry->ref_count--;
+    if (entry->ref_count == 0)
+    {
+        g_queue_push_head (screen_info->shadow_lru, entry);
+        entry->lru_link = g_queue_peek_head_link (screen_info->shadow_lru);
+        shadow_cache_trim (screen_info, SHADOW_CACHE_MAX_BYTES);
+    }
+}
+
+#ifdef HAVE_EPOXY
+static void
+free_glx_window (CWindow *cw, gboolean delete)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = cw->screen_info;
+    if (!screen_info->use_glx_scene || !screen_info->glx_context)
+    {
+        return;
+    }
+
+    if (cw->glx_pixmap)
+    {
+        glXDestroyPixmap (myScreenGetXDisplay (screen_info), cw->glx_pixmap);
+        cw->glx_pixmap = None;
+    }
+
+    if (delete)
+    {
+        if (cw->texture)
+        {
+            glDeleteTextures (1, &cw->texture);
+            cw->texture = 0;
+        }
+    }
+}
+#endif /* HAVE_EPOXY */
+
+static void
+free_win_shadow (CWindow *cw)
+{
+    g_return_if_fail (cw != NULL);
+
+    if (cw->shadow_entry)
+    {
+        shadow_cache_release (cw->screen_info, cw->shadow_entry);
+        cw->shadow_entry = NULL;
+    }
+    /* Shadow slices are shared and owned by the screen */
+    cw->shadow_slices = NULL;
+    cw->shadow = None;
+}
+
+static Picture
+solid_picture (ScreenInfo *screen_info, gboolean argb,
+               gdouble a, gdouble r, gdouble g, gdouble b)
+{
+    DisplayInfo *display_info;
+    Pixmap pixmap;
+    Picture picture;
+    XRenderPictureAttributes pa;
+    XRenderPictFormat *render_format;
+    XRenderColor c;
+
+    g_return_val_if_fail (screen_info, None);
+    TRACE ("entering");
+
+    display_info = screen_info->display_info;
+    render_format = XRenderFindStandardFormat (display_info->dpy,
+                                    argb ? PictStandardARGB32 : PictStandardA8);
+    g_return_val_if_fail (render_format != NULL , None);
+
+    pixmap = XCreatePixmap (display_info->dpy,
+                            screen_info->output, 1, 1, argb ? 32 : 8);
+    g_return_val_if_fail (pixmap != None, None);
+
+    pa.repeat = TRUE;
+    picture = XRenderCreatePicture (display_info->dpy, pixmap,
+                                    render_format, CPRepeat, &pa);
+    if (picture == None)
+    {
+        XFreePixmap (display_info->dpy, pixmap);
+        g_warning ("(picture != None) failed");
+        return None;
+    }
+
+    c.alpha = a * 0xffff;
+    c.red   = r * 0xffff;
+    c.green = g * 0xffff;
+    c.blue  = b * 0xffff;
+
+    XRenderFillRectangle (display_info->dpy, PictOpSrc,
+                          picture, &c, 0, 0, 1, 1);
+    XFreePixmap (display_info->dpy, pixmap);
+
+    return picture;
+}
+
+static cairo_region_t *
+region_from_xrectangles (XRectangle *rects, gint nrects)
+{
+    cairo_rectangle_int_t *crects;
+    cairo_region_t *region;
+    gint i;
+
+    crects = g_new (cairo_rectangle_int_t, MAX (nrects, 1));
+    for (i = 0; i < nrects; i++)
+    {
+        crects[i].x = rects[i].x;
+        crects[i].y = rects[i].y;
+        crects[i].width = rects[i].width;
+        crects[i].height = rects[i].height;
+    }
+    region = cairo_region_create_rectangles (crects, nrects);
+    g_free (crects);
+
+    return region;
+}
+
+static XRectangle *
+region_to_xrectangles (cairo_region_t *region, gint *nrects)
+{
+    cairo_rectangle_int_t rect;
+    XRectangle *rects;
+    gint i, n;
+
+    n = cairo_region_num_rectangles (region);
+    rects = g_new (XRectangle, MAX (n, 1));
+    for (i = 0; i < n; i++)
+    {
+        cairo_region_get_rectangle (region, i, &rect);
+        rects[i].x = rect.x;
+        rects[i].y = rect.y;
+        rects[i].width = rect.width;
+        rects[i].height = rect.height;
+    }
+    *nrects = n;
+
+    return rects;
+}
+
+static XserverRegion
+region_to_server_region (Display *dpy, cairo_region_t *region)
+{
+    XserverRegion server_region;
+    XRectangle *rects;
+    gint nrects;
+
+    rects = region_to_xrectangles (region, &nrects);
+    server_region = XFixesCreateRegion (dpy, rects, nrects);
+    g_free (rects);
+
+    return server_region;
+}
+
+static void
+set_picture_clip_region (Display *dpy, Picture picture, cairo_region_t *region)
+{
+    XRectangle *rects;
+    gint nrects;
+
+    if (region == NULL)
+    {
+        XFixesSetPictureClipRegion (dpy, picture, 0, 0, None);
+        return;
+    }
+
+    rects = region_to_xrectangles (region, &nrects);
+    XRenderSetPictureClipRectangles (dpy, picture, 0, 0, rects, nrects);
+    g_free (rects);
+}
+
+static void
+reset_paint_clip (ScreenInfo *screen_info)
+{
+    if (screen_info->clip_region)
+    {
+        cairo_region_destroy (screen_info->clip_region);
+        screen_info->clip_region = NULL;
+    }
+    screen_info->clip_picture = None;
+    screen_info->clip_valid = FALSE;
+}
+
+/*
+ * Same as set_picture_clip_region () but remembers the last clip set,
+ * so that setting the same clip again costs no request.
+ */
+static void
+set_paint_clip_region (ScreenInfo *screen_info, Picture picture, cairo_region_t *region)
+{
+    if (screen_info->clip_valid && (screen_info->clip_picture == picture))
+    {
+        if ((region == NULL) && (screen_info->clip_region == NULL))
+        {
+            screen_info->stats.clips_reused++;
+            return;
+        }
+        if (region && screen_info->clip_region &&
+            cairo_region_equal (region, screen_info->clip_region))
+        {
+            screen_info->stats.clips_reused++;
+            return;
+        }
+    }
+
+    set_picture_clip_region (myScreenGetXDisplay (screen_info), picture, region);
+    reset_paint_clip (screen_info);
+    screen_info->clip_picture = picture;
+    screen_info->clip_region = region ? cairo_region_copy (region) : NULL;
+    screen_info->clip_valid = TRUE;
+}
+
+static void
+translate_to_client_region (CWindow *cw, cairo_region_t *region)
+{
+    int x, y;
+
+    g_return_if_fail (cw != NULL);
+    TRACE ("window 0x%lx", cw->id);
+
+    if (WIN_HAS_FRAME(cw))
+    {
+        x = frameX (cw->c) + frameLeft (cw->c);
+        y = frameY (cw->c) + frameTop (cw->c);
+    }
+    else
     {
         x = cw->attr.x + cw->attr.border_width;
         y = cw->attr.y + cw->attr.border_width;
     }
 
-    XFixesTranslateRegion (display_info->dpy, region, x, y);
+    cairo_region_translate (region, x, y);
 }
 
-static XserverRegion
+static cairo_region_t *
 client_size (CWindow *cw)
 {
-    DisplayInfo *display_info;
-    ScreenInfo *screen_info;
-    XserverRegion border;
+    cairo_region_t *border;
 
-    g_return_val_if_fail (cw != NULL, None);
+    g_return_val_if_fail (cw != NULL, NULL);
     TRACE ("window 0x%lx", cw->id);
 
-    screen_info = cw->screen_info;
-    display_info = screen_info->display_info;
-    border = None;
+    border = NULL;
 
     if (WIN_HAS_FRAME(cw))
     {
-        XRectangle  r;
+        cairo_rectangle_int_t r;
         Client *c;
 
         c = cw->c;
@@ -774,35 +1649,65 @@ client_size (CWindow *cw)
         r.y = frameY (c) + frameTop (c);
         r.width = frameWidth (c) - frameLeft (c) - frameRight (c);
         r.height = frameHeight (c) - frameTop (c) - frameBottom (c);
-        border = XFixesCreateRegion (display_info->dpy, &r, 1);
+        border = cairo_region_create_rectangle (&r);
     }
 
     return border;
 }
 
-static XserverRegion
+static cairo_region_t *
 border_size (CWindow *cw)
 {
     DisplayInfo *display_info;
     ScreenInfo *screen_info;
-    XserverRegion border;
+    cairo_region_t *border;
+    XRectangle *rects;
+    XRectangle r;
+    int nrects, ordering;
 
-    g_return_val_if_fail (cw != NULL, None);
+    g_return_val_if_fail (cw != NULL, NULL);
     TRACE ("window 0x%lx", cw->id);
 
     screen_info = cw->screen_info;
     display_info = screen_info->display_info;
+
+    /* Only shaped windows need to query the server for their bounding region */
+    if ((cw->shaped) && (display_info->have_shape))
+    {
+        myDisplayErrorTrapPush (display_info);
+        rects = XShapeGetRectangles (display_info->dpy, cw->id, ShapeBounding,
+                                     &nrects, &ordering);
+        if (myDisplayErrorTrapPop (display_info) != Success)
+        {
+            if (rects)
+            {
+                XFree (rects);
+            }
+            return NULL;
+        }
+    }
+    else
+    {
+        r.x = - cw->attr.border_width;
+        r.y = - cw->attr.border_width;
+        r.width = cw->attr.width + 2 * cw->attr.border_width;
+        r.height = cw->attr.height + 2 * cw->attr.border_width;
+        rects = &r;
+        nrects = 1;
+    }
+
     myDisplayErrorTrapPush (display_info);
-    border = XFixesCreateRegionFromWindow (display_info->dpy,
-                                           cw->id, WindowRegionBounding);
-    XFixesSetPictureClipRegion (display_info->dpy, cw->picture, 0, 0, border);
-    XFixesTranslateRegion (display_info->dpy, border,
-                           cw->attr.x + cw->attr.border_width,
-                           cw->attr.y + cw->attr.border_width);
+    XRenderSetPictureClipRectangles (display_info->dpy, cw->picture, 0, 0,
+                                     rects, nrects);
+    myDisplayErrorTrapPopIgnored (display_info);
 
-    if (myDisplayErrorTrapPop (display_info) != Success)
+    border = region_from_xrectangles (rects, nrects);
+    cairo_region_translate (border,
+                            cw->attr.x + cw->attr.border_width,
+                            cw->attr.y + cw->attr.border_width);
+    if ((rects) && (rects != &r))
     {
-        return None;
+        XFree (rects);
     }
 
     return border;
@@ -818,19 +1723,31 @@ free_win_data (CWindow *cw, gboolean delete)
     display_info = screen_info->display_info;
 
     myDisplayErrorTrapPush (display_info);
+#ifdef HAVE_EPOXY
+    /* The GLX pixmap goes along with the window pixmap it was created for */
+    free_glx_window (cw, delete);
+#endif /* HAVE_EPOXY */
 #if HAVE_NAME_WINDOW_PIXMAP
+    if ((cw->saved_pixmap) && (delete || cw->name_window_pixmap))
+    {
+        XFreePixmap (display_info->dpy, cw->saved_pixmap);
+        cw->saved_pixmap = None;
+    }
     if (cw->name_window_pixmap)
     {
-        XFreePixmap (display_info->dpy, cw->name_window_pixmap);
+        if (delete)
+        {
+            XFreePixmap (display_info->dpy, cw->name_window_pixmap);
+        }
+        else
+        {
+            cw->saved_pixmap = cw->name_window_pixmap;
+        }
         cw->name_window_pixmap = None;
     }
 #endif
 
-    if (cw->shadow)
-    {
-        XRenderFreePicture (display_info->dpy, cw->shadow);
-        cw->shadow = None;
-    }
+    free_win_shadow (cw);
 
     if (cw->alphaPict)
     {
@@ -852,40 +1769,53 @@ free_win_data (CWindow *cw, gboolean delete)
 
     if (cw->borderSize)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->borderSize);
-        cw->borderSize = None;
+        cairo_region_destroy (cw->borderSize);
+        cw->borderSize = NULL;
     }
 
     if (cw->clientSize)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->clientSize);
-        cw->clientSize = None;
+        cairo_region_destroy (cw->clientSize);
+        cw->clientSize = NULL;
+    }
+
+    if (cw->opaqueClip)
+    {
+        cairo_region_destroy (cw->opaqueClip);
+        cw->opaqueClip = NULL;
     }
 
     if (cw->borderClip)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->borderClip);
-        cw->borderClip = None;
+        cairo_region_destroy (cw->borderClip);
+        cw->borderClip = NULL;
     }
 
     if (cw->extents)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->extents);
-        cw->extents = None;
+        cairo_region_destroy (cw->extents);
+        cw->extents = NULL;
+    }
+
+    if (cw->visible_region)
+    {
+        cairo_region_destroy (cw->visible_region);
+        cw->visible_region = NULL;
+    }
+    screen_info->clipChanged = TRUE;
+
+    if (cw->picture)
+    {
+        XRenderFreePicture (display_info->dpy, cw->picture);
+        cw->picture = None;
     }
 
     if (delete)
     {
-        if (cw->picture)
-        {
-            XRenderFreePicture (display_info->dpy, cw->picture);
-            cw->picture = None;
-        }
-        /* No need to keep this around */
-        if (cw->saved_picture)
+        if (cw->thumbnail)
         {
-            XRenderFreePicture (display_info->dpy, cw->saved_picture);
-            cw->saved_picture = None;
+            cairo_surface_destroy (cw->thumbnail);
+            cw->thumbnail = NULL;
         }
 
         if (cw->damage)
@@ -896,21 +1826,12 @@ free_win_data (CWindow *cw, gboolean delete)
 
         if (cw->opaque_region)
         {
-            XFixesDestroyRegion (display_info->dpy, cw->opaque_region);
-            cw->opaque_region = None;
+            cairo_region_destroy (cw->opaque_region);
+            cw->opaque_region = NULL;
         }
 
         g_slice_free (CWindow, cw);
     }
-    else
-    {
-        if (cw->saved_picture)
-        {
-            XRenderFreePicture (display_info->dpy, cw->saved_picture);
-        }
-        cw->saved_picture = cw->picture;
-        cw->picture = None;
-    }
     myDisplayErrorTrapPopIgnored (display_info);
 }
 
@@ -1069,6 +1990,59 @@ cursor_to_picture (ScreenInfo *screen_info, XFixesCursorImage *cursor)
     return picture;
 }
 
+static gboolean
+cursor_cache_remove_cb (gpointer key, gpointer value, gpointer user_data)
+{
+    CursorEntry *entry = (CursorEntry *) value;
+    ScreenInfo *screen_info = (ScreenInfo *) user_data;
+
+    if (entry->picture)
+    {
+        XRenderFreePicture (myScreenGetXDisplay (screen_info), entry->picture);
+    }
+    g_free (entry);
+
+    return TRUE;
+}
+
+static void
+cursor_cache_flush (ScreenInfo *screen_info)
+{
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("entering");
+
+    if (screen_info->cursor_cache == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_foreach_remove (screen_info->cursor_cache, cursor_cache_remove_cb, screen_info);
+    screen_info->cursorPicture = None;
+    screen_info->cursorSerial = 0;
+}
+
+static CursorEntry *
+cursor_cache_add (ScreenInfo *screen_info, XFixesCursorImage *cursor)
+{
+    CursorEntry *entry;
+
+    if (g_hash_table_size (screen_info->cursor_cache) >= CURSOR_CACHE_SIZE)
+    {
+        cursor_cache_flush (screen_info);
+    }
+
+    entry = g_new0 (CursorEntry, 1);
+    entry->picture = cursor_to_picture (screen_info, cursor);
+    entry->xhot = cursor->xhot;
+    entry->yhot = cursor->yhot;
+    entry->width = cursor->width;
+    entry->height = cursor->height;
+    g_hash_table_insert (screen_info->cursor_cache,
+                         GUINT_TO_POINTER (cursor->cursor_serial), entry);
+
+    return entry;
+}
+
 #ifdef HAVE_EPOXY
 static gboolean
 check_gl_error (void)
@@ -1158,6 +2132,12 @@ check_glx_renderer (ScreenInfo *screen_info)
     }
 #endif /* HAVE_PRESENT_EXTENSION */
 
+    /* The GL scene is an explicit choice, software renderers included */
+    if (screen_info->vblank_mode == VBLANK_GLX_SCENE)
+    {
+        return TRUE;
+    }
+
     i = 0;
     while (blacklisted[i] && !strcasestr (glRenderer, blacklisted[i]))
         i++;
@@ -1356,6 +2336,100 @@ choose_glx_settings (ScreenInfo *screen_info)
     return TRUE;
 }
 
+static gboolean
+choose_glx_argb_settings (ScreenInfo *screen_info)
+{
+    static GLint visual_attribs[] = {
+        GLX_DRAWABLE_TYPE,            GLX_PIXMAP_BIT,
+        GLX_X_RENDERABLE,             True,
+        GLX_BIND_TO_TEXTURE_RGBA_EXT, True,
+        GLX_RENDER_TYPE,              GLX_RGBA_BIT,
+        GLX_ALPHA_SIZE,               8,
+        None
+    };
+    int n_configs, i;
+    int value, status;
+    int target_bit;
+    GLXFBConfig *configs;
+    XVisualInfo *visual_info;
+    gboolean fb_match;
+
+    g_return_val_if_fail (screen_info != NULL, FALSE);
+    TRACE ("entering");
+
+    configs = glXChooseFBConfig (myScreenGetXDisplay (screen_info),
+                                 screen_info->screen,
+                                 visual_attribs,
+                                 &n_configs);
+    if (configs == NULL)
+    {
+        return FALSE;
+    }
+
+    if (screen_info->texture_target == GLX_TEXTURE_RECTANGLE_EXT)
+    {
+        target_bit = GLX_TEXTURE_RECTANGLE_BIT_EXT;
+    }
+    else
+    {
+        target_bit = GLX_TEXTURE_2D_BIT_EXT;
+    }
+
+    /* ARGB windows need a config matching their 32 bit visuals */
+    fb_match = FALSE;
+    for (i = 0; i < n_configs; i++)
+    {
+        visual_info = glXGetVisualFromFBConfig (myScreenGetXDisplay (screen_info),
+                                                configs[i]);
+        if (!visual_info)
+        {
+            continue;
+        }
+        value = visual_info->depth;
+        XFree (visual_info);
+        if (value != 32)
+        {
+            continue;
+        }
+
+        status = glXGetFBConfigAttrib (myScreenGetXDisplay (screen_info),
+                                       configs[i],
+                                       GLX_BIND_TO_TEXTURE_TARGETS_EXT,
+                                       &value);
+        if (status != Success || !(value & target_bit))
+        {
+            continue;
+        }
+
+        screen_info->glx_fbconfig_argb = configs[i];
+        fb_match = TRUE;
+        break;
+    }
+    XFree(configs);
+
+    if (!fb_match)
+    {
+        g_warning ("Cannot find a GLX frame buffer config for ARGB windows.");
+    }
+
+    return fb_match;
+}
+
+static void
+reset_glx_damage (ScreenInfo *screen_info)
+{
+    gint i;
+
+    for (i = 0; i < GLX_DAMAGE_HISTORY; i++)
+    {
+        if (screen_info->glx_damage[i])
+        {
+            cairo_region_destroy (screen_info->glx_damage[i]);
+            screen_info->glx_damage[i] = NULL;
+        }
+    }
+}
+
 static void
 free_glx_data (ScreenInfo *screen_info)
 {
@@ -1366,6 +2440,7 @@ free_glx_data (ScreenInfo *screen_info)
     display_info = screen_info->display_info;
     myDisplayErrorTrapPush (display_info);
 
+    reset_glx_damage (screen_info);
     glXMakeCurrent (myScreenGetXDisplay (screen_info), None, NULL);
 
     if (screen_info->glx_context)
@@ -1493,6 +2568,17 @@ init_glx (ScreenInfo *screen_info)
     screen_info->has_ext_swap_control_tear =
         epoxy_has_glx_extension (myScreenGetXDisplay (screen_info),
                                  screen_info->screen, "GLX_EXT_swap_control_tear");
+    /* Partial updates */
+    screen_info->has_ext_buffer_age =
+        epoxy_has_glx_extension (myScreenGetXDisplay (screen_info),
+                                 screen_info->screen, "GLX_EXT_buffer_age");
+    screen_info->has_mesa_copy_sub_buffer =
+        epoxy_has_glx_extension (myScreenGetXDisplay (screen_info),
+                                 screen_info->screen, "GLX_MESA_copy_sub_buffer");
+    /* Vblank timestamps and refresh rate */
+    screen_info->has_oml_sync_control =
+        epoxy_has_glx_extension (myScreenGetXDisplay (screen_info),
+                                 screen_info->screen, "GLX_OML_sync_control");
     /* Sync */
     screen_info->has_ext_arb_sync = epoxy_has_gl_extension ("GL_ARB_sync");
 
@@ -1737,6 +2823,8 @@ destroy_glx_drawable (ScreenInfo *screen_info, gushort buffer)
                          screen_info->glx_drawable[buffer]);
         screen_info->glx_drawable[buffer] = None;
     }
+    /* The back buffer content cannot be trusted anymore */
+    reset_glx_damage (screen_info);
 
     if (screen_info->rootTexture)
     {
@@ -1796,20 +2884,142 @@ redraw_glx_rects (ScreenInfo *screen_info, XRectangle *rects, int nrects)
         glTexCoord2f (texture_x1, texture_y2);
         glVertex2f (vertice_x1, vertice_y2);
     }
-    glEnd();
+    glEnd();
+}
+
+static void
+push_glx_damage (ScreenInfo *screen_info, cairo_region_t *region)
+{
+    gint i;
+
+    if (screen_info->glx_damage[GLX_DAMAGE_HISTORY - 1])
+    {
+        cairo_region_destroy (screen_info->glx_damage[GLX_DAMAGE_HISTORY - 1]);
+    }
+    for (i = GLX_DAMAGE_HISTORY - 1; i > 0; i--)
+    {
+        screen_info->glx_damage[i] = screen_info->glx_damage[i - 1];
+    }
+    screen_info->glx_damage[0] = cairo_region_copy (region);
+}
+
+static gboolean
+use_glx_copy_sub_buffer (ScreenInfo *screen_info)
+{
+#if USE_GLX_COPY_SUB_BUFFER
+    return (!screen_info->has_ext_buffer_age && screen_info->has_mesa_copy_sub_buffer);
+#else
+    return FALSE;
+#endif /* USE_GLX_COPY_SUB_BUFFER */
+}
+
+static guint
+get_glx_buffer_age (ScreenInfo *screen_info)
+{
+    unsigned int age;
+
+    age = 0;
+    if (screen_info->has_ext_buffer_age)
+    {
+        glXQueryDrawable (myScreenGetXDisplay (screen_info), screen_info->glx_window,
+                          GLX_BACK_BUFFER_AGE_EXT, &age);
+    }
+    else if (use_glx_copy_sub_buffer (screen_info) && screen_info->glx_damage[0])
+    {
+        /* The back buffer is never swapped, it always holds the last frame */
+        age = 1;
+    }
+
+    return (guint) age;
+}
+
+/*
+ * Returns the area of the back buffer to redraw so that it matches the
+ * root buffer again, or NULL if the whole buffer needs to be redrawn.
+ */
+static cairo_region_t *
+get_glx_redraw_region (ScreenInfo *screen_info, cairo_region_t *damage)
+{
+    cairo_region_t *redraw;
+    guint age;
+    guint i;
+
+    age = get_glx_buffer_age (screen_info);
+    TRACE ("back buffer age %u", age);
+    if ((age == 0) || (age > GLX_DAMAGE_HISTORY + 1))
+    {
+        return NULL;
+    }
+
+    /* The buffer misses the damage of the (age - 1) previous frames */
+    redraw = cairo_region_copy (damage);
+    for (i = 0; i < age - 1; i++)
+    {
+        if (screen_info->glx_damage[i] == NULL)
+        {
+            cairo_region_destroy (redraw);
+            return NULL;
+        }
+        cairo_region_union (redraw, screen_info->glx_damage[i]);
+    }
+
+    return redraw;
+}
+
+static void
+present_glx_rects (ScreenInfo *screen_info, XRectangle *rects, int nrects)
+{
+    int i;
+
+    if (!use_glx_copy_sub_buffer (screen_info))
+    {
+        glXSwapBuffers (myScreenGetXDisplay (screen_info),
+                        screen_info->glx_window);
+        return;
+    }
+
+    /* GL has its origin at the bottom left corner */
+    for (i = 0; i < nrects; i++)
+    {
+        glXCopySubBufferMESA (myScreenGetXDisplay (screen_info),
+                              screen_info->glx_window,
+                              rects[i].x,
+                              screen_info->height - rects[i].y - rects[i].height,
+                              rects[i].width, rects[i].height);
+    }
+    glFlush ();
 }
 
+static void update_vblank_timing (ScreenInfo *screen_info, gint64 ust, guint64 msc);
+
 static void
-redraw_glx_screen (ScreenInfo *screen_info)
+update_glx_vblank_timing (ScreenInfo *screen_info)
 {
-    XRectangle root_rect = { 0, 0, screen_info->width, screen_info->height};
+    int64_t ust, msc, sbc;
+
+    /*
+     * The time the swap returns says little of the actual vblank, without
+     * the OML timestamps repaints fall back to the short timeout instead.
+     */
+    if (!screen_info->has_oml_sync_control ||
+        !glXGetSyncValuesOML (myScreenGetXDisplay (screen_info),
+                              screen_info->glx_window, &ust, &msc, &sbc))
+    {
+        screen_info->vblank_time = 0;
+        return;
+    }
 
-    redraw_glx_rects (screen_info, &root_rect, 1);
+    update_vblank_timing (screen_info, (gint64) ust, (guint64) msc);
 }
 
 static void
-redraw_glx_texture (ScreenInfo *screen_info, gushort buffer)
+redraw_glx_texture (ScreenInfo *screen_info, cairo_region_t *region, gushort buffer)
 {
+    cairo_rectangle_int_t root_rect = { 0, 0, screen_info->width, screen_info->height };
+    cairo_region_t *damage;
+    cairo_region_t *redraw;
+    XRectangle *rects;
+    gint nrects;
 #ifdef DEBUG
     gint64 t1, t2;
 #endif /* DEBUG */
@@ -1840,6 +3050,23 @@ redraw_glx_texture (ScreenInfo *screen_info, gushort buffer)
     glMatrixMode(GL_TEXTURE);
     glPushMatrix();
 
+    /* The zoomed view is scaled from the whole root buffer */
+    if (screen_info->zoomed)
+    {
+        damage = cairo_region_create_rectangle (&root_rect);
+    }
+    else
+    {
+        damage = cairo_region_copy (region);
+    }
+
+    redraw = get_glx_redraw_region (screen_info, damage);
+    if (redraw == NULL)
+    {
+        redraw = cairo_region_create_rectangle (&root_rect);
+    }
+    rects = region_to_xrectangles (redraw, &nrects);
+
     if (screen_info->zoomed)
     {
         /* Reuse the values from the XRender matrix */
@@ -1867,10 +3094,15 @@ redraw_glx_texture (ScreenInfo *screen_info, gushort buffer)
         glTranslated (0.0, 0.0, 0.0);
     }
 
-    redraw_glx_screen (screen_info);
+    /* Only the areas of the back buffer that are out of date are drawn */
+    redraw_glx_rects (screen_info, rects, nrects);
+    present_glx_rects (screen_info, rects, nrects);
+    update_glx_vblank_timing (screen_info);
 
-    glXSwapBuffers (myScreenGetXDisplay (screen_info),
-                    screen_info->glx_window);
+    push_glx_damage (screen_info, damage);
+    cairo_region_destroy (damage);
+    cairo_region_destroy (redraw);
+    g_free (rects);
 
     glPopMatrix();
 
@@ -1892,6 +3124,370 @@ redraw_glx_texture (ScreenInfo *screen_info, gushort buffer)
 
     check_gl_error();
 }
+
+/*
+ * Draws the given region, in screen coordinates, from the texture
+ * currently bound, whose top left corner is at x, y on screen.
+ */
+/*
+ * Draws the part of the region within dst, mapping dst onto the
+ * texels sx, sy, sw, sh of a texture of tex_width x tex_height.
+ */
+static void
+draw_glx_mapped_rects (ScreenInfo *screen_info, cairo_region_t *region,
+                       cairo_rectangle_int_t *dst,
+                       double sx, double sy, double sw, double sh,
+                       gint tex_width, gint tex_height)
+{
+    cairo_rectangle_int_t rect;
+    double zoom, xp, yp;
+    double tx1, ty1, tx2, ty2;
+    double vx1, vy1, vx2, vy2;
+    int x1, y1, x2, y2;
+    int i, n;
+
+    if ((dst->width < 1) || (dst->height < 1))
+    {
+        return;
+    }
+
+    zoom = XFixedToDouble (screen_info->transform.matrix[0][0]);
+    xp = XFixedToDouble (screen_info->transform.matrix[0][2]);
+    yp = XFixedToDouble (screen_info->transform.matrix[1][2]);
+
+    n = cairo_region_num_rectangles (region);
+    glBegin(GL_QUADS);
+    for (i = 0; i < n; i++)
+    {
+        cairo_region_get_rectangle (region, i, &rect);
+
+        x1 = MAX (rect.x, dst->x);
+        y1 = MAX (rect.y, dst->y);
+        x2 = MIN (rect.x + rect.width, dst->x + dst->width);
+        y2 = MIN (rect.y + rect.height, dst->y + dst->height);
+        if ((x1 >= x2) || (y1 >= y2))
+        {
+            continue;
+        }
+        rect.x = x1;
+        rect.y = y1;
+        rect.width = x2 - x1;
+        rect.height = y2 - y1;
+
+        tx1 = sx + (x1 - dst->x) * sw / dst->width;
+        ty1 = sy + (y1 - dst->y) * sh / dst->height;
+        tx2 = sx + (x2 - dst->x) * sw / dst->width;
+        ty2 = sy + (y2 - dst->y) * sh / dst->height;
+        if (screen_info->texture_type != GL_TEXTURE_RECTANGLE_ARB)
+        {
+            tx1 /= tex_width;
+            ty1 /= tex_height;
+            tx2 /= tex_width;
+            ty2 /= tex_height;
+        }
+
+        /* Same mapping as the XRender zoom transform, identity otherwise */
+        vx1 = 2.0 * ((rect.x - xp) / zoom) / screen_info->width - 1.0;
+        vy1 = -2.0 * ((rect.y - yp) / zoom) / screen_info->height + 1.0;
+        vx2 = 2.0 * ((rect.x + rect.width - xp) / zoom) / screen_info->width - 1.0;
+        vy2 = -2.0 * ((rect.y + rect.height - yp) / zoom) / screen_info->height + 1.0;
+
+        glTexCoord2d (tx1, ty1);
+        glVertex2d (vx1, vy1);
+        glTexCoord2d (tx2, ty1);
+        glVertex2d (vx2, vy1);
+        glTexCoord2d (tx2, ty2);
+        glVertex2d (vx2, vy2);
+        glTexCoord2d (tx1, ty2);
+        glVertex2d (vx1, vy2);
+    }
+    glEnd();
+}
+
+static void
+draw_glx_scene_rects (ScreenInfo *screen_info, cairo_region_t *region,
+                      gint x, gint y, gint width, gint height)
+{
+    cairo_rectangle_int_t dst;
+
+    dst.x = x;
+    dst.y = y;
+    dst.width = width;
+    dst.height = height;
+    draw_glx_mapped_rects (screen_info, region, &dst,
+                           0.0, 0.0, width, height, width, height);
+}
+
+static void
+set_glx_texture_filter (ScreenInfo *screen_info)
+{
+    GLint filter;
+
+    filter = screen_info->zoomed ? screen_info->texture_filter : GL_NEAREST;
+    glTexParameteri (screen_info->texture_type, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri (screen_info->texture_type, GL_TEXTURE_MAG_FILTER, filter);
+}
+
+static gboolean
+bind_glx_window (CWindow *cw)
+{
+    ScreenInfo *screen_info;
+    DisplayInfo *display_info;
+    GLXFBConfig fb_config;
+    int pixmap_attribs[] = {
+        GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+        GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGB_EXT,
+        None
+    };
+
+    screen_info = cw->screen_info;
+    display_info = screen_info->display_info;
+
+#if HAVE_NAME_WINDOW_PIXMAP
+    if (cw->name_window_pixmap == None)
+    {
+        return FALSE;
+    }
+
+    if (cw->glx_pixmap == None)
+    {
+        pixmap_attribs[1] = screen_info->texture_target;
+        if (WIN_IS_ARGB(cw))
+        {
+            fb_config = screen_info->glx_fbconfig_argb;
+            pixmap_attribs[3] = GLX_TEXTURE_FORMAT_RGBA_EXT;
+        }
+        else if (cw->attr.depth == screen_info->depth)
+        {
+            fb_config = screen_info->glx_fbconfig;
+            pixmap_attribs[3] = screen_info->texture_format;
+        }
+        else
+        {
+            TRACE ("no GLX config for depth %i of window 0x%lx", cw->attr.depth, cw->id);
+            return FALSE;
+        }
+
+        myDisplayErrorTrapPush (display_info);
+        cw->glx_pixmap = glXCreatePixmap (display_info->dpy, fb_config,
+                                          cw->name_window_pixmap, pixmap_attribs);
+        if (myDisplayErrorTrapPop (display_info) != Success)
+        {
+            cw->glx_pixmap = None;
+        }
+        if (cw->glx_pixmap == None)
+        {
+            return FALSE;
+        }
+    }
+
+    if (cw->texture == 0)
+    {
+        glGenTextures (1, &cw->texture);
+    }
+    glBindTexture (screen_info->texture_type, cw->texture);
+    glXBindTexImageEXT (display_info->dpy, cw->glx_pixmap, GLX_FRONT_EXT, NULL);
+    set_glx_texture_filter (screen_info);
+
+    return TRUE;
+#else
+    return FALSE;
+#endif /* HAVE_NAME_WINDOW_PIXMAP */
+}
+
+static void
+release_glx_window (CWindow *cw)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = cw->screen_info;
+    glXReleaseTexImageEXT (myScreenGetXDisplay (screen_info), cw->glx_pixmap, GLX_FRONT_EXT);
+    glBindTexture (screen_info->texture_type, 0);
+}
+
+static void
+set_glx_window_blend (CWindow *cw, double alpha)
+{
+    if (WIN_IS_ARGB(cw))
+    {
+        /* Window pixmaps have premultiplied alpha */
+        glEnable (GL_BLEND);
+        glBlendFunc (GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glColor4d (alpha, alpha, alpha, alpha);
+    }
+    else if (alpha < 1.0)
+    {
+        /* The alpha channel of other windows is undefined, ignore it */
+        glEnable (GL_BLEND);
+        glBlendColor (0.0, 0.0, 0.0, alpha);
+        glBlendFunc (GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+        glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    }
+    else
+    {
+        glDisable (GL_BLEND);
+        glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    }
+}
+
+static void
+draw_glx_shadow_slice (ScreenInfo *screen_info, cairo_region_t *region,
+                       gint x, gint y, gint width, gint height,
+                       double sx, double sy, double sw, double sh)
+{
+    cairo_rectangle_int_t dst;
+    gint size;
+
+    dst.x = x;
+    dst.y = y;
+    dst.width = width;
+    dst.height = height;
+    size = 2 * screen_info->gaussianSize + 1;
+    draw_glx_mapped_rects (screen_info, region, &dst, sx, sy, sw, sh, size, size);
+}
+
+static void
+paint_glx_shadow (CWindow *cw, cairo_region_t *region)
+{
+    ScreenInfo *screen_info;
+    ShadowEntry *entry;
+    XImage *shadow_image;
+    GLuint texture;
+    gint x, y, w, h;
+    double g, c;
+
+    screen_info = cw->screen_info;
+    x = cw->attr.x + cw->shadow_dx;
+    y = cw->attr.y + cw->shadow_dy;
+    w = cw->shadow_width;
+    h = cw->shadow_height;
+
+    /* Same shared shadows as XRender, uploaded once as textures */
+    texture = 0;
+    entry = cw->shadow_entry;
+    if (entry)
+    {
+        if (entry->texture == 0)
+        {
+            shadow_image = make_shadow (screen_info,
+                                        (gdouble) entry->opacity / SHADOW_CACHE_OPACITY_STEPS,
+                                        entry->width, entry->height);
+            if (shadow_image == NULL)
+            {
+                return;
+            }
+            entry->texture = a8_image_to_texture (screen_info, shadow_image);
+            XDestroyImage (shadow_image);
+        }
+        texture = entry->texture;
+    }
+#if SHADOW_NINE_SLICE
+    else if (cw->shadow_slices)
+    {
+        texture = cw->shadow_slices->texture;
+    }
+#endif /* SHADOW_NINE_SLICE */
+    if (texture == 0)
+    {
+        return;
+    }
+
+    glBindTexture (screen_info->texture_type, texture);
+    set_glx_texture_filter (screen_info);
+
+    /* Black, with the shadow as coverage */
+    glEnable (GL_BLEND);
+    glBlendFunc (GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glColor4d (0.0, 0.0, 0.0, 1.0);
+
+    if (entry)
+    {
+        draw_glx_scene_rects (screen_info, region, x, y, w, h);
+        glBindTexture (screen_info->texture_type, 0);
+        return;
+    }
+
+    /* Corners, then the edges and the center stretched from the middle texels */
+    g = screen_info->gaussianSize;
+    c = g + 0.5;
+    draw_glx_shadow_slice (screen_info, region, x, y, g, g, 0, 0, g, g);
+    draw_glx_shadow_slice (screen_info, region, x + w - g, y, g, g, g + 1, 0, g, g);
+    draw_glx_shadow_slice (screen_info, region, x, y + h - g, g, g, 0, g + 1, g, g);
+    draw_glx_shadow_slice (screen_info, region, x + w - g, y + h - g, g, g, g + 1, g + 1, g, g);
+    draw_glx_shadow_slice (screen_info, region, x + g, y, w - 2 * g, g, c, 0, 0, g);
+    draw_glx_shadow_slice (screen_info, region, x + g, y + h - g, w - 2 * g, g, c, g + 1, 0, g);
+    draw_glx_shadow_slice (screen_info, region, x, y + g, g, h - 2 * g, 0, c, g, 0);
+    draw_glx_shadow_slice (screen_info, region, x + w - g, y + g, g, h - 2 * g, g + 1, c, g, 0);
+    draw_glx_shadow_slice (screen_info, region, x + g, y + g, w - 2 * g, h - 2 * g, c, c, 0, 0);
+
+    glBindTexture (screen_info->texture_type, 0);
+}
+
+static void
+paint_glx_window (CWindow *cw, cairo_region_t *redraw)
+{
+    ScreenInfo *screen_info;
+    cairo_region_t *clip;
+    cairo_region_t *part;
+    double opacity;
+    gint width, height;
+
+    screen_info = cw->screen_info;
+
+    if (cw->borderSize == NULL)
+    {
+        screen_info->stats.windows_skipped++;
+        return;
+    }
+
+    clip = cairo_region_copy (cw->visible_region);
+    cairo_region_intersect (clip, redraw);
+    if (cairo_region_is_empty (clip))
+    {
+        cairo_region_destroy (clip);
+        screen_info->stats.windows_skipped++;
+        return;
+    }
+    screen_info->stats.windows_painted++;
+
+    if (WIN_HAS_SHADOW(cw))
+    {
+        part = cairo_region_copy (clip);
+        cairo_region_subtract (part, cw->borderSize);
+        paint_glx_shadow (cw, part);
+        cairo_region_destroy (part);
+    }
+
+    if (!bind_glx_window (cw))
+    {
+        cairo_region_destroy (clip);
+        return;
+    }
+
+    cairo_region_intersect (clip, cw->borderSize);
+    opacity = (double) cw->opacity / NET_WM_OPAQUE;
+    width = cw->attr.width + 2 * cw->attr.border_width;
+    height = cw->attr.height + 2 * cw->attr.border_width;
+
+    if (WIN_HAS_FRAME(cw) && (screen_info->params->frame_opacity < 100))
+    {
+        /* The frame has its own opacity */
+        part = cairo_region_copy (clip);
+        cairo_region_subtract (part, cw->clientSize);
+        set_glx_window_blend (cw, opacity * screen_info->params->frame_opacity / 100.0);
+        draw_glx_scene_rects (screen_info, part, cw->attr.x, cw->attr.y, width, height);
+        cairo_region_destroy (part);
+
+        cairo_region_intersect (clip, cw->clientSize);
+    }
+    set_glx_window_blend (cw, opacity);
+    draw_glx_scene_rects (screen_info, clip, cw->attr.x, cw->attr.y, width, height);
+
+    release_glx_window (cw);
+    cairo_region_destroy (clip);
+}
 #endif /* HAVE_EPOXY */
 
 #ifdef HAVE_PRESENT_EXTENSION
@@ -1903,10 +3499,18 @@ present_error (ScreenInfo *screen_info, int error_code)
     XGetErrorText (myScreenGetXDisplay (screen_info), error_code, buf, 63);
     g_warning ("Dismissing XPresent as unusable, error %i (%s)", error_code, buf);
 
-    screen_info->present_pending = FALSE;
+    screen_info->present_pending = 0;
     screen_info->use_present = FALSE;
 }
 
+static gboolean
+is_present_blocked (ScreenInfo *screen_info)
+{
+    /* Each buffer beyond the one on screen allows a frame to be queued */
+    return (screen_info->use_present &&
+            screen_info->present_pending >= (guint) MAX (screen_info->use_n_buffers - 1, 1));
+}
+
 static void
 present_flip (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
 {
@@ -1919,11 +3523,17 @@ present_flip (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
     TRACE ("serial %d", present_serial);
 
     display_info = screen_info->display_info;
+    screen_info->present_start[present_serial % N_BUFFERS] = g_get_monotonic_time ();
+    /*
+     * A single buffer is painted again as soon as the present completes,
+     * so it must be copied, never flipped.
+     */
     myDisplayErrorTrapPush (display_info);
     XPresentPixmap (display_info->dpy, screen_info->output,
                     screen_info->rootPixmap[buffer],
                     present_serial++, None, region, 0, 0, None, None, None,
-                    PresentOptionNone, 0, 1, 0, NULL, 0);
+                    (screen_info->use_n_buffers > 1) ? PresentOptionNone : PresentOptionCopy,
+                    0, 1, 0, NULL, 0);
     result = myDisplayErrorTrapPop (display_info);
 
     if (result != 0)
@@ -1932,23 +3542,21 @@ present_flip (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
         return;
     }
 
-    screen_info->present_pending = TRUE;
+    screen_info->present_pending++;
     DBG ("present flip requested, present pending...");
 }
 #endif /* HAVE_PRESENT_EXTENSION */
 
-static XserverRegion
+static cairo_region_t *
 win_extents (CWindow *cw)
 {
-    DisplayInfo *display_info;
     ScreenInfo *screen_info;
-    XRectangle r;
+    cairo_rectangle_int_t r;
 
-    g_return_val_if_fail (cw != NULL, None);
+    g_return_val_if_fail (cw != NULL, NULL);
     TRACE ("window 0x%lx", cw->id);
 
     screen_info = cw->screen_info;
-    display_info = screen_info->display_info;
     r.x = cw->attr.x;
     r.y = cw->attr.y;
     r.width = cw->attr.width + cw->attr.border_width * 2;
@@ -1978,24 +3586,57 @@ win_extents (CWindow *cw)
               !WIN_IS_OVERRIDE(cw) &&
               (!WIN_IS_SHAPED(cw))))
     {
-        XRectangle sr;
+        cairo_rectangle_int_t sr;
 
         TRACE ("window 0x%lx has extents", cw->id);
         cw->shadow_dx = SHADOW_OFFSET_X + screen_info->params->shadow_delta_x;
         cw->shadow_dy = SHADOW_OFFSET_Y + screen_info->params->shadow_delta_y;
 
-        if (!(cw->shadow))
+        if (!WIN_HAS_SHADOW(cw))
         {
             double shadow_opacity;
+            gint swidth, sheight;
+
             shadow_opacity = (double) screen_info->params->frame_opacity
                            * (screen_info->params->shadow_opacity / 100.0)
                            * cw->opacity
                            / (NET_WM_OPAQUE * 100.0);
 
-            cw->shadow = shadow_picture (screen_info, shadow_opacity,
-                                         cw->attr.width + 2 * cw->attr.border_width,
-                                         cw->attr.height + 2 * cw->attr.border_width,
-                                         &cw->shadow_width, &cw->shadow_height);
+            get_shadow_size (screen_info,
+                             cw->attr.width + 2 * cw->attr.border_width,
+                             cw->attr.height + 2 * cw->attr.border_width,
+                             &swidth, &sheight);
+#if SHADOW_NINE_SLICE
+            if ((screen_info->gaussianSize > 0) &&
+                (swidth >= 2 * screen_info->gaussianSize) &&
+                (sheight >= 2 * screen_info->gaussianSize))
+            {
+                cw->shadow_slices = get_shadow_slices (screen_info, shadow_opacity);
+            }
+#endif /* SHADOW_NINE_SLICE */
+            if (!cw->shadow_slices)
+            {
+                cw->shadow_entry = shadow_cache_lookup (screen_info, shadow_opacity,
+                                                        cw->attr.width + 2 * cw->attr.border_width,
+                                                        cw->attr.height + 2 * cw->attr.border_width);
+            }
+
+            if (cw->shadow_slices)
+            {
+                cw->shadow_width = swidth;
+                cw->shadow_height = sheight;
+            }
+            else if (cw->shadow_entry)
+            {
+                cw->shadow = cw->shadow_entry->picture;
+                cw->shadow_width = cw->shadow_entry->shadow_width;
+                cw->shadow_height = cw->shadow_entry->shadow_height;
+            }
+            else
+            {
+                cw->shadow_width = 0;
+                cw->shadow_height = 0;
+            }
         }
 
         sr.x = cw->attr.x + cw->shadow_dx;
@@ -2022,12 +3663,11 @@ win_extents (CWindow *cw)
             r.height = sr.y + sr.height - r.y;
         }
     }
-    else if (cw->shadow)
+    else if (WIN_HAS_SHADOW(cw))
     {
-        XRenderFreePicture (display_info->dpy, cw->shadow);
-        cw->shadow = None;
+        free_win_shadow (cw);
     }
-    return XFixesCreateRegion (display_info->dpy, &r, 1);
+    return cairo_region_create_rectangle (&r);
 }
 
 static void
@@ -2116,25 +3756,23 @@ get_window_picture (CWindow *cw)
     return None;
 }
 
-static XserverRegion
+static cairo_region_t *
 get_screen_region (ScreenInfo *screen_info)
 {
-    DisplayInfo *display_info;
-    XserverRegion region;
-    XRectangle  r;
+    cairo_region_t *region;
+    cairo_rectangle_int_t r;
 
-    display_info = screen_info->display_info;
     if (screen_info->width > 0 && screen_info->height > 0)
     {
         r.x = 0;
         r.y = 0;
         r.width = screen_info->width;
         r.height = screen_info->height;
-        region = XFixesCreateRegion (display_info->dpy, &r, 1);
+        region = cairo_region_create_rectangle (&r);
     }
     else
     {
-        region = XFixesCreateRegion (display_info->dpy, NULL, 0);
+        region = cairo_region_create ();
     }
 
     return region;
@@ -2187,10 +3825,9 @@ paint_root (ScreenInfo *screen_info, Picture paint_buffer)
 }
 
 static void
-paint_cursor (ScreenInfo *screen_info, XserverRegion region, Picture paint_buffer)
+paint_cursor (ScreenInfo *screen_info, cairo_region_t *region, Picture paint_buffer)
 {
-    XFixesSetPictureClipRegion (myScreenGetXDisplay (screen_info),
-                                paint_buffer, 0, 0, region);
+    set_paint_clip_region (screen_info, paint_buffer, region);
     XRenderComposite (myScreenGetXDisplay (screen_info),
                       PictOpOver,
                       screen_info->cursorPicture,
@@ -2203,7 +3840,58 @@ paint_cursor (ScreenInfo *screen_info, XserverRegion region, Picture paint_buffe
 }
 
 static void
-paint_win (CWindow *cw, XserverRegion region, Picture paint_buffer, gboolean solid_part)
+get_cursor_output_rect (ScreenInfo *screen_info, XRectangle *rect)
+{
+    double zoom, xp, yp;
+    int x1, y1, x2, y2;
+
+    zoom = XFixedToDouble (screen_info->transform.matrix[0][0]);
+    xp = XFixedToDouble (screen_info->transform.matrix[0][2]);
+    yp = XFixedToDouble (screen_info->transform.matrix[1][2]);
+
+    x1 = (int) floor ((screen_info->cursorLocation.x - xp) / zoom);
+    y1 = (int) floor ((screen_info->cursorLocation.y - yp) / zoom);
+    x2 = (int) ceil ((screen_info->cursorLocation.x + screen_info->cursorLocation.width - xp) / zoom);
+    y2 = (int) ceil ((screen_info->cursorLocation.y + screen_info->cursorLocation.height - yp) / zoom);
+
+    rect->x = x1;
+    rect->y = y1;
+    rect->width = x2 - x1;
+    rect->height = y2 - y1;
+}
+
+static void
+paint_cursor_plane (ScreenInfo *screen_info, Picture dest, XRectangle *rect)
+{
+    Display *dpy;
+    XTransform transform;
+
+    if (screen_info->cursorPicture == None)
+    {
+        return;
+    }
+
+    dpy = myScreenGetXDisplay (screen_info);
+
+    /* Same scale as the zoomed view, drawn over the output */
+    memset (&transform, 0, sizeof (XTransform));
+    transform.matrix[0][0] = screen_info->transform.matrix[0][0];
+    transform.matrix[1][1] = screen_info->transform.matrix[1][1];
+    transform.matrix[2][2] = 1 << 16;
+    XRenderSetPictureTransform (dpy, screen_info->cursorPicture, &transform);
+    XRenderSetPictureFilter (dpy, screen_info->cursorPicture, FilterBilinear, NULL, 0);
+
+    set_picture_clip_region (dpy, dest, NULL);
+    XRenderComposite (dpy, PictOpOver,
+                      screen_info->cursorPicture,
+                      None, dest,
+                      0, 0, 0, 0,
+                      rect->x, rect->y,
+                      rect->width, rect->height);
+}
+
+static void
+paint_win (CWindow *cw, cairo_region_t *region, Picture paint_buffer, gboolean solid_part)
 {
     ScreenInfo *screen_info;
     DisplayInfo *display_info;
@@ -2216,20 +3904,46 @@ paint_win (CWindow *cw, XserverRegion region, Picture paint_buffer, gboolean sol
     display_info = screen_info->display_info;
     paint_solid = (solid_part && WIN_IS_OPAQUE(cw));
 
-    if (WIN_HAS_FRAME(cw) && (screen_info->params->frame_opacity < 100))
-    {
-        int frame_x, frame_y, frame_width, frame_height;
-        int frame_top, frame_bottom, frame_left, frame_right;
-        frame_x = cw->attr.x;
-        frame_y = cw->attr.y;
-        frame_width = cw->attr.width;
-        frame_height = cw->attr.height;
-        frame_top = frameTop (cw->c);
-        frame_bottom = frameBottom (cw->c);
-        frame_left = frameLeft (cw->c);
-        frame_right = frameRight (cw->c);
+    if (WIN_HAS_FRAME(cw) && (screen_info->params->frame_opacity < 100))
+    {
+        int frame_x, frame_y, frame_width, frame_height;
+        int frame_top, frame_bottom, frame_left, frame_right;
+        frame_x = cw->attr.x;
+        frame_y = cw->attr.y;
+        frame_width = cw->attr.width;
+        frame_height = cw->attr.height;
+        frame_top = frameTop (cw->c);
+        frame_bottom = frameBottom (cw->c);
+        frame_left = frameLeft (cw->c);
+        frame_right = frameRight (cw->c);
+        /* Client Window */
+        if (paint_solid)
+        {
+            set_paint_clip_region (screen_info, paint_buffer, region);
+            XRenderComposite (display_info->dpy, PictOpSrc, cw->picture, None,
+                              paint_buffer,
+                              frame_left, frame_top,
+                              0, 0,
+                              frame_x + frame_left, frame_y + frame_top,
+                              frame_width - frame_left - frame_right, frame_height - frame_top - frame_bottom);
+
+            /* clientSize is set in paint_all() prior to calling paint_win() */
+            cairo_region_subtract (region, cw->clientSize);
+        }
+        else if (!solid_part)
+        {
+            XRenderComposite (display_info->dpy, PictOpOver, cw->picture, cw->alphaPict,
+                              paint_buffer,
+                              frame_left, frame_top,
+                              0, 0,
+                              frame_x + frame_left, frame_y + frame_top,
+                              frame_width - frame_left - frame_right, frame_height - frame_top - frame_bottom);
+        }
+
         if (!solid_part)
         {
+            cairo_region_t *frame_clip;
+
             if (!cw->alphaBorderPict)
             {
                 double frame_opacity;
@@ -2245,60 +3959,20 @@ paint_win (CWindow *cw, XserverRegion region, Picture paint_buffer, gboolean sol
                                                      0.0  /* blue  */);
             }
 
-            /* Top Border (title bar) */
+            /*
+             * The four borders share the source and mask, so they are
+             * drawn at once, clipped to the frame around the client.
+             */
+            frame_clip = cairo_region_copy (cw->borderClip ? cw->borderClip : cw->borderSize);
+            cairo_region_subtract (frame_clip, cw->clientSize);
+            set_paint_clip_region (screen_info, paint_buffer, frame_clip);
             XRenderComposite (display_info->dpy, PictOpOver, cw->picture, cw->alphaBorderPict,
                               paint_buffer,
                               0, 0,
                               0, 0,
                               frame_x, frame_y,
-                              frame_width, frame_top);
-
-            /* Bottom Border */
-            XRenderComposite (display_info->dpy, PictOpOver, cw->picture, cw->alphaBorderPict,
-                              paint_buffer,
-                              0, frame_height - frame_bottom,
-                              0, 0,
-                              frame_x, frame_y + frame_height - frame_bottom,
-                              frame_width, frame_bottom);
-            /* Left Border */
-            XRenderComposite (display_info->dpy, PictOpOver, cw->picture, cw->alphaBorderPict,
-                              paint_buffer,
-                              0, frame_top,
-                              0, 0,
-                              frame_x, frame_y + frame_top,
-                              frame_left, frame_height - frame_top - frame_bottom);
-
-            /* Right Border */
-            XRenderComposite (display_info->dpy, PictOpOver, cw->picture, cw->alphaBorderPict,
-                              paint_buffer,
-                              frame_width - frame_right, frame_top,
-                              0, 0,
-                              frame_x + frame_width - frame_right,
-                              frame_y + frame_top, frame_right,
-                              frame_height - frame_top - frame_bottom);
-        }
-        /* Client Window */
-        if (paint_solid)
-        {
-            XFixesSetPictureClipRegion (display_info->dpy, paint_buffer, 0, 0, region);
-            XRenderComposite (display_info->dpy, PictOpSrc, cw->picture, None,
-                              paint_buffer,
-                              frame_left, frame_top,
-                              0, 0,
-                              frame_x + frame_left, frame_y + frame_top,
-                              frame_width - frame_left - frame_right, frame_height - frame_top - frame_bottom);
-
-            /* clientSize is set in paint_all() prior to calling paint_win() */
-            XFixesSubtractRegion (display_info->dpy, region, region, cw->clientSize);
-        }
-        else if (!solid_part)
-        {
-            XRenderComposite (display_info->dpy, PictOpOver, cw->picture, cw->alphaPict,
-                              paint_buffer,
-                              frame_left, frame_top,
-                              0, 0,
-                              frame_x + frame_left, frame_y + frame_top,
-                              frame_width - frame_left - frame_right, frame_height - frame_top - frame_bottom);
+                              frame_width, frame_height);
+            cairo_region_destroy (frame_clip);
         }
     }
     else
@@ -2309,12 +3983,15 @@ paint_win (CWindow *cw, XserverRegion region, Picture paint_buffer, gboolean sol
         get_paint_bounds (cw, &x, &y, &w, &h);
         if (paint_solid)
         {
-            XFixesSetPictureClipRegion (display_info->dpy, paint_buffer, 0, 0, region);
+            set_paint_clip_region (screen_info, paint_buffer, region);
             XRenderComposite (display_info->dpy, PictOpSrc,
                               cw->picture, None,
                               paint_buffer,
                               0, 0, 0, 0, x, y, w, h);
-            XFixesSubtractRegion (display_info->dpy, region, region, cw->borderSize);
+            if (cw->borderSize)
+            {
+                cairo_region_subtract (region, cw->borderSize);
+            }
         }
         else if (!solid_part)
         {
@@ -2326,73 +4003,458 @@ paint_win (CWindow *cw, XserverRegion region, Picture paint_buffer, gboolean sol
     }
 }
 
+static cairo_region_t *
+get_opaque_clip (CWindow *cw)
+{
+    if (cw->opaque_region == NULL)
+    {
+        return NULL;
+    }
+
+    if (cw->opaqueClip == NULL)
+    {
+        cw->opaqueClip = cairo_region_copy (cw->opaque_region);
+        translate_to_client_region (cw, cw->opaqueClip);
+        /* cw->borderSize and cw->clientSize are updated by the caller */
+        if (cw->clientSize)
+        {
+            cairo_region_intersect (cw->opaqueClip, cw->clientSize);
+        }
+        if (cw->borderSize)
+        {
+            cairo_region_intersect (cw->opaqueClip, cw->borderSize);
+        }
+    }
+
+    return cw->opaqueClip;
+}
+
 static void
-clip_opaque_region (CWindow *cw, XserverRegion region)
+clip_opaque_region (CWindow *cw, cairo_region_t *region)
 {
-    ScreenInfo *screen_info;
-    DisplayInfo *display_info;
-    XserverRegion opaque_region;
+    cairo_region_t *opaque_clip;
 
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx", cw->id);
 
-    if (cw->opaque_region == None)
+    opaque_clip = get_opaque_clip (cw);
+    if (opaque_clip == NULL)
     {
         TRACE ("window 0x%lx has no opaque region", cw->id);
         return;
     }
 
+    cairo_region_subtract (region, opaque_clip);
+}
+
+static guint64
+get_region_area (cairo_region_t *region)
+{
+    cairo_rectangle_int_t rect;
+    guint64 area;
+    int nrects;
+    int i;
+
+    area = 0;
+    nrects = cairo_region_num_rectangles (region);
+    /* Rectangles of a region never overlap */
+    for (i = 0; i < nrects; i++)
+    {
+        cairo_region_get_rectangle (region, i, &rect);
+        area += (guint64) rect.width * rect.height;
+    }
+
+    return area;
+}
+
+static void
+paint_shadow (CWindow *cw, Picture paint_buffer)
+{
+    ScreenInfo *screen_info;
+    DisplayInfo *display_info;
+    Picture black;
+    gint x, y, w, h, g;
+
+    g_return_if_fail (cw != NULL);
+    TRACE ("window 0x%lx", cw->id);
+
     screen_info = cw->screen_info;
     display_info = screen_info->display_info;
+    black = screen_info->blackPicture;
+    x = cw->attr.x + cw->shadow_dx;
+    y = cw->attr.y + cw->shadow_dy;
+    w = cw->shadow_width;
+    h = cw->shadow_height;
 
-    opaque_region = XFixesCreateRegion (display_info->dpy, NULL, 0);
-    XFixesCopyRegion (display_info->dpy, opaque_region, cw->opaque_region);
-    translate_to_client_region (cw, opaque_region);
-    /* cw->borderSize and cw->clientSize are already updated in paint_all() */
-    if (cw->clientSize)
+    if (cw->shadow)
+    {
+        XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow,
+                          paint_buffer, 0, 0, 0, 0, x, y, w, h);
+        return;
+    }
+
+    if (!cw->shadow_slices)
+    {
+        return;
+    }
+
+    /* Corners first, then the four edges and the center in between */
+    g = screen_info->gaussianSize;
+    XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->corners,
+                      paint_buffer, 0, 0, 0, 0, x, y, g, g);
+    XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->corners,
+                      paint_buffer, 0, 0, g, 0, x + w - g, y, g, g);
+    XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->corners,
+                      paint_buffer, 0, 0, 0, g, x, y + h - g, g, g);
+    XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->corners,
+                      paint_buffer, 0, 0, g, g, x + w - g, y + h - g, g, g);
+
+    if (w > 2 * g)
+    {
+        XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->top,
+                          paint_buffer, 0, 0, 0, 0, x + g, y, w - 2 * g, g);
+        XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->bottom,
+                          paint_buffer, 0, 0, 0, 0, x + g, y + h - g, w - 2 * g, g);
+    }
+    if (h > 2 * g)
+    {
+        XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->left,
+                          paint_buffer, 0, 0, 0, 0, x, y + g, g, h - 2 * g);
+        XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->right,
+                          paint_buffer, 0, 0, 0, 0, x + w - g, y + g, g, h - 2 * g);
+    }
+    if ((w > 2 * g) && (h > 2 * g))
     {
-        XFixesIntersectRegion (display_info->dpy, opaque_region, opaque_region, cw->clientSize);
+        XRenderComposite (display_info->dpy, PictOpOver, black, cw->shadow_slices->center,
+                          paint_buffer, 0, 0, 0, 0, x + g, y + g, w - 2 * g, h - 2 * g);
     }
-    XFixesIntersectRegion (display_info->dpy, opaque_region, opaque_region, cw->borderSize);
-    XFixesSubtractRegion (display_info->dpy, region, region, opaque_region);
-    XFixesDestroyRegion (display_info->dpy, opaque_region);
 }
 
-static int
-get_region_bounds (Display *dpy, XserverRegion region, XRectangle *bounds)
+static void
+add_opaque_area (CWindow *cw, cairo_region_t *covered)
 {
-    XRectangle *rects;
-    int nrects;
+    ScreenInfo *screen_info;
 
-    rects = XFixesFetchRegionAndBounds (dpy, region, &nrects, bounds);
-    XFree (rects);
+    screen_info = cw->screen_info;
+
+    /* Make sure the window's areas are up-to-date, same as fix_region () */
+    if (cw->picture == None)
+    {
+        cw->picture = get_window_picture (cw);
+    }
+    if (cw->borderSize == NULL)
+    {
+        cw->borderSize = border_size (cw);
+    }
+    if (cw->clientSize == NULL)
+    {
+        cw->clientSize = client_size (cw);
+    }
 
-    return nrects;
+    if (WIN_IS_OPAQUE(cw))
+    {
+        if ((cw->clientSize) && (screen_info->params->frame_opacity < 100))
+        {
+            cairo_region_union (covered, cw->clientSize);
+        }
+        else if (cw->borderSize)
+        {
+            cairo_region_union (covered, cw->borderSize);
+        }
+    }
+    else if ((cw->opaque_region) && (cw->opacity == NET_WM_OPAQUE) && !WIN_IS_SHADED(cw))
+    {
+        cairo_region_union (covered, get_opaque_clip (cw));
+    }
 }
 
-static gboolean
-is_region_empty (Display *dpy, XserverRegion region)
+static void
+update_visible_regions (ScreenInfo *screen_info)
 {
-    XRectangle bounds;
-    int nrects;
+    cairo_region_t *covered;
+    guint i;
+
+    if (!screen_info->clipChanged)
+    {
+        return;
+    }
+    TRACE ("entering");
+
+    if (screen_info->screenRegion == NULL)
+    {
+        screen_info->screenRegion = get_screen_region (screen_info);
+    }
+
+    g_ptr_array_set_size (screen_info->visible_windows, 0);
+    screen_info->wins_culled = 0;
+    covered = cairo_region_create ();
+
+    /*
+     * Walk the stack from top to bottom, each window gets what is left
+     * once the opaque windows above it are taken away.
+     */
+    for (i = 0; i < screen_info->cwindows->len; i++)
+    {
+        CWindow *cw = (CWindow *) g_ptr_array_index (screen_info->cwindows, i);
+
+        if (cw->visible_region)
+        {
+            cairo_region_destroy (cw->visible_region);
+            cw->visible_region = NULL;
+        }
+
+        if (!WIN_IS_VISIBLE(cw))
+        {
+            continue;
+        }
+
+        if (cw->extents == NULL)
+        {
+            cw->extents = win_extents (cw);
+        }
+        if (cw->extents)
+        {
+            cw->visible_region = cairo_region_copy (cw->extents);
+            cairo_region_intersect (cw->visible_region, screen_info->screenRegion);
+            cairo_region_subtract (cw->visible_region, covered);
+        }
+
+        if ((cw->visible_region) && !cairo_region_is_empty (cw->visible_region))
+        {
+            g_ptr_array_add (screen_info->visible_windows, cw);
+        }
+        else
+        {
+            TRACE ("window 0x%lx is fully occluded", cw->id);
+            screen_info->wins_culled++;
+        }
+
+        add_opaque_area (cw, covered);
+    }
+
+    cairo_region_destroy (covered);
+    screen_info->clipChanged = FALSE;
+}
+
+static cairo_region_t *
+get_zoomed_region (ScreenInfo *screen_info, cairo_region_t *region)
+{
+    cairo_rectangle_int_t rect;
+    cairo_rectangle_int_t root_rect = { 0, 0, screen_info->width, screen_info->height };
+    cairo_region_t *zoomed;
+    double zoom, xp, yp;
+    int x1, y1, x2, y2;
+    int i, n;
+
+    zoom = XFixedToDouble (screen_info->transform.matrix[0][0]);
+    xp = XFixedToDouble (screen_info->transform.matrix[0][2]);
+    yp = XFixedToDouble (screen_info->transform.matrix[1][2]);
+
+    /* Map the damage to the zoomed view, with a pixel more for filtering */
+    zoomed = cairo_region_create ();
+    n = cairo_region_num_rectangles (region);
+    for (i = 0; i < n; i++)
+    {
+        cairo_region_get_rectangle (region, i, &rect);
+        x1 = (int) floor ((rect.x - xp) / zoom) - 1;
+        y1 = (int) floor ((rect.y - yp) / zoom) - 1;
+        x2 = (int) ceil ((rect.x + rect.width - xp) / zoom) + 1;
+        y2 = (int) ceil ((rect.y + rect.height - yp) / zoom) + 1;
+        rect.x = x1;
+        rect.y = y1;
+        rect.width = x2 - x1;
+        rect.height = y2 - y1;
+        cairo_region_union_rectangle (zoomed, &rect);
+    }
+    cairo_region_intersect_rectangle (zoomed, &root_rect);
+
+    return zoomed;
+}
+
+static void
+shift_zoomed_view (ScreenInfo *screen_info, Drawable drawable, int dx, int dy,
+                   cairo_region_t *output_region, XRectangle *cursor)
+{
+    Display *dpy;
+    XGCValues values;
+    GC gc;
+    cairo_rectangle_int_t rect = { 0, 0, screen_info->width, screen_info->height };
+    cairo_region_t *exposed;
+
+    if ((dx == 0) && (dy == 0))
+    {
+        return;
+    }
+    TRACE ("shifting zoomed view by %i,%i", dx, dy);
+
+    dpy = myScreenGetXDisplay (screen_info);
+    exposed = cairo_region_create_rectangle (&rect);
+
+    if ((ABS (dx) < screen_info->width) && (ABS (dy) < screen_info->height))
+    {
+        rect.x = MAX (dx, 0);
+        rect.y = MAX (dy, 0);
+        rect.width = screen_info->width - ABS (dx);
+        rect.height = screen_info->height - ABS (dy);
+
+        values.graphics_exposures = FALSE;
+        gc = XCreateGC (dpy, drawable, GCGraphicsExposures, &values);
+        XCopyArea (dpy, drawable, drawable, gc,
+                   MAX (-dx, 0), MAX (-dy, 0), rect.width, rect.height,
+                   rect.x, rect.y);
+        XFreeGC (dpy, gc);
+
+        cairo_region_subtract_rectangle (exposed, &rect);
+    }
+
+    /* The cursor drawn last time moved along with the view */
+    cursor->x += dx;
+    cursor->y += dy;
+
+    /* Only the strips uncovered by the shift need to be scaled again */
+    cairo_region_union (output_region, exposed);
+    cairo_region_destroy (exposed);
+}
+
+static void
+shift_zoomed_output (ScreenInfo *screen_info, cairo_region_t *output_region)
+{
+    int dx, dy;
+
+    dx = screen_info->zoom_shift_x;
+    dy = screen_info->zoom_shift_y;
+    screen_info->zoom_shift_x = 0;
+    screen_info->zoom_shift_y = 0;
+    shift_zoomed_view (screen_info, screen_info->output, dx, dy,
+                       output_region, &screen_info->cursorOutput);
+}
+
+#ifdef HAVE_EPOXY
+static void
+paint_glx_scene (ScreenInfo *screen_info, cairo_region_t *region, gushort buffer)
+{
+    cairo_rectangle_int_t root_rect = { 0, 0, screen_info->width, screen_info->height };
+    cairo_region_t *damage;
+    cairo_region_t *redraw;
+    XRectangle *rects;
+    gint nrects;
+    CWindow *cw;
+    guint i;
+
+    TRACE ("buffer %d", buffer);
+
+    /* The background is all that is left to XRender, drawn when it changes */
+    if (!screen_info->glx_background_valid || (screen_info->rootTile == None))
+    {
+        set_picture_clip_region (myScreenGetXDisplay (screen_info),
+                                 screen_info->rootBuffer[buffer], NULL);
+        paint_root (screen_info, screen_info->rootBuffer[buffer]);
+        screen_info->glx_background_valid = TRUE;
+    }
+
+    /* Also waits for the rendering of the clients into their pixmaps */
+    fence_sync (screen_info, buffer);
+
+    if (screen_info->has_ext_arb_sync)
+    {
+#if defined (glDeleteSync)
+        glDeleteSync (screen_info->gl_sync);
+#endif
+        screen_info->gl_sync = 0;
+    }
+
+    update_visible_regions (screen_info);
+    screen_info->stats.windows_skipped += screen_info->wins_culled;
+
+    /* The zoomed view is drawn from the whole scene */
+    if (screen_info->zoomed)
+    {
+        damage = cairo_region_create_rectangle (&root_rect);
+    }
+    else
+    {
+        damage = cairo_region_copy (region);
+    }
+    redraw = get_glx_redraw_region (screen_info, damage);
+    if (redraw == NULL)
+    {
+        redraw = cairo_region_create_rectangle (&root_rect);
+    }
+    glDrawBuffer (GL_BACK);
+    glViewport (0, 0, screen_info->width, screen_info->height);
+    glMatrixMode (GL_TEXTURE);
+    glPushMatrix ();
+    glLoadIdentity ();
+
+    bind_glx_texture (screen_info, buffer);
+    set_glx_texture_filter (screen_info);
+    glDisable (GL_BLEND);
+    glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    draw_glx_scene_rects (screen_info, redraw, 0, 0, screen_info->width, screen_info->height);
+    unbind_glx_texture (screen_info, buffer);
+
+    /* Bottom to top, each window within the part left visible by opaque windows above */
+    for (i = screen_info->visible_windows->len; i > 0; i--)
+    {
+        cw = (CWindow *) g_ptr_array_index (screen_info->visible_windows, i - 1);
+        if (!WIN_IS_VISIBLE(cw) || !WIN_IS_DAMAGED(cw) || !WIN_IS_REDIRECTED(cw))
+        {
+            screen_info->stats.windows_skipped++;
+            continue;
+        }
+        if (cw->picture == None)
+        {
+            cw->picture = get_window_picture (cw);
+        }
+        if (cw->borderSize == NULL)
+        {
+            cw->borderSize = border_size (cw);
+        }
+        if (cw->clientSize == NULL)
+        {
+            cw->clientSize = client_size (cw);
+        }
+        paint_glx_window (cw, redraw);
+    }
+
+    glDisable (GL_BLEND);
+    glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glDisable (screen_info->texture_type);
+    glPopMatrix ();
+
+    rects = region_to_xrectangles (redraw, &nrects);
+    present_glx_rects (screen_info, rects, nrects);
+    update_glx_vblank_timing (screen_info);
+    g_free (rects);
 
-    nrects = get_region_bounds (dpy, region, &bounds);
+    push_glx_damage (screen_info, damage);
+    cairo_region_destroy (damage);
+    cairo_region_destroy (redraw);
+
+    if (screen_info->has_ext_arb_sync)
+    {
+#if defined (glFenceSync)
+        screen_info->gl_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+    }
 
-    return (nrects == 0 || bounds.width == 0 || bounds.height == 0);
+    check_gl_error();
 }
+#endif /* HAVE_EPOXY */
 
 static void
-paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
+paint_all (ScreenInfo *screen_info, cairo_region_t *region, gushort buffer)
 {
     DisplayInfo *display_info;
-    XserverRegion paint_region;
-    XRectangle region_bounds;
+    cairo_region_t *paint_region;
+    cairo_rectangle_int_t region_bounds;
     Picture paint_buffer;
     Display *dpy;
-    GList *list;
+    guint i;
     gint screen_width;
     gint screen_height;
     CWindow *cw;
+    unsigned long first_request;
 
     TRACE ("buffer %d", buffer);
     g_return_if_fail (screen_info);
@@ -2403,15 +4465,21 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
     screen_height = screen_info->height;
 
     myDisplayErrorTrapPush (display_info);
+    first_request = NextRequest (dpy);
+    /* Clips set outside of painting are unknown */
+    reset_paint_clip (screen_info);
 
     /* Create root buffer if not done yet */
     if (screen_info->rootPixmap[buffer] == None)
     {
         screen_info->rootPixmap[buffer] = create_root_pixmap (screen_info);
+        /* No zoomed view in the new buffer yet */
+        screen_info->bufferTransform[buffer].matrix[2][2] = 0;
 #ifdef HAVE_EPOXY
         if (screen_info->use_glx)
         {
             fence_create (screen_info, buffer);
+            screen_info->glx_background_valid = FALSE;
         }
 #endif /* HAVE_EPOXY */
     }
@@ -2422,6 +4490,16 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
             create_root_buffer (screen_info, screen_info->rootPixmap[buffer]);
     }
 
+#ifdef HAVE_EPOXY
+    if (screen_info->use_glx_scene)
+    {
+        paint_glx_scene (screen_info, region, buffer);
+        screen_info->stats.requests += NextRequest (dpy) - first_request;
+        myDisplayErrorTrapPopIgnored (display_info);
+        return;
+    }
+#endif /* HAVE_EPOXY */
+
     if (screen_info->zoomed && !screen_info->use_glx)
     {
         if (screen_info->zoomBuffer == None)
@@ -2439,16 +4517,19 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
         paint_buffer = screen_info->rootBuffer[buffer];
     }
     /* Copy the original given region */
-    paint_region = XFixesCreateRegion (dpy, NULL, 0);
-    XFixesCopyRegion (dpy, paint_region, region);
+    paint_region = cairo_region_copy (region);
+
+    /* Fully occluded windows are left out of the paint list altogether */
+    update_visible_regions (screen_info);
+    screen_info->stats.windows_skipped += screen_info->wins_culled;
 
     /*
      * Painting from top to bottom, reducing the clipping area at each iteration.
      * Only the opaque windows are painted 1st.
      */
-    for (list = screen_info->cwindows; list; list = g_list_next (list))
+    for (i = 0; i < screen_info->visible_windows->len; i++)
     {
-        cw = (CWindow *) list->data;
+        cw = (CWindow *) g_ptr_array_index (screen_info->visible_windows, i);
         TRACE ("painting forward 0x%lx", cw->id);
         if (!WIN_IS_VISIBLE(cw) || !WIN_IS_DAMAGED(cw))
         {
@@ -2472,7 +4553,7 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
             continue;
         }
 
-        if (cw->extents == None)
+        if (cw->extents == NULL)
         {
             cw->extents = win_extents (cw);
         }
@@ -2480,11 +4561,11 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
         {
             cw->picture = get_window_picture (cw);
         }
-        if (cw->borderSize == None)
+        if (cw->borderSize == NULL)
         {
             cw->borderSize = border_size (cw);
         }
-        if (cw->clientSize == None)
+        if (cw->clientSize == NULL)
         {
             cw->clientSize = client_size (cw);
         }
@@ -2493,10 +4574,15 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
             paint_win (cw, paint_region, paint_buffer, TRUE);
         }
 
-        if (cw->borderClip == None)
+        /* Kept between frames, refilled in place */
+        if (cw->borderClip)
+        {
+            cairo_region_subtract (cw->borderClip, cw->borderClip);
+            cairo_region_union (cw->borderClip, paint_region);
+        }
+        else
         {
-            cw->borderClip = XFixesCreateRegion (dpy, NULL, 0);
-            XFixesCopyRegion (dpy, cw->borderClip, paint_region);
+            cw->borderClip = cairo_region_copy (paint_region);
         }
 
         if ((cw->opacity == NET_WM_OPAQUE) && !WIN_IS_SHADED(cw))
@@ -2508,11 +4594,11 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
     }
 
     /*
-     * region has changed because of the XFixesSubtractRegion (),
+     * region has changed because of the subtraction of opaque areas,
      * reapply clipping for the last iteration.
      */
-    XFixesSetPictureClipRegion (dpy, paint_buffer, 0, 0, paint_region);
-    if (!is_region_empty (dpy, paint_region))
+    set_paint_clip_region (screen_info, paint_buffer, paint_region);
+    if (!cairo_region_is_empty (paint_region))
     {
         paint_root (screen_info, paint_buffer);
     }
@@ -2520,31 +4606,32 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
     /*
      * Painting from bottom to top, translucent windows and shadows are painted now...
      */
-    for (list = g_list_last(screen_info->cwindows); list; list = g_list_previous (list))
+    for (i = screen_info->visible_windows->len; i > 0; i--)
     {
-        XserverRegion shadowClip;
+        cairo_region_t *shadowClip;
 
-        cw = (CWindow *) list->data;
-        shadowClip = None;
+        cw = (CWindow *) g_ptr_array_index (screen_info->visible_windows, i - 1);
+        shadowClip = NULL;
         TRACE ("painting backward 0x%lx", cw->id);
 
         if (cw->skipped)
         {
             TRACE ("skipped 0x%lx", cw->id);
+            screen_info->stats.windows_skipped++;
             continue;
         }
+        screen_info->stats.windows_painted++;
 
-        if (cw->shadow)
+        if (WIN_HAS_SHADOW(cw))
         {
-            shadowClip = XFixesCreateRegion (dpy, NULL, 0);
-            XFixesSubtractRegion (dpy, shadowClip, cw->borderClip, cw->borderSize);
+            shadowClip = cairo_region_copy (cw->borderClip);
+            if (cw->borderSize)
+            {
+                cairo_region_subtract (shadowClip, cw->borderSize);
+            }
 
-            XFixesSetPictureClipRegion (dpy, paint_buffer, 0, 0, shadowClip);
-            XRenderComposite (dpy, PictOpOver, screen_info->blackPicture, cw->shadow,
-                              paint_buffer, 0, 0, 0, 0,
-                              cw->attr.x + cw->shadow_dx,
-                              cw->attr.y + cw->shadow_dy,
-                              cw->shadow_width, cw->shadow_height);
+            set_paint_clip_region (screen_info, paint_buffer, shadowClip);
+            paint_shadow (cw, paint_buffer);
         }
 
         if (cw->picture)
@@ -2557,20 +4644,17 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
                                                0.0, /* green */
                                                0.0  /* blue  */);
             }
-            XFixesIntersectRegion (dpy, cw->borderClip, cw->borderClip, cw->borderSize);
-            XFixesSetPictureClipRegion (dpy, paint_buffer, 0, 0, cw->borderClip);
+            if (cw->borderSize)
+            {
+                cairo_region_intersect (cw->borderClip, cw->borderSize);
+            }
+            set_paint_clip_region (screen_info, paint_buffer, cw->borderClip);
             paint_win (cw, paint_region, paint_buffer, FALSE);
         }
 
         if (shadowClip)
         {
-            XFixesDestroyRegion (dpy, shadowClip);
-        }
-
-        if (cw->borderClip)
-        {
-            XFixesDestroyRegion (dpy, cw->borderClip);
-            cw->borderClip = None;
+            cairo_region_destroy (shadowClip);
         }
     }
 
@@ -2589,54 +4673,185 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
     {
         if (screen_info->zoomed)
         {
-            if (screen_info->cursor_is_zoomed)
-            {
-                paint_cursor (screen_info, region, paint_buffer);
-            }
-            /* Fixme: copy back whole screen if zoomed
-               It would be better to scale the clipping region if possible. */
-            XFixesSetPictureClipRegion (dpy, screen_info->rootBuffer[buffer], 0, 0, None);
-            XFixesSetPictureClipRegion (dpy, paint_buffer, 0, 0, None);
+            /* The zoom buffer is sampled as a whole, the output is clipped later */
+            set_paint_clip_region (screen_info, screen_info->rootBuffer[buffer], NULL);
+            set_paint_clip_region (screen_info, paint_buffer, NULL);
         }
         else
         {
             /* Set clipping back to the given region */
-            XFixesSetPictureClipRegion (dpy, screen_info->rootBuffer[buffer], 0, 0, region);
+            set_paint_clip_region (screen_info, screen_info->rootBuffer[buffer], region);
         }
     }
 
 #ifdef HAVE_PRESENT_EXTENSION
     if (screen_info->use_present)
     {
+        XserverRegion update_region;
+
         if (screen_info->zoomed)
         {
-            XRenderComposite (dpy, PictOpSrc,
-                              screen_info->zoomBuffer,
-                              None, screen_info->rootBuffer[buffer],
-                              0, 0, 0, 0, 0, 0, screen_width, screen_height);
+            cairo_region_t *output_region;
+            cairo_rectangle_int_t root_rect = { 0, 0, screen_width, screen_height };
+            cairo_rectangle_int_t cursor_rect;
+            XTransform *buffer_transform;
+            XRectangle *buffer_cursor;
+            double zoom;
+            int dx, dy;
+
+            /*
+             * The buffer still shows the view it was presented with. Like
+             * the plain XRender output, it is shifted when the view panned
+             * by whole pixels, then only the strips uncovered, the damage
+             * it missed and the old and new cursor areas are scaled again.
+             */
+            buffer_transform = &screen_info->bufferTransform[buffer];
+            buffer_cursor = &screen_info->bufferCursor[buffer];
+            if ((buffer_transform->matrix[2][2] != 0) &&
+                (buffer_transform->matrix[0][0] == screen_info->transform.matrix[0][0]) &&
+                (buffer_transform->matrix[1][1] == screen_info->transform.matrix[1][1]))
+            {
+                zoom = XFixedToDouble (screen_info->transform.matrix[0][0]);
+                dx = (int) floor ((XFixedToDouble (buffer_transform->matrix[0][2])
+                                   - XFixedToDouble (screen_info->transform.matrix[0][2])) / zoom + 0.5);
+                dy = (int) floor ((XFixedToDouble (buffer_transform->matrix[1][2])
+                                   - XFixedToDouble (screen_info->transform.matrix[1][2])) / zoom + 0.5);
+                output_region = get_zoomed_region (screen_info, region);
+                shift_zoomed_view (screen_info, screen_info->rootPixmap[buffer], dx, dy,
+                                   output_region, buffer_cursor);
+                cursor_rect.x = buffer_cursor->x;
+                cursor_rect.y = buffer_cursor->y;
+                cursor_rect.width = buffer_cursor->width;
+                cursor_rect.height = buffer_cursor->height;
+                cairo_region_union_rectangle (output_region, &cursor_rect);
+            }
+            else
+            {
+                output_region = cairo_region_create_rectangle (&root_rect);
+            }
+            *buffer_transform = screen_info->transform;
+
+            buffer_cursor->width = 0;
+            buffer_cursor->height = 0;
+            if (screen_info->cursor_is_zoomed)
+            {
+                get_cursor_output_rect (screen_info, &screen_info->cursorOutput);
+                cursor_rect.x = screen_info->cursorOutput.x;
+                cursor_rect.y = screen_info->cursorOutput.y;
+                cursor_rect.width = screen_info->cursorOutput.width;
+                cursor_rect.height = screen_info->cursorOutput.height;
+                cairo_region_union_rectangle (output_region, &cursor_rect);
+                *buffer_cursor = screen_info->cursorOutput;
+            }
+            screen_info->cursor_damaged = FALSE;
+            cairo_region_intersect_rectangle (output_region, &root_rect);
+
+            if (!cairo_region_is_empty (output_region))
+            {
+                cairo_region_get_extents (output_region, &region_bounds);
+                set_picture_clip_region (dpy, screen_info->rootBuffer[buffer], output_region);
+                XRenderComposite (dpy, PictOpSrc,
+                                  screen_info->zoomBuffer,
+                                  None, screen_info->rootBuffer[buffer],
+                                  region_bounds.x, region_bounds.y,
+                                  0, 0,
+                                  region_bounds.x, region_bounds.y,
+                                  region_bounds.width, region_bounds.height);
+            }
+            if (screen_info->cursor_is_zoomed)
+            {
+                /* Over pixels just scaled again, never blended twice */
+                paint_cursor_plane (screen_info, screen_info->rootBuffer[buffer],
+                                    &screen_info->cursorOutput);
+            }
+            set_picture_clip_region (dpy, screen_info->rootBuffer[buffer], NULL);
+            /* Damage is not in screen coordinates when zoomed */
+            update_region = region_to_server_region (dpy, output_region);
+            cairo_region_destroy (output_region);
+        }
+        else
+        {
+            /* The view changes when zooming in again */
+            screen_info->bufferTransform[buffer].matrix[2][2] = 0;
+            /* The only region uploaded to the server for this frame */
+            update_region = region_to_server_region (dpy, region);
         }
-        present_flip (screen_info, region, buffer);
+        present_flip (screen_info, update_region, buffer);
+        XFixesDestroyRegion (dpy, update_region);
     }
     else
 #endif /* HAVE_PRESENT_EXTENSION */
 #ifdef HAVE_EPOXY
     if (screen_info->use_glx)
     {
-        redraw_glx_texture (screen_info, buffer);
+        redraw_glx_texture (screen_info, region, buffer);
     }
     else
 #endif /* HAVE_EPOXY */
     {
         if (screen_info->zoomed)
         {
-            XRenderComposite (dpy, PictOpSrc,
-                              screen_info->zoomBuffer,
-                              None,  screen_info->rootPicture,
-                              0, 0, 0, 0, 0, 0, screen_width, screen_height);
+            cairo_region_t *output_region;
+            cairo_rectangle_int_t cursor_rect;
+            gboolean paint_cursor_output;
+
+            /* Shift the previous frame and scale only what has changed */
+            output_region = get_zoomed_region (screen_info, region);
+            shift_zoomed_output (screen_info, output_region);
+
+            /*
+             * The zoom buffer has no cursor, restoring the old cursor area
+             * and drawing the cursor again is all a cursor motion costs.
+             */
+            paint_cursor_output = FALSE;
+            if (screen_info->cursor_is_zoomed)
+            {
+                if (screen_info->cursor_damaged)
+                {
+                    cursor_rect.x = screen_info->cursorOutput.x;
+                    cursor_rect.y = screen_info->cursorOutput.y;
+                    cursor_rect.width = screen_info->cursorOutput.width;
+                    cursor_rect.height = screen_info->cursorOutput.height;
+                    cairo_region_union_rectangle (output_region, &cursor_rect);
+                }
+                get_cursor_output_rect (screen_info, &screen_info->cursorOutput);
+                cursor_rect.x = screen_info->cursorOutput.x;
+                cursor_rect.y = screen_info->cursorOutput.y;
+                cursor_rect.width = screen_info->cursorOutput.width;
+                cursor_rect.height = screen_info->cursorOutput.height;
+                if (screen_info->cursor_damaged ||
+                    cairo_region_contains_rectangle (output_region, &cursor_rect) != CAIRO_REGION_OVERLAP_OUT)
+                {
+                    /* Never blend the cursor twice over the same pixels */
+                    cairo_region_union_rectangle (output_region, &cursor_rect);
+                    paint_cursor_output = TRUE;
+                }
+            }
+            screen_info->cursor_damaged = FALSE;
+
+            if (!cairo_region_is_empty (output_region))
+            {
+                cairo_region_get_extents (output_region, &region_bounds);
+                set_picture_clip_region (dpy, screen_info->rootPicture, output_region);
+                XRenderComposite (dpy, PictOpSrc,
+                                  screen_info->zoomBuffer,
+                                  None,  screen_info->rootPicture,
+                                  region_bounds.x, region_bounds.y,
+                                  0, 0,
+                                  region_bounds.x, region_bounds.y,
+                                  region_bounds.width, region_bounds.height);
+                set_picture_clip_region (dpy, screen_info->rootPicture, NULL);
+            }
+            if (paint_cursor_output)
+            {
+                paint_cursor_plane (screen_info, screen_info->rootPicture,
+                                    &screen_info->cursorOutput);
+            }
+            cairo_region_destroy (output_region);
         }
         else
         {
-            get_region_bounds (dpy, region, &region_bounds);
+            cairo_region_get_extents (region, &region_bounds);
             XRenderComposite (dpy, PictOpSrc, paint_buffer,
                               None, screen_info->rootPicture,
                               region_bounds.x, region_bounds.y,
@@ -2647,7 +4862,9 @@ paint_all (ScreenInfo *screen_info, XserverRegion region, gushort buffer)
         XFlush (dpy);
     }
 
-    XFixesDestroyRegion (dpy, paint_region);
+    cairo_region_destroy (paint_region);
+    reset_paint_clip (screen_info);
+    screen_info->stats.requests += NextRequest (dpy) - first_request;
 
     myDisplayErrorTrapPopIgnored (display_info);
 }
@@ -2662,11 +4879,331 @@ remove_timeouts (ScreenInfo *screen_info)
     }
 }
 
+static void
+update_vblank_timing (ScreenInfo *screen_info, gint64 ust, guint64 msc)
+{
+    gint64 now;
+    gint64 interval;
+
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("ust %" G_GINT64_FORMAT ", msc %" G_GUINT64_FORMAT, ust, msc);
+
+    /* Present timestamps use the monotonic clock, check it anyway */
+    now = g_get_monotonic_time ();
+    if ((ust <= 0) || (ABS (now - ust) > MAX_VBLANK_AGE))
+    {
+        ust = now;
+    }
+
+    if ((screen_info->vblank_msc > 0) && (msc > screen_info->vblank_msc) &&
+        (now - screen_info->vblank_time < MAX_VBLANK_AGE))
+    {
+        interval = (ust - screen_info->vblank_time) / (gint64) (msc - screen_info->vblank_msc);
+        if (interval > 0)
+        {
+            /* Smooth out the jitter of the reported timestamps */
+            screen_info->refresh_interval = (3 * screen_info->refresh_interval + interval) / 4;
+        }
+    }
+
+    screen_info->vblank_time = ust;
+    screen_info->vblank_msc = msc;
+}
+
+static gint64
+get_refresh_interval (ScreenInfo *screen_info)
+{
+    DisplayInfo *display_info;
+    gint64 interval;
+#ifdef HAVE_EPOXY
+    int32_t numerator, denominator;
+#endif /* HAVE_EPOXY */
+#ifdef HAVE_RANDR
+    XRRScreenResources *resources;
+    XRRCrtcInfo *crtc_info;
+    XRRModeInfo *mode_info;
+    gint64 mode_interval;
+    gint64 vtotal;
+    int i, j;
+#endif /* HAVE_RANDR */
+
+    g_return_val_if_fail (screen_info != NULL, DEFAULT_REFRESH_INTERVAL);
+    TRACE ("entering");
+
+    display_info = screen_info->display_info;
+    interval = 0;
+
+#ifdef HAVE_EPOXY
+    if (screen_info->use_glx && screen_info->has_oml_sync_control &&
+        glXGetMscRateOML (display_info->dpy, screen_info->glx_window,
+                          &numerator, &denominator) &&
+        (numerator > 0) && (denominator > 0))
+    {
+        return (gint64) denominator * G_USEC_PER_SEC / numerator;
+    }
+#endif /* HAVE_EPOXY */
+
+#ifdef HAVE_RANDR
+    if (display_info->have_xrandr)
+    {
+        /* Use the fastest of the active outputs */
+        myDisplayErrorTrapPush (display_info);
+        resources = XRRGetScreenResourcesCurrent (display_info->dpy, screen_info->xroot);
+        for (i = 0; resources && (i < resources->ncrtc); i++)
+        {
+            crtc_info = XRRGetCrtcInfo (display_info->dpy, resources, resources->crtcs[i]);
+            if (crtc_info == NULL)
+            {
+                continue;
+            }
+            for (j = 0; (crtc_info->mode != None) && (j < resources->nmode); j++)
+            {
+                mode_info = &resources->modes[j];
+                if ((mode_info->id != crtc_info->mode) ||
+                    (mode_info->dotClock == 0) || (mode_info->hTotal == 0))
+                {
+                    continue;
+                }
+                vtotal = mode_info->vTotal;
+                if (mode_info->modeFlags & RR_DoubleScan)
+                {
+                    vtotal *= 2;
+                }
+                if (mode_info->modeFlags & RR_Interlace)
+                {
+                    vtotal /= 2;
+                }
+                mode_interval = (gint64) mode_info->hTotal * vtotal * G_USEC_PER_SEC
+                              / (gint64) mode_info->dotClock;
+                if ((mode_interval > 0) && ((interval == 0) || (mode_interval < interval)))
+                {
+                    interval = mode_interval;
+                }
+                break;
+            }
+            XRRFreeCrtcInfo (crtc_info);
+        }
+        if (resources)
+        {
+            XRRFreeScreenResources (resources);
+        }
+        myDisplayErrorTrapPopIgnored (display_info);
+    }
+#endif /* HAVE_RANDR */
+
+    return (interval > 0) ? interval : DEFAULT_REFRESH_INTERVAL;
+}
+
+static guint
+get_repaint_delay (ScreenInfo *screen_info)
+{
+    gint64 now;
+    gint64 lead;
+    gint64 next_vblank;
+    gint64 interval;
+
+    g_return_val_if_fail (screen_info != NULL, TIMEOUT_REPAINT_MS);
+
+    now = g_get_monotonic_time ();
+    interval = screen_info->refresh_interval;
+    if ((interval <= 0) || (screen_info->vblank_time <= 0) ||
+        (now - screen_info->vblank_time > MAX_VBLANK_AGE))
+    {
+        return TIMEOUT_REPAINT_MS;
+    }
+
+    /*
+     * Start painting just in time for the next vblank, so that all the
+     * damage received until then is merged in the same frame.
+     */
+    lead = (gint64) screen_info->params->repaint_lead_time * 1000;
+    next_vblank = screen_info->vblank_time +
+                  ((now - screen_info->vblank_time) / interval + 1) * interval;
+    if (next_vblank - lead <= now)
+    {
+        return 0;
+    }
+
+    return (guint) ((next_vblank - lead - now) / 1000);
+}
+
+static gint64
+get_cpu_time (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts) != 0)
+    {
+        return 0;
+    }
+
+    return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static void
+stats_add_frame (ScreenInfo *screen_info, gint64 frame_time)
+{
+    frame_stats *stats;
+    gint bucket;
+    gint64 ms;
+
+    stats = &screen_info->stats;
+    stats->frames++;
+    stats->frame_time += frame_time;
+    stats->frame_time_max = MAX (stats->frame_time_max, (guint64) frame_time);
+
+    bucket = 0;
+    for (ms = frame_time / 1000; ms > 0 && bucket < FRAME_STATS_BUCKETS - 1; ms >>= 1)
+    {
+        bucket++;
+    }
+    stats->frame_time_histogram[bucket]++;
+}
+
+static void
+stats_wait_begin (gint64 *wait_start)
+{
+    if (*wait_start == 0)
+    {
+        *wait_start = g_get_monotonic_time ();
+    }
+}
+
+static void
+stats_wait_end (gint64 *wait_start, guint64 *wait_total)
+{
+    if (*wait_start != 0)
+    {
+        *wait_total += g_get_monotonic_time () - *wait_start;
+        *wait_start = 0;
+    }
+}
+
+#ifdef HAVE_PRESENT_EXTENSION
+static void
+set_n_buffers (ScreenInfo *screen_info, gushort n_buffers)
+{
+    DisplayInfo *display_info;
+    gushort buffer;
+
+    display_info = screen_info->display_info;
+    DBG ("switching from %i to %i buffers", screen_info->use_n_buffers, n_buffers);
+
+    if (n_buffers < screen_info->use_n_buffers)
+    {
+        /* Keep the buffer due for painting, the others may still be on screen */
+        buffer = screen_info->current_buffer;
+        if (buffer != 0)
+        {
+            Pixmap pixmap = screen_info->rootPixmap[0];
+            Picture picture = screen_info->rootBuffer[0];
+            cairo_region_t *damage = screen_info->bufferDamage[0];
+
+            screen_info->rootPixmap[0] = screen_info->rootPixmap[buffer];
+            screen_info->rootBuffer[0] = screen_info->rootBuffer[buffer];
+            screen_info->bufferDamage[0] = screen_info->bufferDamage[buffer];
+            screen_info->rootPixmap[buffer] = pixmap;
+            screen_info->rootBuffer[buffer] = picture;
+            screen_info->bufferDamage[buffer] = damage;
+            screen_info->bufferTransform[0] = screen_info->bufferTransform[buffer];
+            screen_info->bufferCursor[0] = screen_info->bufferCursor[buffer];
+        }
+        screen_info->current_buffer = 0;
+
+        for (buffer = n_buffers; buffer < screen_info->use_n_buffers; buffer++)
+        {
+            if (screen_info->rootPixmap[buffer])
+            {
+                XFreePixmap (display_info->dpy, screen_info->rootPixmap[buffer]);
+                screen_info->rootPixmap[buffer] = None;
+            }
+            if (screen_info->rootBuffer[buffer])
+            {
+                XRenderFreePicture (display_info->dpy, screen_info->rootBuffer[buffer]);
+                screen_info->rootBuffer[buffer] = None;
+            }
+            if (screen_info->bufferDamage[buffer])
+            {
+                cairo_region_destroy (screen_info->bufferDamage[buffer]);
+                screen_info->bufferDamage[buffer] = NULL;
+            }
+        }
+    }
+    else
+    {
+        for (buffer = screen_info->use_n_buffers; buffer < n_buffers; buffer++)
+        {
+            /* A new buffer has to be painted entirely */
+            screen_info->bufferDamage[buffer] = get_screen_region (screen_info);
+        }
+    }
+
+    screen_info->use_n_buffers = n_buffers;
+}
+
+static void
+adapt_n_buffers (ScreenInfo *screen_info)
+{
+    gint64 interval;
+    gint64 latency;
+    gint64 paint_time;
+    guint64 area;
+    guint64 screen_area;
+    gushort n_buffers;
+
+    if (screen_info->adapt_frames < BUFFER_ADAPT_FRAMES)
+    {
+        return;
+    }
+
+    interval = screen_info->refresh_interval;
+    latency = screen_info->adapt_latency / screen_info->adapt_frames;
+    paint_time = screen_info->adapt_paint_time / screen_info->adapt_frames;
+    area = screen_info->adapt_area / screen_info->adapt_frames;
+    screen_area = (guint64) screen_info->width * screen_info->height;
+    n_buffers = screen_info->use_n_buffers;
+
+    if ((latency > 2 * interval) || (paint_time > interval / 2))
+    {
+        /* Frames are late, queue more of them to keep the output smooth */
+        n_buffers = MIN (n_buffers + 1, N_BUFFERS);
+    }
+    else if ((latency < interval + interval / 4) && (paint_time < interval / 4) &&
+             (area < screen_area / 4))
+    {
+        /* Buffers in use cannot be released, wait for all presents to complete */
+        if (screen_info->present_pending > 0)
+        {
+            return;
+        }
+        /* Frames are on time, use fewer buffers for the lowest latency */
+        n_buffers = MAX (n_buffers - 1, 1);
+    }
+
+    TRACE ("latency %" G_GINT64_FORMAT "μs, paint time %" G_GINT64_FORMAT "μs, area %" G_GUINT64_FORMAT,
+           latency, paint_time, area);
+    screen_info->adapt_frames = 0;
+    screen_info->adapt_latency = 0;
+    screen_info->adapt_paint_time = 0;
+    screen_info->adapt_area = 0;
+
+    if (n_buffers != screen_info->use_n_buffers)
+    {
+        set_n_buffers (screen_info, n_buffers);
+    }
+}
+#endif /* HAVE_PRESENT_EXTENSION */
+
+static void fetch_window_damage (ScreenInfo *screen_info);
+
 static gboolean
 repair_screen (ScreenInfo *screen_info)
 {
-    DisplayInfo *display_info;
-    XserverRegion damage;
+    cairo_region_t *damage;
+    gushort buffer;
+    gushort i;
+    gint64 start;
+    gint64 cpu_start;
 
     g_return_val_if_fail (screen_info, FALSE);
     TRACE ("entering");
@@ -2681,16 +5218,21 @@ repair_screen (ScreenInfo *screen_info)
         return FALSE;
     }
 
+    fetch_window_damage (screen_info);
+
 #ifdef HAVE_PRESENT_EXTENSION
     /*
      * We do not paint the screen because we are waiting for
      * a pending present notification, do not cancel the callback yet...
      */
-     if (screen_info->use_present && screen_info->present_pending)
+     if (is_present_blocked (screen_info))
      {
          DBG ("Waiting for Present");
-         return (screen_info->allDamage != None);
+         stats_wait_begin (&screen_info->stats.present_wait_start);
+         return (screen_info->allDamage != NULL);
      }
+     stats_wait_end (&screen_info->stats.present_wait_start,
+                     &screen_info->stats.present_wait);
 #endif /* HAVE_PRESENT_EXTENSION */
 
 #ifdef HAVE_EPOXY
@@ -2710,49 +5252,71 @@ repair_screen (ScreenInfo *screen_info)
          if (status != GL_SIGNALED)
          {
              DBG ("Waiting for GL pipeline");
-             return (screen_info->allDamage != None);
+             stats_wait_begin (&screen_info->stats.gl_wait_start);
+             return (screen_info->allDamage != NULL);
          }
      }
+     stats_wait_end (&screen_info->stats.gl_wait_start,
+                     &screen_info->stats.gl_wait);
 #else
 #warning GL_SIGNALED not supported by libepoxy, please update your version of libepoxy
 #endif
 #endif /* HAVE_EPOXY */
-    display_info = screen_info->display_info;
     damage = screen_info->allDamage;
     if (damage)
     {
-        if (screen_info->use_n_buffers > 1)
+#ifdef HAVE_PRESENT_EXTENSION
+        if (screen_info->use_present)
         {
-            if (screen_info->prevDamage)
-            {
-                XFixesUnionRegion(display_info->dpy,
-                                  screen_info->prevDamage,
-                                  screen_info->prevDamage,
-                                  damage);
-                damage = screen_info->prevDamage;
-            }
+            adapt_n_buffers (screen_info);
         }
+#endif /* HAVE_PRESENT_EXTENSION */
+        buffer = screen_info->current_buffer;
 
-        remove_timeouts (screen_info);
-        paint_all (screen_info, damage, screen_info->current_buffer);
-
-        if (screen_info->use_n_buffers > 1)
+        /* The other buffers miss that damage until they get painted */
+        for (i = 0; i < screen_info->use_n_buffers; i++)
         {
-            screen_info->current_buffer =
-                (screen_info->current_buffer + 1) % screen_info->use_n_buffers;
-
-            if (screen_info->prevDamage)
+            if (i == buffer)
+            {
+                continue;
+            }
+            if (screen_info->bufferDamage[i])
+            {
+                cairo_region_union (screen_info->bufferDamage[i], damage);
+            }
+            else
             {
-                XFixesDestroyRegion (display_info->dpy, screen_info->prevDamage);
+                screen_info->bufferDamage[i] = cairo_region_copy (damage);
             }
+        }
 
-            screen_info->prevDamage = screen_info->allDamage;
+        if (screen_info->bufferDamage[buffer])
+        {
+            cairo_region_union (screen_info->bufferDamage[buffer], damage);
+            damage = screen_info->bufferDamage[buffer];
         }
-        else
+
+        remove_timeouts (screen_info);
+        screen_info->stats.damaged_area += get_region_area (damage);
+        start = g_get_monotonic_time ();
+        cpu_start = get_cpu_time ();
+        paint_all (screen_info, damage, buffer);
+        screen_info->stats.cpu_time += get_cpu_time () - cpu_start;
+        stats_add_frame (screen_info, g_get_monotonic_time () - start);
+#ifdef HAVE_PRESENT_EXTENSION
+        screen_info->adapt_paint_time += g_get_monotonic_time () - start;
+        screen_info->adapt_area += get_region_area (damage);
+#endif /* HAVE_PRESENT_EXTENSION */
+
+        if (screen_info->bufferDamage[buffer])
         {
-            XFixesDestroyRegion (display_info->dpy, screen_info->allDamage);
+            cairo_region_destroy (screen_info->bufferDamage[buffer]);
+            screen_info->bufferDamage[buffer] = NULL;
         }
-        screen_info->allDamage = None;
+        cairo_region_destroy (screen_info->allDamage);
+        screen_info->allDamage = NULL;
+
+        screen_info->current_buffer = (buffer + 1) % screen_info->use_n_buffers;
     }
 
     return FALSE;
@@ -2763,37 +5327,53 @@ compositor_timeout_cb (gpointer data)
 {
     static guint number_of_retries = 0;
     ScreenInfo *screen_info;
-    gboolean retry;
 
     screen_info = (ScreenInfo *) data;
-    retry = repair_screen (screen_info);
+    screen_info->compositor_timeout_id = 0;
 
-    if (retry)
+    if (!repair_screen (screen_info))
     {
-        if (number_of_retries <= 100)
-        {
-            number_of_retries++;
-        }
-        if (number_of_retries == 100)
-        {
-            DBG ("Throttling repaint after 100 unsuccessful retries");
-            /* Stop the current timeout repain */
-            g_source_remove (screen_info->compositor_timeout_id);
-            retry = FALSE;
-            /* Recreate a throttled timeout instead */
-            screen_info->compositor_timeout_id =
-                g_timeout_add_full (TIMEOUT_THROTTLED_REPAINT_PRIORITY,
-                                    TIMEOUT_THROTTLED_REPAINT_MS,
-                                    compositor_timeout_cb, screen_info, NULL);
-        }
+        number_of_retries = 0;
+        return FALSE;
+    }
+
+    screen_info->stats.retries++;
+    if (number_of_retries < 100)
+    {
+        number_of_retries++;
+    }
+    if (number_of_retries == 100)
+    {
+        DBG ("Throttling repaint after 100 unsuccessful retries");
+        screen_info->stats.throttled++;
+        screen_info->compositor_timeout_id =
+            g_timeout_add_full (TIMEOUT_THROTTLED_REPAINT_PRIORITY,
+                                TIMEOUT_THROTTLED_REPAINT_MS,
+                                compositor_timeout_cb, screen_info, NULL);
+    }
+#ifdef HAVE_PRESENT_EXTENSION
+    else if (is_present_blocked (screen_info))
+    {
+        /*
+         * The present completion will reschedule the repaint, keep
+         * a throttled timeout only in case it never comes.
+         */
+        screen_info->compositor_timeout_id =
+            g_timeout_add_full (TIMEOUT_THROTTLED_REPAINT_PRIORITY,
+                                TIMEOUT_THROTTLED_REPAINT_MS,
+                                compositor_timeout_cb, screen_info, NULL);
     }
+#endif /* HAVE_PRESENT_EXTENSION */
     else
     {
-        screen_info->compositor_timeout_id = 0;
-        number_of_retries = 0;
+        /* Check again for the GL pipeline on the next frame */
+        screen_info->compositor_timeout_id =
+            g_timeout_add_full (TIMEOUT_REPAINT_PRIORITY,
+                                MAX (get_repaint_delay (screen_info), TIMEOUT_REPAINT_MS),
+                                compositor_timeout_cb, screen_info, NULL);
     }
 
-    return retry;
+    return FALSE;
 }
 
 static void
@@ -2803,40 +5383,31 @@ add_repair (ScreenInfo *screen_info)
     {
         screen_info->compositor_timeout_id =
             g_timeout_add_full (TIMEOUT_REPAINT_PRIORITY,
-                                TIMEOUT_REPAINT_MS,
+                                get_repaint_delay (screen_info),
                                 compositor_timeout_cb, screen_info, NULL);
     }
 }
 
 static void
-add_damage (ScreenInfo *screen_info, XserverRegion damage)
-{
-    DisplayInfo *display_info;
-
+add_damage (ScreenInfo *screen_info, cairo_region_t *damage)
+{
     TRACE ("entering");
 
-    if (damage == None)
+    if (damage == NULL)
     {
         return;
     }
 
-    if (screen_info->screenRegion == None)
+    if (screen_info->screenRegion == NULL)
     {
         screen_info->screenRegion = get_screen_region (screen_info);
     }
 
-    display_info = screen_info->display_info;
-    XFixesIntersectRegion (display_info->dpy,
-                           damage,
-                           damage,
-                           screen_info->screenRegion);
-    if (screen_info->allDamage != None)
-    {
-        XFixesUnionRegion (display_info->dpy,
-                           screen_info->allDamage,
-                           screen_info->allDamage,
-                           damage);
-        XFixesDestroyRegion (display_info->dpy, damage);
+    cairo_region_intersect (damage, screen_info->screenRegion);
+    if (screen_info->allDamage != NULL)
+    {
+        cairo_region_union (screen_info->allDamage, damage);
+        cairo_region_destroy (damage);
     }
     else
     {
@@ -2848,21 +5419,19 @@ add_damage (ScreenInfo *screen_info, XserverRegion damage)
 }
 
 static void
-fix_region (CWindow *cw, XserverRegion region)
+fix_region (CWindow *cw, cairo_region_t *region)
 {
-    GList *list;
     ScreenInfo *screen_info;
-    DisplayInfo *display_info;
+    guint i;
 
     screen_info = cw->screen_info;
-    display_info = screen_info->display_info;
 
     /* Exclude opaque windows in front of the given area */
-    for (list = screen_info->cwindows; list; list = g_list_next (list))
+    for (i = 0; i < screen_info->cwindows->len; i++)
     {
         CWindow *cw2;
 
-        cw2 = (CWindow *) list->data;
+        cw2 = (CWindow *) g_ptr_array_index (screen_info->cwindows, i);
         if (cw2 == cw)
         {
             break;
@@ -2874,35 +5443,64 @@ fix_region (CWindow *cw, XserverRegion region)
             {
                 cw2->picture = get_window_picture (cw2);
             }
-            if (cw2->borderSize == None)
+            if (cw2->borderSize == NULL)
             {
                 cw2->borderSize = border_size (cw2);
             }
-            if (cw2->clientSize == None)
+            if (cw2->clientSize == NULL)
             {
                 cw2->clientSize = client_size (cw2);
             }
             /* ...before subtracting them from the damaged zone. */
             if ((cw2->clientSize) && (screen_info->params->frame_opacity < 100))
             {
-                XFixesSubtractRegion (display_info->dpy, region,
-                                     region, cw2->clientSize);
+                cairo_region_subtract (region, cw2->clientSize);
             }
             else if (cw2->borderSize)
             {
-                XFixesSubtractRegion (display_info->dpy, region,
-                                     region, cw2->borderSize);
+                cairo_region_subtract (region, cw2->borderSize);
             }
         }
     }
 }
 
+/* Move the damage collected on the server since the last frame to allDamage */
+static void
+fetch_window_damage (ScreenInfo *screen_info)
+{
+    DisplayInfo *display_info;
+    XRectangle *rects;
+    int nrects;
+
+    if (!screen_info->windowDamagePending)
+    {
+        return;
+    }
+    screen_info->windowDamagePending = FALSE;
+    display_info = screen_info->display_info;
+
+    myDisplayErrorTrapPush (display_info);
+    rects = XFixesFetchRegion (display_info->dpy, screen_info->windowDamage, &nrects);
+    XFixesSetRegion (display_info->dpy, screen_info->windowDamage, NULL, 0);
+    myDisplayErrorTrapPopIgnored (display_info);
+
+    if (rects)
+    {
+        if (nrects > 0)
+        {
+            /* region will be freed by add_damage () */
+            add_damage (screen_info, region_from_xrectangles (rects, nrects));
+        }
+        XFree (rects);
+    }
+}
+
 static void
-repair_win (CWindow *cw, XRectangle *r)
+repair_win (CWindow *cw)
 {
     DisplayInfo *display_info;
     ScreenInfo *screen_info;
-    XserverRegion parts;
+    cairo_region_t *parts;
 
     g_return_if_fail (cw != NULL);
 
@@ -2916,29 +5514,69 @@ repair_win (CWindow *cw, XRectangle *r)
         return;
     }
 
-    myDisplayErrorTrapPush (display_info);
     if (cw->damaged)
     {
-        parts = XFixesCreateRegion (display_info->dpy, NULL, 0);
-        /* Copy the damage region to parts, subtracting it from the window's damage */
-        XDamageSubtract (display_info->dpy, cw->damage, None, parts);
-        XFixesTranslateRegion (display_info->dpy, parts,
-                               cw->attr.x + cw->attr.border_width,
-                               cw->attr.y + cw->attr.border_width);
-    }
-    else
-    {
-        parts = win_extents (cw);
-        /* Subtract all damage from the window's damage */
-        XDamageSubtract (display_info->dpy, cw->damage, None, None);
+        update_visible_regions (screen_info);
+        myDisplayErrorTrapPush (display_info);
+        if (cw->visible_region && cairo_region_is_empty (cw->visible_region))
+        {
+            /* Fully covered by opaque windows, the damage never reaches allDamage */
+            TRACE ("damage of window 0x%lx is not visible", cw->id);
+            screen_info->stats.damage_culled++;
+            XDamageSubtract (display_info->dpy, cw->damage, None, None);
+        }
+        else
+        {
+            /*
+             * Move the whole damage of the window into the screen's
+             * damage on the server, it is fetched once per frame by
+             * repair_screen ().
+             */
+            XDamageSubtract (display_info->dpy, cw->damage, None, screen_info->damageParts);
+            XFixesTranslateRegion (display_info->dpy, screen_info->damageParts,
+                                   cw->attr.x + cw->attr.border_width,
+                                   cw->attr.y + cw->attr.border_width);
+            XFixesUnionRegion (display_info->dpy, screen_info->windowDamage,
+                               screen_info->windowDamage, screen_info->damageParts);
+            screen_info->windowDamagePending = TRUE;
+            add_repair (screen_info);
+        }
+        myDisplayErrorTrapPopIgnored (display_info);
+        return;
     }
+
+    parts = win_extents (cw);
+    myDisplayErrorTrapPush (display_info);
+    XDamageSubtract (display_info->dpy, cw->damage, None, None);
     myDisplayErrorTrapPopIgnored (display_info);
 
     if (parts)
     {
-        fix_region (cw, parts);
-        /* parts region will be destroyed by add_damage () */
-        add_damage (cw->screen_info, parts);
+        /*
+         * Only keep the part of the damage that can be seen, damage from
+         * windows fully covered by opaque windows never reaches allDamage.
+         */
+        update_visible_regions (screen_info);
+        if (cw->visible_region)
+        {
+            cairo_region_intersect (parts, cw->visible_region);
+        }
+        else
+        {
+            fix_region (cw, parts);
+        }
+
+        if (cairo_region_is_empty (parts))
+        {
+            TRACE ("damage of window 0x%lx is not visible", cw->id);
+            screen_info->stats.damage_culled++;
+            cairo_region_destroy (parts);
+        }
+        else
+        {
+            /* parts region will be destroyed by add_damage () */
+            add_damage (cw->screen_info, parts);
+        }
         cw->damaged = TRUE;
     }
 }
@@ -2946,7 +5584,7 @@ repair_win (CWindow *cw, XRectangle *r)
 static void
 damage_screen (ScreenInfo *screen_info)
 {
-    XserverRegion region;
+    cairo_region_t *region;
 
     region = get_screen_region (screen_info);
     /* region will be freed by add_damage () */
@@ -2956,7 +5594,7 @@ damage_screen (ScreenInfo *screen_info)
 static void
 damage_win (CWindow *cw)
 {
-    XserverRegion extents;
+    cairo_region_t *extents;
 
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx", cw->id);
@@ -2970,15 +5608,9 @@ damage_win (CWindow *cw)
 static void
 update_extents (CWindow *cw)
 {
-    DisplayInfo *display_info;
-    ScreenInfo *screen_info;
-
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx", cw->id);
 
-    screen_info = cw->screen_info;
-    display_info = screen_info->display_info;
-
     if (WIN_IS_VISIBLE(cw))
     {
         damage_win (cw);
@@ -2986,9 +5618,10 @@ update_extents (CWindow *cw)
 
     if (cw->extents)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->extents);
-        cw->extents = None;
+        cairo_region_destroy (cw->extents);
+        cw->extents = NULL;
     }
+    cw->screen_info->clipChanged = TRUE;
 }
 
 static void
@@ -3024,13 +5657,13 @@ determine_mode (CWindow *cw)
 
     format = XRenderFindVisualFormat (display_info->dpy, cw->attr.visual);
     cw->argb = ((format) && (format->type == PictTypeDirect) && (format->direct.alphaMask));
+    screen_info->clipChanged = TRUE;
 
     if (cw->extents)
     {
-        XserverRegion damage;
+        cairo_region_t *damage;
 
-        damage = XFixesCreateRegion (display_info->dpy, NULL, 0);
-        XFixesCopyRegion (display_info->dpy, damage, cw->extents);
+        damage = cairo_region_copy (cw->extents);
         fix_region (cw, damage);
         /* damage region will be destroyed by add_damage () */
         add_damage (screen_info, damage);
@@ -3040,44 +5673,305 @@ determine_mode (CWindow *cw)
 static void
 expose_area (ScreenInfo *screen_info, XRectangle *rects, gint nrects)
 {
-    DisplayInfo *display_info;
-    XserverRegion region;
+    cairo_region_t *region;
 
     g_return_if_fail (rects != NULL);
     g_return_if_fail (nrects > 0);
     TRACE ("entering");
 
-    display_info = screen_info->display_info;
-    region = XFixesCreateRegion (display_info->dpy, rects, nrects);
+    region = region_from_xrectangles (rects, nrects);
     /* region will be destroyed by add_damage () */
     add_damage (screen_info, region);
 }
 
 static void
-set_win_opacity (CWindow *cw, guint32 opacity)
+account_scanout_time (ScreenInfo *screen_info)
+{
+    gint64 now;
+
+    now = g_get_monotonic_time ();
+    if (screen_info->scanout_window)
+    {
+        screen_info->stats.scanout_time += now - screen_info->stats.scanout_mode_start;
+    }
+    else
+    {
+        screen_info->stats.composited_time += now - screen_info->stats.scanout_mode_start;
+    }
+    screen_info->stats.scanout_mode_start = now;
+}
+
+static CWindow *
+get_top_window (ScreenInfo *screen_info)
+{
+    CWindow *cw;
+    guint i;
+
+    for (i = 0; i < screen_info->cwindows->len; i++)
+    {
+        cw = (CWindow *) g_ptr_array_index (screen_info->cwindows, i);
+        if (WIN_IS_VIEWABLE(cw) && (cw->attr.class != InputOnly))
+        {
+            return cw;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Whether the window may be shown without compositing, the damage rate
+ * of windows that do not ask for it is checked by check_scanout().
+ */
+static gboolean
+is_scanout_allowed (CWindow *cw)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = cw->screen_info;
+
+    /* For NET_WM_BYPASS_COMPOSITOR, 2 asks to keep compositing */
+    if ((cw->bypass_compositor == 2) || screen_info->zoomed)
+    {
+        return FALSE;
+    }
+
+    if (!WIN_IS_NATIVE_OPAQUE(cw) || (cw->opacity != NET_WM_OPAQUE) ||
+        WIN_IS_SHAPED(cw))
+    {
+        return FALSE;
+    }
+
+    /* Windows asking for it only need to cover their monitor */
+    if (cw->bypass_compositor == 1)
+    {
+        return is_fullscreen (cw);
+    }
+
+    /* Otherwise nothing else may be visible, on any monitor */
+    if (!WIN_IS_FULLSCREEN(cw))
+    {
+        return FALSE;
+    }
+
+    if (WIN_IS_OVERRIDE(cw))
+    {
+        return screen_info->params->unredirect_overlays;
+    }
+
+    return screen_info->params->unredirect_fullscreen;
+}
+
+static void
+enter_scanout (CWindow *cw)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = cw->screen_info;
+    TRACE ("window 0x%lx unredirected for scanout", cw->id);
+
+    unredirect_win (cw);
+    if (WIN_IS_REDIRECTED(cw))
+    {
+        return;
+    }
+
+    account_scanout_time (screen_info);
+    screen_info->scanout_window = cw->id;
+    screen_info->stats.scanout_entered++;
+
+    cw->fulloverlay = TRUE;
+    screen_info->wins_unredirected++;
+#if HAVE_OVERLAYS
+    if ((screen_info->wins_unredirected == 1) && (screen_info->display_info->have_overlays))
+    {
+        XUnmapWindow (myScreenGetXDisplay (screen_info), screen_info->overlay);
+    }
+#endif /* HAVE_OVERLAYS */
+}
+
+static void
+leave_scanout (CWindow *cw)
 {
+    ScreenInfo *screen_info;
     DisplayInfo *display_info;
+
+    screen_info = cw->screen_info;
+    display_info = screen_info->display_info;
+    TRACE ("window 0x%lx redirected again", cw->id);
+
+    account_scanout_time (screen_info);
+    screen_info->scanout_window = None;
+    screen_info->stats.scanout_left++;
+    /* Hysteresis, do not switch back and forth */
+    screen_info->scanout_retry_time = g_get_monotonic_time () + SCANOUT_RETRY_DELAY;
+
+    myDisplayErrorTrapPush (display_info);
+    XCompositeRedirectWindow (display_info->dpy, cw->id, CompositeRedirectManual);
+    myDisplayErrorTrapPopIgnored (display_info);
+    cw->redirected = TRUE;
+    cw->fulloverlay = FALSE;
+    screen_info->clipChanged = TRUE;
+
+    if (screen_info->wins_unredirected > 0)
+    {
+        screen_info->wins_unredirected--;
+    }
+#if HAVE_OVERLAYS
+    if ((screen_info->wins_unredirected == 0) && (display_info->have_overlays))
+    {
+        XMapWindow (display_info->dpy, screen_info->overlay);
+    }
+#endif /* HAVE_OVERLAYS */
+    damage_screen (screen_info);
+}
+
+static gboolean check_scanout_cb (gpointer data);
+
+static void
+cancel_scanout_check (ScreenInfo *screen_info)
+{
+    if (screen_info->scanout_timeout_id != 0)
+    {
+        g_source_remove (screen_info->scanout_timeout_id);
+        screen_info->scanout_timeout_id = 0;
+    }
+}
+
+static void
+schedule_scanout_check (ScreenInfo *screen_info, gint64 delay)
+{
+    if (screen_info->scanout_timeout_id != 0)
+    {
+        return;
+    }
+
+    screen_info->scanout_timeout_id =
+        g_timeout_add (MAX (delay / 1000, 1), check_scanout_cb, screen_info);
+}
+
+/*
+ * Unredirects the top window when the policy allows, as soon as it has
+ * qualified long enough, and redirects it again as soon as it does not.
+ */
+static void
+check_scanout (ScreenInfo *screen_info)
+{
+    CWindow *cw;
+    CWindow *top;
+    gint64 now;
+    gint64 wait;
+    guint damages;
+
+    g_return_if_fail (screen_info != NULL);
+    TRACE ("entering");
+
+    if (!screen_info->compositor_active || (screen_info->cwindows == NULL))
+    {
+        return;
+    }
+
+    top = get_top_window (screen_info);
+    if (screen_info->scanout_window)
+    {
+        cw = find_cwindow_in_screen (screen_info, screen_info->scanout_window);
+        if (cw && (cw == top) && is_scanout_allowed (cw))
+        {
+            return;
+        }
+        /* Something changed, going back to compositing cannot wait */
+        if (cw)
+        {
+            leave_scanout (cw);
+        }
+        else
+        {
+            account_scanout_time (screen_info);
+            screen_info->scanout_window = None;
+        }
+    }
+
+    if ((top == NULL) || !WIN_IS_REDIRECTED(top) || !is_scanout_allowed (top))
+    {
+        screen_info->scanout_candidate = None;
+        cancel_scanout_check (screen_info);
+        return;
+    }
+
+    now = g_get_monotonic_time ();
+    if (top->id != screen_info->scanout_candidate)
+    {
+        /* The pending check was for another window, start over */
+        cancel_scanout_check (screen_info);
+        screen_info->scanout_candidate = top->id;
+        screen_info->scanout_candidate_time = now;
+        screen_info->scanout_candidate_damage = top->damage_count;
+    }
+
+    /* Windows asking for it are unredirected right away, as when mapped */
+    wait = screen_info->scanout_retry_time - now;
+    if (top->bypass_compositor != 1)
+    {
+        wait = MAX (wait, screen_info->scanout_candidate_time + SCANOUT_ENTER_DELAY - now);
+    }
+    if (wait > 0)
+    {
+        schedule_scanout_check (screen_info, wait);
+        return;
+    }
+
+    if ((top->bypass_compositor != 1) && !WIN_IS_OVERRIDE(top))
+    {
+        /* Games and videos update all the time, others are left composited */
+        damages = top->damage_count - screen_info->scanout_candidate_damage;
+        if ((gint64) damages * G_USEC_PER_SEC <
+            (gint64) SCANOUT_MIN_DAMAGE_RATE * (now - screen_info->scanout_candidate_time))
+        {
+            screen_info->scanout_candidate_time = now;
+            screen_info->scanout_candidate_damage = top->damage_count;
+            schedule_scanout_check (screen_info, SCANOUT_ENTER_DELAY);
+            return;
+        }
+    }
+
+    enter_scanout (top);
+}
+
+static gboolean
+check_scanout_cb (gpointer data)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = (ScreenInfo *) data;
+    screen_info->scanout_timeout_id = 0;
+    check_scanout (screen_info);
+
+    return FALSE;
+}
+
+static void
+set_win_opacity (CWindow *cw, guint32 opacity)
+{
     ScreenInfo *screen_info;
 
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx", cw->id);
 
     screen_info = cw->screen_info;
-    display_info = screen_info->display_info;
 
     cw->opacity = opacity;
     determine_mode(cw);
-    if (cw->shadow)
+    if (WIN_HAS_SHADOW(cw))
     {
-        XRenderFreePicture (display_info->dpy, cw->shadow);
-        cw->shadow = None;
+        free_win_shadow (cw);
         if (cw->extents)
         {
-            XFixesDestroyRegion (display_info->dpy, cw->extents);
+            cairo_region_destroy (cw->extents);
         }
         cw->extents = win_extents (cw);
         add_repair (screen_info);
     }
+    check_scanout (screen_info);
 }
 
 static void
@@ -3119,26 +6013,10 @@ map_win (CWindow *cw)
 
     cw->viewable = TRUE;
     cw->damaged = FALSE;
+    screen_info->clipChanged = TRUE;
 
-    /* Check for new windows to un-redirect. */
-    if (WIN_HAS_DAMAGE(cw) && WIN_IS_NATIVE_OPAQUE(cw) &&
-        WIN_IS_REDIRECTED(cw) && !WIN_IS_SHAPED(cw) &&
-        ((screen_info->wins_unredirected > 0) || is_fullscreen (cw)))
-    {
-        /* Make those opaque, we don't want them to be transparent */
-        cw->opacity = NET_WM_OPAQUE;
-
-        /* For NET_WM_BYPASS_COMPOSITOR, 0 indicates no preference, 1 hints
-         * the compositor to disabling compositing.
-         */
-        if ((cw->bypass_compositor == 1) ||
-            (screen_info->params->unredirect_overlays &&
-             WIN_IS_OVERRIDE(cw) && cw->bypass_compositor == 0))
-        {
-            TRACE ("unredirecting toplevel window 0x%lx", cw->id);
-            unredirect_win (cw);
-        }
-    }
+    /* A new window on top may end or start the direct scanout */
+    check_scanout (screen_info);
 }
 
 static void
@@ -3153,6 +6031,13 @@ unmap_win (CWindow *cw)
     screen_info = cw->screen_info;
     display_info = screen_info->display_info;
 
+    if (cw->id == screen_info->scanout_window)
+    {
+        /* Keep the window redirected for when it is mapped again */
+        leave_scanout (cw);
+        screen_info->scanout_retry_time = 0;
+    }
+
     if (!WIN_IS_REDIRECTED(cw) && (screen_info->wins_unredirected > 0))
     {
         if (cw->fulloverlay)
@@ -3186,6 +6071,7 @@ unmap_win (CWindow *cw)
     cw->fulloverlay = FALSE;
 
     free_win_data (cw, FALSE);
+    check_scanout (screen_info);
 }
 
 static void
@@ -3229,7 +6115,7 @@ update_opaque_region (CWindow *cw, Window id)
     ScreenInfo *screen_info;
     XRectangle *rects = NULL;
     unsigned int nrects;
-    XserverRegion old_opaque_region;
+    cairo_region_t *old_opaque_region;
 
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx", cw->id);
@@ -3238,30 +6124,35 @@ update_opaque_region (CWindow *cw, Window id)
     display_info = screen_info->display_info;
 
     old_opaque_region = cw->opaque_region;
+    if (cw->opaqueClip)
+    {
+        cairo_region_destroy (cw->opaqueClip);
+        cw->opaqueClip = NULL;
+    }
+    screen_info->clipChanged = TRUE;
 
     nrects = getOpaqueRegionRects (display_info, id, &rects);
     if (nrects)
     {
-        cw->opaque_region = XFixesCreateRegion (display_info->dpy, rects, nrects);
+        cw->opaque_region = region_from_xrectangles (rects, nrects);
         g_free (rects);
     }
     else
     {
-        cw->opaque_region = None;
+        cw->opaque_region = NULL;
     }
 
-    if (old_opaque_region != None)
+    if (old_opaque_region != NULL)
     {
         if (!WIN_IS_VISIBLE(cw) || !WIN_IS_REDIRECTED(cw))
         {
-            XFixesDestroyRegion (display_info->dpy, old_opaque_region);
+            cairo_region_destroy (old_opaque_region);
         }
         else
         {
             if (cw->opaque_region)
             {
-                XFixesSubtractRegion (display_info->dpy, old_opaque_region,
-                                      old_opaque_region, cw->opaque_region);
+                cairo_region_subtract (old_opaque_region, cw->opaque_region);
             }
             translate_to_client_region (cw, old_opaque_region);
             /* old_opaque_region region will be destroyed by add_damage () */
@@ -3349,6 +6240,7 @@ add_win (DisplayInfo *display_info, Window id, Client *c)
     new->screen_info = screen_info;
     new->id = id;
     new->damaged = FALSE;
+    new->damage_count = 0;
     new->redirected = TRUE;
     new->fulloverlay = FALSE;
     new->shaped = is_shaped (display_info, id);
@@ -3369,21 +6261,30 @@ add_win (DisplayInfo *display_info, Window id, Client *c)
     }
 #if HAVE_NAME_WINDOW_PIXMAP
     new->name_window_pixmap = None;
+    new->saved_pixmap = None;
 #endif
     new->picture = None;
-    new->saved_picture = None;
     new->alphaPict = None;
     new->alphaBorderPict = None;
     new->shadowPict = None;
-    new->borderSize = None;
-    new->clientSize = None;
-    new->extents = None;
+    new->borderSize = NULL;
+    new->clientSize = NULL;
+    new->extents = NULL;
+    new->visible_region = NULL;
     new->shadow = None;
+    new->shadow_entry = NULL;
+    new->shadow_slices = NULL;
     new->shadow_dx = 0;
     new->shadow_dy = 0;
     new->shadow_width = 0;
     new->shadow_height = 0;
-    new->borderClip = None;
+    new->borderClip = NULL;
+    new->opaqueClip = NULL;
+    new->thumbnail = NULL;
+    new->thumbnail_width = 0;
+    new->thumbnail_height = 0;
+    new->thumbnail_stale = FALSE;
+    new->thumbnail_time = 0;
 
     if (c)
     {
@@ -3398,7 +6299,7 @@ add_win (DisplayInfo *display_info, Window id, Client *c)
     determine_mode (new);
 
     /* Insert window at top of stack */
-    screen_info->cwindows = g_list_prepend (screen_info->cwindows, new);
+    g_ptr_array_insert (screen_info->cwindows, 0, new);
     g_hash_table_insert(screen_info->cwindow_hash, (gpointer) new->id, new);
 
     if (WIN_IS_VISIBLE(new))
@@ -3415,21 +6316,24 @@ static void
 restack_win (CWindow *cw, Window above)
 {
     ScreenInfo *screen_info;
+    GPtrArray *cwindows;
     Window previous_above;
-    GList *sibling;
-    GList *next;
+    gint index;
+    guint i;
 
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx above 0x%lx", cw->id, above);
 
     screen_info = cw->screen_info;
-    sibling = g_list_find (screen_info->cwindows, (gconstpointer) cw);
-    next = g_list_next (sibling);
+    screen_info->clipChanged = TRUE;
+    cwindows = screen_info->cwindows;
+    index = find_stack_index (screen_info, cw);
+    g_return_if_fail (index >= 0);
     previous_above = None;
 
-    if (next)
+    if ((guint) index + 1 < cwindows->len)
     {
-        CWindow *ncw = (CWindow *) next;
+        CWindow *ncw = (CWindow *) g_ptr_array_index (cwindows, index + 1);
         previous_above = ncw->id;
     }
 
@@ -3439,28 +6343,31 @@ restack_win (CWindow *cw, Window above)
     if (above == None)
     {
         /* Insert at bottom of window stack */
-        screen_info->cwindows = g_list_delete_link (screen_info->cwindows, sibling);
-        screen_info->cwindows = g_list_append (screen_info->cwindows, cw);
+        g_ptr_array_remove_index (cwindows, index);
+        g_ptr_array_add (cwindows, cw);
     }
     else if (previous_above != above)
     {
-        GList *list;
-
-        for (list = screen_info->cwindows; list; list = g_list_next (list))
+        for (i = 0; i < cwindows->len; i++)
         {
-            CWindow *cw2 = (CWindow *) list->data;
+            CWindow *cw2 = (CWindow *) g_ptr_array_index (cwindows, i);
             if (cw2->id == above)
             {
                 break;
             }
         }
 
-        if (list != NULL)
+        if (i < cwindows->len)
         {
-            screen_info->cwindows = g_list_delete_link (screen_info->cwindows, sibling);
-            screen_info->cwindows = g_list_insert_before (screen_info->cwindows, list, cw);
+            g_ptr_array_remove_index (cwindows, index);
+            if ((guint) index < i)
+            {
+                i--;
+            }
+            g_ptr_array_insert (cwindows, i, cw);
         }
     }
+    check_scanout (screen_info);
 }
 
 static void
@@ -3468,30 +6375,33 @@ resize_win (CWindow *cw, gint x, gint y, gint width, gint height, gint bw)
 {
     DisplayInfo *display_info;
     ScreenInfo *screen_info;
-    XserverRegion damage;
+    cairo_region_t *damage;
 
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx, (%i,%i) %ix%i", cw->id, x, y, width, height);
 
     screen_info = cw->screen_info;
     display_info = screen_info->display_info;
-    damage = None;
+    damage = NULL;
 
     myDisplayErrorTrapPush (display_info);
 
     if (WIN_IS_VISIBLE(cw))
     {
-        damage = XFixesCreateRegion (display_info->dpy, NULL, 0);
         if (cw->extents)
         {
-            XFixesCopyRegion (display_info->dpy, damage, cw->extents);
+            damage = cairo_region_copy (cw->extents);
+        }
+        else
+        {
+            damage = cairo_region_create ();
         }
     }
 
     if (cw->extents)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->extents);
-        cw->extents = None;
+        cairo_region_destroy (cw->extents);
+        cw->extents = NULL;
     }
 
     if ((cw->attr.width != width) || (cw->attr.height != height))
@@ -3502,6 +6412,11 @@ resize_win (CWindow *cw, gint x, gint y, gint width, gint height, gint bw)
             XFreePixmap (display_info->dpy, cw->name_window_pixmap);
             cw->name_window_pixmap = None;
         }
+        if (cw->saved_pixmap)
+        {
+            XFreePixmap (display_info->dpy, cw->saved_pixmap);
+            cw->saved_pixmap = None;
+        }
 #endif
         if (cw->picture)
         {
@@ -3509,17 +6424,11 @@ resize_win (CWindow *cw, gint x, gint y, gint width, gint height, gint bw)
             cw->picture = None;
         }
 
-        if (cw->saved_picture)
-        {
-            XRenderFreePicture (display_info->dpy, cw->saved_picture);
-            cw->saved_picture = None;
-        }
-
-        if (cw->shadow)
+        if (WIN_HAS_SHADOW(cw))
         {
-            XRenderFreePicture (display_info->dpy, cw->shadow);
-            cw->shadow = None;
+            free_win_shadow (cw);
         }
+        cw->thumbnail_stale = TRUE;
     }
 
     if ((cw->attr.width != width) || (cw->attr.height != height) ||
@@ -3527,14 +6436,20 @@ resize_win (CWindow *cw, gint x, gint y, gint width, gint height, gint bw)
     {
         if (cw->borderSize)
         {
-            XFixesDestroyRegion (display_info->dpy, cw->borderSize);
-            cw->borderSize = None;
+            cairo_region_destroy (cw->borderSize);
+            cw->borderSize = NULL;
         }
 
         if (cw->clientSize)
         {
-            XFixesDestroyRegion (display_info->dpy, cw->clientSize);
-            cw->clientSize = None;
+            cairo_region_destroy (cw->clientSize);
+            cw->clientSize = NULL;
+        }
+
+        if (cw->opaqueClip)
+        {
+            cairo_region_destroy (cw->opaqueClip);
+            cw->opaqueClip = NULL;
         }
     }
 
@@ -3543,11 +6458,12 @@ resize_win (CWindow *cw, gint x, gint y, gint width, gint height, gint bw)
     cw->attr.width = width;
     cw->attr.height = height;
     cw->attr.border_width = bw;
+    screen_info->clipChanged = TRUE;
 
     if (damage)
     {
         cw->extents = win_extents (cw);
-        XFixesUnionRegion (display_info->dpy, damage, damage, cw->extents);
+        cairo_region_union (damage, cw->extents);
 
         fix_region (cw, damage);
         /* damage region will be destroyed by add_damage () */
@@ -3555,6 +6471,7 @@ resize_win (CWindow *cw, gint x, gint y, gint width, gint height, gint bw)
     }
 
     myDisplayErrorTrapPopIgnored (display_info);
+    check_scanout (screen_info);
 }
 
 static void
@@ -3562,7 +6479,7 @@ reshape_win (CWindow *cw)
 {
     DisplayInfo *display_info;
     ScreenInfo *screen_info;
-    XserverRegion damage;
+    cairo_region_t *damage;
 
     g_return_if_fail (cw != NULL);
     TRACE ("window 0x%lx", cw->id);
@@ -3570,51 +6487,61 @@ reshape_win (CWindow *cw)
     screen_info = cw->screen_info;
     display_info = screen_info->display_info;
 
-    damage = None;
+    damage = NULL;
 
     myDisplayErrorTrapPush (display_info);
 
     if (WIN_IS_VISIBLE(cw))
     {
-        damage = XFixesCreateRegion (display_info->dpy, NULL, 0);
         if (cw->extents)
         {
-            XFixesCopyRegion (display_info->dpy, damage, cw->extents);
+            damage = cairo_region_copy (cw->extents);
+        }
+        else
+        {
+            damage = cairo_region_create ();
         }
     }
 
     if (cw->extents)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->extents);
-        cw->extents = None;
+        cairo_region_destroy (cw->extents);
+        cw->extents = NULL;
     }
 
-    if (cw->shadow)
+    if (WIN_HAS_SHADOW(cw))
     {
-        XRenderFreePicture (display_info->dpy, cw->shadow);
-        cw->shadow = None;
+        free_win_shadow (cw);
     }
 
     if (cw->borderSize)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->borderSize);
-        cw->borderSize = None;
+        cairo_region_destroy (cw->borderSize);
+        cw->borderSize = NULL;
     }
 
     if (cw->clientSize)
     {
-        XFixesDestroyRegion (display_info->dpy, cw->clientSize);
-        cw->clientSize = None;
+        cairo_region_destroy (cw->clientSize);
+        cw->clientSize = NULL;
+    }
+
+    if (cw->opaqueClip)
+    {
+        cairo_region_destroy (cw->opaqueClip);
+        cw->opaqueClip = NULL;
     }
 
+    screen_info->clipChanged = TRUE;
+
     if (damage)
     {
         cw->extents = win_extents (cw);
-        XFixesUnionRegion (display_info->dpy, damage, damage, cw->extents);
+        cairo_region_union (damage, cw->extents);
 
         /* A shape notify will likely change the shadows too, so clear the extents */
-        XFixesDestroyRegion (display_info->dpy, cw->extents);
-        cw->extents = None;
+        cairo_region_destroy (cw->extents);
+        cw->extents = NULL;
 
         fix_region (cw, damage);
         /* damage region will be destroyed by add_damage () */
@@ -3622,6 +6549,7 @@ reshape_win (CWindow *cw)
     }
 
     myDisplayErrorTrapPopIgnored (display_info);
+    check_scanout (screen_info);
 }
 
 static void
@@ -3644,69 +6572,120 @@ destroy_win (DisplayInfo *display_info, Window id)
         }
         screen_info = cw->screen_info;
         g_hash_table_remove(screen_info->cwindow_hash, (gpointer) cw->id);
-        screen_info->cwindows = g_list_remove (screen_info->cwindows, (gconstpointer) cw);
+        g_ptr_array_remove (screen_info->cwindows, cw);
+        g_ptr_array_remove (screen_info->visible_windows, cw);
 
         free_win_data (cw, TRUE);
     }
 }
 
 static void
-update_cursor (ScreenInfo *screen_info)
+damage_cursor (ScreenInfo *screen_info)
+{
+#ifdef HAVE_EPOXY
+    if (screen_info->use_glx)
+    {
+        /* The cursor is part of the scene with GLX */
+        expose_area (screen_info, &screen_info->cursorLocation, 1);
+        return;
+    }
+#endif /* HAVE_EPOXY */
+
+    /* The scene is unchanged, a frame is needed for the cursor plane only */
+    screen_info->cursor_damaged = TRUE;
+    add_damage (screen_info, cairo_region_create ());
+}
+
+static void
+update_cursor (ScreenInfo *screen_info, unsigned long serial)
 {
     XFixesCursorImage *cursor;
+    CursorEntry *entry;
+    gint x_root, y_root;
 
     g_return_if_fail (screen_info != NULL);
     TRACE ("entering");
 
-    cursor = XFixesGetCursorImage (screen_info->display_info->dpy);
-    if (cursor == NULL)
+    if ((serial != 0) && (screen_info->cursorSerial == serial))
     {
-        g_warning ("Failed to retrieve cursor image!");
         return;
     }
 
-    if (screen_info->cursorSerial != cursor->cursor_serial)
+    cursor = NULL;
+    entry = NULL;
+    if (serial != 0)
     {
-        if (screen_info->zoomed)
+        entry = g_hash_table_lookup (screen_info->cursor_cache, GUINT_TO_POINTER (serial));
+    }
+
+    if (entry)
+    {
+        /* Known cursor, no need to fetch its image again */
+        x_root = screen_info->cursorLocation.x + screen_info->cursorOffsetX;
+        y_root = screen_info->cursorLocation.y + screen_info->cursorOffsetY;
+    }
+    else
+    {
+        cursor = XFixesGetCursorImage (screen_info->display_info->dpy);
+        if (cursor == NULL)
         {
-            expose_area (screen_info, &screen_info->cursorLocation, 1);
+            g_warning ("Failed to retrieve cursor image!");
+            return;
         }
-
-        if (screen_info->cursorPicture)
+        serial = cursor->cursor_serial;
+        x_root = cursor->x;
+        y_root = cursor->y;
+        if (screen_info->cursorSerial == serial)
         {
-            XRenderFreePicture (screen_info->display_info->dpy, screen_info->cursorPicture);
+            XFree (cursor);
+            return;
         }
-        screen_info->cursorPicture = cursor_to_picture (screen_info, cursor);
-
-        screen_info->cursorSerial = cursor->cursor_serial;
-        screen_info->cursorOffsetX = cursor->xhot;
-        screen_info->cursorOffsetY = cursor->yhot;
-        screen_info->cursorLocation.x = cursor->x - cursor->xhot;
-        screen_info->cursorLocation.y = cursor->y - cursor->yhot;
-        screen_info->cursorLocation.width = cursor->width;
-        screen_info->cursorLocation.height = cursor->height;
-
-        if (screen_info->zoomed)
+        entry = g_hash_table_lookup (screen_info->cursor_cache, GUINT_TO_POINTER (serial));
+        if (entry == NULL)
         {
-            expose_area (screen_info, &screen_info->cursorLocation, 1);
+            entry = cursor_cache_add (screen_info, cursor);
         }
+        XFree (cursor);
+    }
+
+    if (screen_info->zoomed)
+    {
+        damage_cursor (screen_info);
     }
 
-    XFree (cursor);
+    screen_info->cursorPicture = entry->picture;
+    screen_info->cursorSerial = serial;
+    screen_info->cursorOffsetX = entry->xhot;
+    screen_info->cursorOffsetY = entry->yhot;
+    screen_info->cursorLocation.x = x_root - entry->xhot;
+    screen_info->cursorLocation.y = y_root - entry->yhot;
+    screen_info->cursorLocation.width = entry->width;
+    screen_info->cursorLocation.height = entry->height;
+
+    if (screen_info->zoomed)
+    {
+        damage_cursor (screen_info);
+    }
 }
 
 static void
-recenter_zoomed_area (ScreenInfo *screen_info, int x_root, int y_root)
+recenter_zoomed_area (ScreenInfo *screen_info, int x_root, int y_root, gboolean pan)
 {
     int zf = screen_info->transform.matrix[0][0];
     double zoom = XFixedToDouble (zf);
+    int offset_x = 0;
+    int offset_y = 0;
 
     if (screen_info->zoomed)
     {
-        int xp = x_root * (1 - zoom);
-        int yp = y_root * (1 - zoom);
-        screen_info->transform.matrix[0][2] = (xp << 16);
-        screen_info->transform.matrix[1][2] = (yp << 16);
+        /*
+         * Keep the view on whole pixels, so that panning can shift
+         * the previous frame instead of scaling it all again.
+         */
+        offset_x = x_root * (1 - zoom) / zoom;
+        offset_y = y_root * (1 - zoom) / zoom;
+        screen_info->transform.matrix[0][2] = XDoubleToFixed (offset_x * zoom);
+        screen_info->transform.matrix[1][2] = XDoubleToFixed (offset_y * zoom);
     }
 
     if (zf > (1 << 14) && zf < (1 << 16))
@@ -3747,8 +6726,80 @@ recenter_zoomed_area (ScreenInfo *screen_info, int x_root, int y_root)
                                     &screen_info->transform);
     }
 
-    damage_screen (screen_info);
+    if (pan && screen_info->zoomed)
+    {
+        /* Present buffers keep the view they were last shown with instead */
+        if (!screen_info->use_glx && !screen_info->use_present)
+        {
+            screen_info->zoom_shift_x += screen_info->zoom_offset_x - offset_x;
+            screen_info->zoom_shift_y += screen_info->zoom_offset_y - offset_y;
+        }
+        screen_info->zoom_offset_x = offset_x;
+        screen_info->zoom_offset_y = offset_y;
+        /* The windows did not change, only the view does, empty damage will do */
+        add_damage (screen_info, cairo_region_create ());
+    }
+    else
+    {
+        screen_info->zoom_shift_x = 0;
+        screen_info->zoom_shift_y = 0;
+        screen_info->zoom_offset_x = offset_x;
+        screen_info->zoom_offset_y = offset_y;
+        damage_screen (screen_info);
+    }
+}
+
+#ifdef HAVE_XI2
+static void
+select_raw_motion (ScreenInfo *screen_info, gboolean enable)
+{
+    DisplayInfo *display_info;
+    XIEventMask *masks;
+    XIEventMask mask;
+    guchar *bits;
+    int n, i, len;
+
+    display_info = screen_info->display_info;
+    if (!display_info->devices->xi2_available)
+    {
+        return;
+    }
+
+    /* Raw events are selected on the root window, keep the other events there */
+    len = XIMaskLen (XI_LASTEVENT);
+    bits = g_new0 (guchar, len);
+    myDisplayErrorTrapPush (display_info);
+    masks = XIGetSelectedEvents (display_info->dpy, screen_info->xroot, &n);
+    if (masks)
+    {
+        for (i = 0; i < n; i++)
+        {
+            if (masks[i].deviceid == XIAllMasterDevices)
+            {
+                memcpy (bits, masks[i].mask, MIN (masks[i].mask_len, len));
+                break;
+            }
+        }
+        XFree (masks);
+    }
+
+    if (enable)
+    {
+        XISetMask (bits, XI_RawMotion);
+    }
+    else
+    {
+        XIClearMask (bits, XI_RawMotion);
+    }
+
+    mask.deviceid = XIAllMasterDevices;
+    mask.mask_len = len;
+    mask.mask = bits;
+    XISelectEvents (display_info->dpy, screen_info->xroot, &mask, 1);
+    screen_info->zoom_raw_motion = (myDisplayErrorTrapPop (display_info) == Success) && enable;
+    g_free (bits);
 }
+#endif /* HAVE_XI2 */
 
 static gboolean
 zoom_timeout_cb (gpointer data)
@@ -3777,14 +6828,52 @@ zoom_timeout_cb (gpointer data)
     if (screen_info->cursorLocation.x + screen_info->cursorOffsetX != x_root ||
         screen_info->cursorLocation.y + screen_info->cursorOffsetY != y_root)
     {
+        if (screen_info->cursor_is_zoomed)
+        {
+            damage_cursor (screen_info);
+        }
         screen_info->cursorLocation.x = x_root - screen_info->cursorOffsetX;
         screen_info->cursorLocation.y = y_root - screen_info->cursorOffsetY;
-        recenter_zoomed_area (screen_info, x_root, y_root);
+        if (screen_info->cursor_is_zoomed)
+        {
+            damage_cursor (screen_info);
+        }
+        recenter_zoomed_area (screen_info, x_root, y_root, TRUE);
+    }
+
+    if (screen_info->zoom_raw_motion)
+    {
+        /* Called once per frame on motion only, the next motion will reschedule */
+        screen_info->zoom_timeout_id = 0;
+        return FALSE;
     }
 
     return TRUE;
 }
 
+#ifdef HAVE_XI2
+static void
+compositorHandleRawMotion (DisplayInfo *display_info)
+{
+    ScreenInfo *screen_info;
+    GSList *list;
+
+    for (list = display_info->screens; list; list = g_slist_next (list))
+    {
+        screen_info = (ScreenInfo *) list->data;
+        if (screen_info->zoomed && screen_info->zoom_raw_motion &&
+            (screen_info->zoom_timeout_id == 0))
+        {
+            /* Query the pointer at most once per frame */
+            screen_info->zoom_timeout_id =
+                g_timeout_add_full (TIMEOUT_REPAINT_PRIORITY,
+                                    get_repaint_delay (screen_info),
+                                    zoom_timeout_cb, screen_info, NULL);
+        }
+    }
+}
+#endif /* HAVE_XI2 */
+
 static void
 compositorHandleDamage (DisplayInfo *display_info, XDamageNotifyEvent *ev)
 {
@@ -3798,7 +6887,7 @@ compositorHandleDamage (DisplayInfo *display_info, XDamageNotifyEvent *ev)
     /*
       ev->drawable is the window ID of the damaged window
       ev->geometry is the geometry of the damaged window
-      ev->area     is the bounding rect for the damaged area
+      ev->area     is the bounding box of the damaged area
       ev->damage   is the damage handle returned by XDamageCreate()
      */
 
@@ -3806,8 +6895,10 @@ compositorHandleDamage (DisplayInfo *display_info, XDamageNotifyEvent *ev)
     if (is_on_compositor (cw) && WIN_IS_REDIRECTED(cw))
     {
         screen_info = cw->screen_info;
-        repair_win (cw, &ev->area);
+        repair_win (cw);
         screen_info->damages_pending = ev->more;
+        cw->damage_count++;
+        cw->thumbnail_stale = TRUE;
     }
 }
 
@@ -3909,6 +7000,7 @@ compositorHandlePropertyNotify (DisplayInfo *display_info, XPropertyEvent *ev)
         if (is_on_compositor (cw))
         {
             getBypassCompositor (display_info, cw->id, &cw->bypass_compositor);
+            check_scanout (cw->screen_info);
         }
     }
     else if (ev->atom == display_info->atoms[NET_WM_OPAQUE_REGION])
@@ -3993,7 +7085,6 @@ compositorHandleCirculateNotify (DisplayInfo *display_info, XCirculateEvent *ev)
 {
     CWindow *cw;
     CWindow *top;
-    GList *first;
     Window above;
 
     g_return_if_fail (display_info != NULL);
@@ -4006,8 +7097,11 @@ compositorHandleCirculateNotify (DisplayInfo *display_info, XCirculateEvent *ev)
         return;
     }
 
-    first = cw->screen_info->cwindows;
-    top = (CWindow *) first;
+    top = NULL;
+    if (cw->screen_info->cwindows->len > 0)
+    {
+        top = (CWindow *) g_ptr_array_index (cw->screen_info->cwindows, 0);
+    }
 
     if ((ev->place == PlaceOnTop) && (top))
     {
@@ -4148,7 +7242,7 @@ compositorHandleCursorNotify (DisplayInfo *display_info, XFixesCursorNotifyEvent
     screen_info = myDisplayGetScreenFromRoot (display_info, ev->window);
     if (screen_info && screen_info->cursor_is_zoomed)
     {
-        update_cursor (screen_info);
+        update_cursor (screen_info, ev->cursor_serial);
     }
 }
 
@@ -4194,13 +7288,31 @@ compositorHandlePresentCompleteNotify (DisplayInfo *display_info, XPresentComple
         screen_info = (ScreenInfo *) list->data;
         if (screen_info->output == ev->window)
         {
-             DBG ("present completed, present pending cleared");
-             screen_info->present_pending = FALSE;
+             DBG ("present completed, %u present pending", screen_info->present_pending);
+             if (screen_info->present_pending > 0)
+             {
+                 screen_info->present_pending--;
+             }
+             screen_info->adapt_latency += g_get_monotonic_time () -
+                 screen_info->present_start[ev->serial_number % N_BUFFERS];
+             screen_info->adapt_frames++;
+             stats_wait_end (&screen_info->stats.present_wait_start,
+                             &screen_info->stats.present_wait);
+             update_vblank_timing (screen_info, (gint64) ev->ust, ev->msc);
+             if ((screen_info->allDamage != NULL) || (screen_info->windowDamagePending))
+             {
+                 /* Replace the fallback timeout with the actual repaint */
+                 remove_timeouts (screen_info);
+                 add_repair (screen_info);
+             }
              break;
         }
     }
 }
 
+#endif /* HAVE_PRESENT_EXTENSION */
+
+#if defined (HAVE_PRESENT_EXTENSION) || defined (HAVE_XI2)
 static void
 compositorHandleGenericEvent(DisplayInfo *display_info, XGenericEvent *ev)
 {
@@ -4210,6 +7322,7 @@ compositorHandleGenericEvent(DisplayInfo *display_info, XGenericEvent *ev)
     g_return_if_fail (ev != NULL);
     TRACE ("entering");
 
+#ifdef HAVE_PRESENT_EXTENSION
     if (ev_cookie->extension == display_info->present_opcode)
     {
         XGetEventData (display_info->dpy, ev_cookie);
@@ -4219,9 +7332,19 @@ compositorHandleGenericEvent(DisplayInfo *display_info, XGenericEvent *ev)
                                                    (XPresentCompleteNotifyEvent *) ev_cookie->data);
         }
         XFreeEventData (display_info->dpy, ev_cookie);
+        return;
     }
-}
 #endif /* HAVE_PRESENT_EXTENSION */
+#ifdef HAVE_XI2
+    if (display_info->devices->xi2_available &&
+        ev_cookie->extension == display_info->devices->xi2_opcode &&
+        ev_cookie->evtype == XI_RawMotion)
+    {
+        compositorHandleRawMotion (display_info);
+    }
+#endif /* HAVE_XI2 */
+}
+#endif /* HAVE_PRESENT_EXTENSION || HAVE_XI2 */
 
 static void
 compositorSetCMSelection (ScreenInfo *screen_info, Window w)
@@ -4239,16 +7362,44 @@ compositorSetCMSelection (ScreenInfo *screen_info, Window w)
     setXAtomManagerOwner (display_info, a, screen_info->xroot, w);
 }
 
-static Pixmap
-compositorScaleWindowPixmap (CWindow *cw, guint *width, guint *height)
+#if HAVE_NAME_WINDOW_PIXMAP
+static cairo_surface_t *
+create_thumbnail_surface (ScreenInfo *screen_info, guint width, guint height)
+{
+    Display *dpy;
+    cairo_surface_t *root;
+    cairo_surface_t *surface;
+
+    dpy = myScreenGetXDisplay (screen_info);
+    root = cairo_xlib_surface_create (dpy, screen_info->xroot,
+                                      DefaultVisual (dpy, screen_info->screen),
+                                      screen_info->width, screen_info->height);
+    /* cairo owns the pixmap, freed along with the last reference */
+    surface = cairo_surface_create_similar (root, CAIRO_CONTENT_COLOR_ALPHA, width, height);
+    cairo_surface_destroy (root);
+
+    if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_XLIB)
+    {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    return surface;
+}
+
+static gboolean
+update_window_thumbnail (CWindow *cw, guint width, guint height)
 {
     Display *dpy;
     ScreenInfo *screen_info;
     DisplayInfo *display_info;
-    Picture srcPicture, tmpPicture, destPicture;
-    Pixmap tmpPixmap, dstPixmap;
+    XRenderPictureAttributes pa;
+    Picture srcPicture, destPicture;
     XTransform transform;
+    XRenderPictFormat *src_format;
     XRenderPictFormat *render_format;
+    cairo_surface_t *surface;
+    Drawable draw;
     double scale;
     int tx, ty;
     int src_x, src_y;
@@ -4261,15 +7412,19 @@ compositorScaleWindowPixmap (CWindow *cw, guint *width, guint *height)
     display_info = screen_info->display_info;
     dpy = myScreenGetXDisplay (screen_info);
 
-    srcPicture = cw->picture;
-    if (!srcPicture)
+    /* Scale from a picture of our own, the window picture is left as painted */
+    if (cw->picture)
     {
-        srcPicture = cw->saved_picture;
+        draw = (cw->name_window_pixmap ? cw->name_window_pixmap : cw->id);
     }
-    /* Could not get a usable picture, bail out */
-    if (!srcPicture)
+    else
     {
-        return None;
+        draw = cw->saved_pixmap;
+    }
+    /* Could not get a usable drawable, bail out */
+    if (!draw)
+    {
+        return FALSE;
     }
 
     /* Get the source pixmap size to compute the scale */
@@ -4291,84 +7446,79 @@ compositorScaleWindowPixmap (CWindow *cw, guint *width, guint *height)
     /* Shaped windows have no height */
     if (src_w == 0 || src_h == 0)
     {
-        return None;
+        return FALSE;
     }
 
-    /*/
-     * Caller may pass either NULL or 0.
-     * If 0, we return the actual unscalled size.
-     */
-    dst_w = (width != NULL && *width > 0) ? *width : src_w;
-    dst_h = (height != NULL && *height > 0) ? *height : src_h;
-    dest_size = MIN (dst_w, dst_h);
-
+    dest_size = MIN (width, height);
     scale = (double) dest_size / (double) src_size;
     dst_w = src_w * scale;
     dst_h = src_h * scale;
-
-    transform.matrix[0][0] = XDoubleToFixed (1.0);
-    transform.matrix[0][1] = XDoubleToFixed (0.0);
-    transform.matrix[0][2] = XDoubleToFixed (0.0);
-    transform.matrix[1][0] = XDoubleToFixed (0.0);
-    transform.matrix[1][1] = XDoubleToFixed (1.0);
-    transform.matrix[1][2] = XDoubleToFixed (0.0);
-    transform.matrix[2][0] = XDoubleToFixed (0.0);
-    transform.matrix[2][1] = XDoubleToFixed (0.0);
-    transform.matrix[2][2] = XDoubleToFixed (scale);
-
-    tmpPixmap = XCreatePixmap (dpy, screen_info->output, src_w, src_h, 32);
-    if (!tmpPixmap)
+    if (dst_w == 0 || dst_h == 0)
     {
-        return None;
+        return FALSE;
     }
 
-    dstPixmap = XCreatePixmap (dpy, screen_info->output, dst_w, dst_h, 32);
-    if (!dstPixmap)
+    src_format = get_window_format (cw);
+    render_format = XRenderFindStandardFormat (dpy, PictStandardARGB32);
+    if (!src_format || !render_format)
     {
-        XFreePixmap (dpy, tmpPixmap);
-        return None;
+        return FALSE;
     }
 
-    render_format = get_window_format (cw);
-    if (!render_format)
+    /* Refill the thumbnail in place as long as its size does not change */
+    surface = cw->thumbnail;
+    if ((surface) &&
+        ((cairo_xlib_surface_get_width (surface) != (int) dst_w) ||
+         (cairo_xlib_surface_get_height (surface) != (int) dst_h)))
     {
-        XFreePixmap (dpy, dstPixmap);
-        XFreePixmap (dpy, tmpPixmap);
-        return None;
+        cairo_surface_destroy (surface);
+        cw->thumbnail = NULL;
+        surface = NULL;
     }
+    if (!surface)
+    {
+        surface = create_thumbnail_surface (screen_info, dst_w, dst_h);
+        if (!surface)
+        {
+            return FALSE;
+        }
+        cw->thumbnail = surface;
+    }
+    cairo_surface_flush (surface);
 
-    myDisplayErrorTrapPush (display_info);
-    render_format = XRenderFindStandardFormat (dpy, PictStandardARGB32);
-    tmpPicture = XRenderCreatePicture (dpy, tmpPixmap, render_format, 0, NULL);
-    XRenderFillRectangle (dpy, PictOpSrc, tmpPicture, &c, 0, 0, src_w, src_h);
-    XFixesSetPictureClipRegion (dpy, tmpPicture, 0, 0, None);
-    XRenderComposite (dpy, PictOpOver, srcPicture, None, tmpPicture,
-                      src_x, src_y, 0, 0, 0, 0, src_w, src_h);
-
-    XRenderSetPictureFilter (dpy, tmpPicture, FilterBest, NULL, 0);
-    XRenderSetPictureTransform (dpy, tmpPicture, &transform);
+    /* The offset skips the frame extents */
+    transform.matrix[0][0] = XDoubleToFixed (1.0);
+    transform.matrix[0][1] = XDoubleToFixed (0.0);
+    transform.matrix[0][2] = XDoubleToFixed (src_x * scale);
+    transform.matrix[1][0] = XDoubleToFixed (0.0);
+    transform.matrix[1][1] = XDoubleToFixed (1.0);
+    transform.matrix[1][2] = XDoubleToFixed (src_y * scale);
+    transform.matrix[2][0] = XDoubleToFixed (0.0);
+    transform.matrix[2][1] = XDoubleToFixed (0.0);
+    transform.matrix[2][2] = XDoubleToFixed (scale);
 
-    destPicture = XRenderCreatePicture (dpy, dstPixmap, render_format, 0, NULL);
-    XRenderComposite (dpy, PictOpOver, tmpPicture, None, destPicture,
+    myDisplayErrorTrapPush (display_info);
+    pa.subwindow_mode = IncludeInferiors;
+    srcPicture = XRenderCreatePicture (dpy, draw, src_format, CPSubwindowMode, &pa);
+    XRenderSetPictureFilter (dpy, srcPicture, FilterBest, NULL, 0);
+    XRenderSetPictureTransform (dpy, srcPicture, &transform);
+
+    destPicture = XRenderCreatePicture (dpy, cairo_xlib_surface_get_drawable (surface),
+                                        render_format, 0, NULL);
+    XRenderFillRectangle (dpy, PictOpSrc, destPicture, &c, 0, 0, dst_w, dst_h);
+    XRenderComposite (dpy, PictOpOver, srcPicture, None, destPicture,
                       0, 0, 0, 0, 0, 0, dst_w, dst_h);
 
-    XRenderFreePicture (dpy, tmpPicture);
+    XRenderFreePicture (dpy, srcPicture);
     XRenderFreePicture (dpy, destPicture);
-    XFreePixmap (dpy, tmpPixmap);
-
-    /* Update given size if requested */
-    if (width != NULL)
-    {
-        *width = dst_w;
-    }
-    if (height != NULL)
-    {
-        *height = dst_h;
-    }
     myDisplayErrorTrapPopIgnored (display_info);
 
-    return dstPixmap;
+    /* Drawn behind cairo's back */
+    cairo_surface_mark_dirty (surface);
+
+    return TRUE;
 }
+#endif /* HAVE_NAME_WINDOW_PIXMAP */
 
 #endif /* HAVE_COMPOSITOR */
 
@@ -4505,43 +7655,61 @@ compositorResizeWindow (DisplayInfo *display_info, Window id, int x, int y, int
 #endif /* HAVE_COMPOSITOR */
 }
 
-/* May return None if:
- * - The xserver does not support name window pixmaps
- * - The compositor is disabled at run time
- * - The compositor is disabled at build time
- * The pixmap may be an older copy of the last know good pixmap
- * if the window is unmapped.
+/*
+ * Returns a new reference on an Xlib surface holding a thumbnail of the
+ * window that fits in the given size, or NULL. The thumbnail stays on the
+ * server and is drawn from there, it is never read back. It is cached,
+ * and regenerated in place only once the window was damaged, and not
+ * more than once per THUMBNAIL_REFRESH_INTERVAL.
  */
-Pixmap
-compositorGetWindowPixmapAtSize (ScreenInfo *screen_info, Window id, guint *width, guint *height)
+cairo_surface_t *
+compositorGetWindowThumbnail (ScreenInfo *screen_info, Window id, guint width, guint height)
 {
 #ifdef HAVE_NAME_WINDOW_PIXMAP
 #ifdef HAVE_COMPOSITOR
     CWindow *cw;
+    gint64 now;
 
     TRACE ("window 0x%lx", id);
 
-    if (!screen_info->compositor_active)
+    g_return_val_if_fail (id != None, NULL);
+
+    if (!compositorIsActive (screen_info))
     {
-        return None;
+        return NULL;
     }
 
-    g_return_val_if_fail (id != None, None);
+    cw = find_cwindow_in_screen (screen_info, id);
+    if (!is_on_compositor (cw))
+    {
+        return NULL;
+    }
 
-    if (!compositorIsActive (screen_info))
+    now = g_get_monotonic_time ();
+    if ((cw->thumbnail) &&
+        (cw->thumbnail_width == width) && (cw->thumbnail_height == height) &&
+        (!cw->thumbnail_stale || (now - cw->thumbnail_time < THUMBNAIL_REFRESH_INTERVAL)))
     {
-        return None;
+        TRACE ("using cached thumbnail for window 0x%lx", id);
+        return cairo_surface_reference (cw->thumbnail);
     }
 
-    cw = find_cwindow_in_screen (screen_info, id);
-    if (is_on_compositor (cw))
+    if (!update_window_thumbnail (cw, width, height))
     {
-        return compositorScaleWindowPixmap (cw, width, height);
+        /* Unmapped windows without a saved pixmap keep their last thumbnail */
+        return (cw->thumbnail ? cairo_surface_reference (cw->thumbnail) : NULL);
     }
+
+    cw->thumbnail_width = width;
+    cw->thumbnail_height = height;
+    cw->thumbnail_stale = FALSE;
+    cw->thumbnail_time = now;
+
+    return cairo_surface_reference (cw->thumbnail);
 #endif /* HAVE_COMPOSITOR */
 #endif /* HAVE_NAME_WINDOW_PIXMAP */
 
-    return None;
+    return NULL;
 }
 
 void
@@ -4604,12 +7772,12 @@ compositorHandleEvent (DisplayInfo *display_info, XEvent *ev)
     {
         compositorHandleCursorNotify (display_info, (XFixesCursorNotifyEvent *) ev);
     }
-#ifdef HAVE_PRESENT_EXTENSION
+#if defined (HAVE_PRESENT_EXTENSION) || defined (HAVE_XI2)
     else if (ev->type == GenericEvent)
     {
         compositorHandleGenericEvent (display_info, (XGenericEvent *) ev);
     }
-#endif /* HAVE_PRESENT_EXTENSION */
+#endif /* HAVE_PRESENT_EXTENSION || HAVE_XI2 */
 
 #endif /* HAVE_COMPOSITOR */
 }
@@ -4637,18 +7805,32 @@ compositorZoomIn (ScreenInfo *screen_info, XfwmEventButton *event)
     if (!screen_info->zoomed)
     {
         screen_info->cursor_is_zoomed = screen_info->params->zoom_pointer;
+#ifdef HAVE_EPOXY
+        /* The cursor image is not drawn in the GL scene, keep the real one */
+        screen_info->cursor_is_zoomed &= !screen_info->use_glx_scene;
+#endif /* HAVE_EPOXY */
 
         if (screen_info->cursor_is_zoomed)
         {
             XFixesHideCursor (screen_info->display_info->dpy, screen_info->xroot);
             screen_info->cursorLocation.x = event->x_root - screen_info->cursorOffsetX;
             screen_info->cursorLocation.y = event->y_root - screen_info->cursorOffsetY;
-            update_cursor (screen_info);
+            update_cursor (screen_info, 0);
         }
     }
 
+    if (!screen_info->zoomed)
+    {
+#ifdef HAVE_XI2
+        /* Follow the pointer on raw motion events rather than polling it */
+        select_raw_motion (screen_info, TRUE);
+#endif /* HAVE_XI2 */
+    }
+
     screen_info->zoomed = TRUE;
-    if (!screen_info->zoom_timeout_id)
+    /* The zoomed view can only be composited */
+    check_scanout (screen_info);
+    if (!screen_info->zoom_timeout_id && !screen_info->zoom_raw_motion)
     {
         gint timeout_rate;
 
@@ -4656,7 +7838,7 @@ compositorZoomIn (ScreenInfo *screen_info, XfwmEventButton *event)
         screen_info->zoom_timeout_id = g_timeout_add ((1000 / timeout_rate /* per second */),
                                                       zoom_timeout_cb, screen_info);
     }
-    recenter_zoomed_area (screen_info, event->x_root, event->y_root);
+    recenter_zoomed_area (screen_info, event->x_root, event->y_root, FALSE);
 #endif /* HAVE_COMPOSITOR */
 }
 
@@ -4689,8 +7871,20 @@ compositorZoomOut (ScreenInfo *screen_info, XfwmEventButton *event)
             {
                 XFixesShowCursor (screen_info->display_info->dpy, screen_info->xroot);
             }
+#ifdef HAVE_XI2
+            if (screen_info->zoom_raw_motion)
+            {
+                select_raw_motion (screen_info, FALSE);
+            }
+#endif /* HAVE_XI2 */
+            /* Let the zoom callback release the zoom buffer */
+            if (!screen_info->zoom_timeout_id)
+            {
+                screen_info->zoom_timeout_id = g_idle_add (zoom_timeout_cb, screen_info);
+            }
+            check_scanout (screen_info);
         }
-        recenter_zoomed_area (screen_info, event->x_root, event->y_root);
+        recenter_zoomed_area (screen_info, event->x_root, event->y_root, FALSE);
     }
 #endif /* HAVE_COMPOSITOR */
 }
@@ -4810,6 +8004,7 @@ compositorManageScreen (ScreenInfo *screen_info)
     XRenderPictureAttributes pa;
     XRenderPictFormat *visual_format;
     gushort buffer;
+    gint i;
 
     g_return_val_if_fail (screen_info != NULL, FALSE);
     TRACE ("entering compositorManageScreen");
@@ -4887,7 +8082,18 @@ compositorManageScreen (ScreenInfo *screen_info)
     screen_info->gaussianSize = -1;
     screen_info->gaussianMap = make_gaussian_map(SHADOW_RADIUS);
     presum_gaussian (screen_info);
+    screen_info->shadow_cache = g_hash_table_new (shadow_entry_hash, shadow_entry_equal);
+    screen_info->shadow_lru = g_queue_new ();
+    screen_info->shadow_cache_bytes = 0;
+    for (i = 0; i < SHADOW_SLICE_LEVELS; i++)
+    {
+        screen_info->shadowSlices[i] = NULL;
+    }
     screen_info->cursorPicture = None;
+    screen_info->cursor_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+    screen_info->cursor_damaged = FALSE;
+    screen_info->cursorOutput.width = 0;
+    screen_info->cursorOutput.height = 0;
     /* Change following argb values to play with shadow colors */
     screen_info->blackPicture = solid_picture (screen_info,
                                                TRUE,
@@ -4896,15 +8102,34 @@ compositorManageScreen (ScreenInfo *screen_info)
                                                0.0, /* green */
                                                0.0  /* blue  */);
     screen_info->rootTile = None;
-    screen_info->allDamage = None;
-    screen_info->prevDamage = None;
+    screen_info->allDamage = NULL;
+    screen_info->windowDamage = XFixesCreateRegion (display_info->dpy, NULL, 0);
+    screen_info->damageParts = XFixesCreateRegion (display_info->dpy, NULL, 0);
+    screen_info->windowDamagePending = FALSE;
     screen_info->screenRegion = get_screen_region (screen_info);
-    screen_info->cwindows = NULL;
+    screen_info->cwindows = g_ptr_array_new ();
     screen_info->cwindow_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
+    screen_info->visible_windows = g_ptr_array_new ();
     screen_info->wins_unredirected = 0;
+    screen_info->wins_culled = 0;
+    screen_info->clipChanged = TRUE;
     screen_info->compositor_timeout_id = 0;
+    screen_info->vblank_time = 0;
+    screen_info->vblank_msc = 0;
+    screen_info->refresh_interval = DEFAULT_REFRESH_INTERVAL;
+    memset (&screen_info->stats, 0, sizeof (frame_stats));
+    screen_info->stats.scanout_mode_start = g_get_monotonic_time ();
+    screen_info->scanout_window = None;
+    screen_info->scanout_candidate = None;
+    screen_info->scanout_retry_time = 0;
+    screen_info->scanout_timeout_id = 0;
     screen_info->zoomed = FALSE;
     screen_info->zoom_timeout_id = 0;
+    screen_info->zoom_raw_motion = FALSE;
+    screen_info->zoom_offset_x = 0;
+    screen_info->zoom_offset_y = 0;
+    screen_info->zoom_shift_x = 0;
+    screen_info->zoom_shift_y = 0;
     screen_info->damages_pending = FALSE;
     screen_info->current_buffer = 0;
     memset(screen_info->transform.matrix, 0, 9);
@@ -4917,6 +8142,7 @@ compositorManageScreen (ScreenInfo *screen_info)
     {
         screen_info->rootPixmap[buffer] = None;
         screen_info->rootBuffer[buffer] = None;
+        screen_info->bufferDamage[buffer] = NULL;
 #ifdef HAVE_EPOXY
         screen_info->glx_drawable[buffer] = None;
 #ifdef HAVE_XSYNC
@@ -4929,7 +8155,10 @@ compositorManageScreen (ScreenInfo *screen_info)
 
 #ifdef HAVE_EPOXY
     screen_info->use_glx = (screen_info->vblank_mode == VBLANK_AUTO ||
-                            screen_info->vblank_mode == VBLANK_GLX);
+                            screen_info->vblank_mode == VBLANK_GLX ||
+                            screen_info->vblank_mode == VBLANK_GLX_SCENE);
+    screen_info->use_glx_scene = FALSE;
+    screen_info->glx_background_valid = FALSE;
 #ifdef HAVE_XSYNC
     screen_info->use_glx &= display_info->have_xsync;
 #endif /* HAVE_XSYNC */
@@ -4942,7 +8171,11 @@ compositorManageScreen (ScreenInfo *screen_info)
         screen_info->rootTexture = None;
         screen_info->texture_filter = GL_LINEAR;
         screen_info->gl_sync = 0;
+        memset (screen_info->glx_damage, 0, sizeof (screen_info->glx_damage));
         screen_info->use_glx = init_glx (screen_info);
+        screen_info->use_glx_scene = screen_info->use_glx &&
+                                     (screen_info->vblank_mode == VBLANK_GLX_SCENE) &&
+                                     choose_glx_argb_settings (screen_info);
     }
 #else /* HAVE_EPOXY */
     screen_info->use_glx = FALSE;
@@ -4957,8 +8190,13 @@ compositorManageScreen (ScreenInfo *screen_info)
                                 screen_info->vblank_mode == VBLANK_XPRESENT);
     if (screen_info->use_present)
     {
-        screen_info->use_n_buffers = N_BUFFERS;
-        screen_info->present_pending = FALSE;
+        /* Start double buffered, adapted later on measured latency */
+        screen_info->use_n_buffers = MIN (2, N_BUFFERS);
+        screen_info->present_pending = 0;
+        screen_info->adapt_frames = 0;
+        screen_info->adapt_latency = 0;
+        screen_info->adapt_paint_time = 0;
+        screen_info->adapt_area = 0;
         XPresentSelectInput (display_info->dpy,
                              screen_info->output,
                              PresentCompleteNotifyMask);
@@ -4967,10 +8205,19 @@ compositorManageScreen (ScreenInfo *screen_info)
     screen_info->use_present = FALSE;
 #endif /* HAVE_PRESENT_EXTENSION */
 
+    /* Refined from the vblank timestamps as they come */
+    screen_info->refresh_interval = get_refresh_interval (screen_info);
+
     if (screen_info->use_present)
     {
         g_info ("Compositor using XPresent for vsync");
     }
+#ifdef HAVE_EPOXY
+    else if (screen_info->use_glx_scene)
+    {
+        g_info ("Compositor using GLX for vsync and window rendering");
+    }
+#endif /* HAVE_EPOXY */
     else if (screen_info->use_glx)
     {
         g_info ("Compositor using GLX for vsync");
@@ -4995,8 +8242,8 @@ compositorUnmanageScreen (ScreenInfo *screen_info)
 {
 #ifdef HAVE_COMPOSITOR
     DisplayInfo *display_info;
-    GList *list;
     gushort buffer;
+    guint i;
 
     g_return_if_fail (screen_info != NULL);
     TRACE ("entering compositorUnmanageScreen");
@@ -5015,19 +8262,25 @@ compositorUnmanageScreen (ScreenInfo *screen_info)
     screen_info->compositor_active = FALSE;
 
     remove_timeouts (screen_info);
+    cancel_scanout_check (screen_info);
 
     myDisplayErrorTrapPush (display_info);
 
-    for (list = screen_info->cwindows; list; list = g_list_next (list))
+    for (i = 0; i < screen_info->cwindows->len; i++)
     {
-        CWindow *cw2 = (CWindow *) list->data;
+        CWindow *cw2 = (CWindow *) g_ptr_array_index (screen_info->cwindows, i);
         free_win_data (cw2, TRUE);
     }
 
     g_hash_table_destroy(screen_info->cwindow_hash);
     screen_info->cwindow_hash = NULL;
-    g_list_free (screen_info->cwindows);
+    g_ptr_array_free (screen_info->cwindows, TRUE);
     screen_info->cwindows = NULL;
+    g_ptr_array_free (screen_info->visible_windows, TRUE);
+    screen_info->visible_windows = NULL;
+
+    shadow_cache_destroy (screen_info);
+    free_shadow_slices (screen_info);
 
 #ifdef HAVE_EPOXY
     if (screen_info->use_glx)
@@ -5059,20 +8312,32 @@ compositorUnmanageScreen (ScreenInfo *screen_info)
 
     if (screen_info->allDamage)
     {
-        XFixesDestroyRegion (display_info->dpy, screen_info->allDamage);
-        screen_info->allDamage = None;
+        cairo_region_destroy (screen_info->allDamage);
+        screen_info->allDamage = NULL;
+    }
+
+    if (screen_info->windowDamage)
+    {
+        XFixesDestroyRegion (display_info->dpy, screen_info->windowDamage);
+        XFixesDestroyRegion (display_info->dpy, screen_info->damageParts);
+        screen_info->windowDamage = None;
+        screen_info->damageParts = None;
     }
+    screen_info->windowDamagePending = FALSE;
 
-    if (screen_info->prevDamage)
+    for (buffer = 0; buffer < N_BUFFERS; buffer++)
     {
-        XFixesDestroyRegion (display_info->dpy, screen_info->prevDamage);
-        screen_info->prevDamage = None;
+        if (screen_info->bufferDamage[buffer])
+        {
+            cairo_region_destroy (screen_info->bufferDamage[buffer]);
+            screen_info->bufferDamage[buffer] = NULL;
+        }
     }
 
     if (screen_info->screenRegion)
     {
-        XFixesDestroyRegion (display_info->dpy, screen_info->screenRegion);
-        screen_info->screenRegion = None;
+        cairo_region_destroy (screen_info->screenRegion);
+        screen_info->screenRegion = NULL;
     }
 
     if (screen_info->zoomBuffer)
@@ -5092,10 +8357,11 @@ compositorUnmanageScreen (ScreenInfo *screen_info)
         XRenderFreePicture (display_info->dpy, screen_info->blackPicture);
         screen_info->blackPicture = None;
     }
-    if (screen_info->cursorPicture)
+    if (screen_info->cursor_cache)
     {
-        XRenderFreePicture (display_info->dpy, screen_info->cursorPicture);
-        screen_info->cursorPicture = None;
+        cursor_cache_flush (screen_info);
+        g_hash_table_destroy (screen_info->cursor_cache);
+        screen_info->cursor_cache = NULL;
     }
 
     if (screen_info->shadowTop)
@@ -5110,6 +8376,12 @@ compositorUnmanageScreen (ScreenInfo *screen_info)
         screen_info->shadowCorner = NULL;
     }
 
+    if (screen_info->gaussianSum)
+    {
+        g_free (screen_info->gaussianSum);
+        screen_info->gaussianSum = NULL;
+    }
+
     if (screen_info->gaussianMap)
     {
         g_free (screen_info->gaussianMap);
@@ -5274,9 +8546,12 @@ compositorUpdateScreenSize (ScreenInfo *screen_info)
 
     if (screen_info->screenRegion)
     {
-        XFixesDestroyRegion (display_info->dpy, screen_info->screenRegion);
-        screen_info->screenRegion = None;
+        cairo_region_destroy (screen_info->screenRegion);
+        screen_info->screenRegion = NULL;
     }
+    screen_info->clipChanged = TRUE;
+    /* The output mode may have changed along */
+    screen_info->refresh_interval = get_refresh_interval (screen_info);
 
     damage_screen (screen_info);
     myDisplayErrorTrapPopIgnored (display_info);
@@ -5311,7 +8586,7 @@ compositorRebuildScreen (ScreenInfo *screen_info)
 {
 #ifdef HAVE_COMPOSITOR
     DisplayInfo *display_info;
-    GList *list;
+    guint i;
 
     g_return_if_fail (screen_info != NULL);
     TRACE ("entering");
@@ -5322,12 +8597,15 @@ compositorRebuildScreen (ScreenInfo *screen_info)
         return;
     }
 
-    for (list = screen_info->cwindows; list; list = g_list_next (list))
+    for (i = 0; i < screen_info->cwindows->len; i++)
     {
-        CWindow *cw2 = (CWindow *) list->data;
+        CWindow *cw2 = (CWindow *) g_ptr_array_index (screen_info->cwindows, i);
         free_win_data (cw2, FALSE);
         init_opacity (cw2);
     }
+    /* Shadow parameters may have changed, drop the cached shadows */
+    shadow_cache_flush (screen_info);
+    free_shadow_slices (screen_info);
     damage_screen (screen_info);
 #endif /* HAVE_COMPOSITOR */
 }
@@ -5360,6 +8638,143 @@ compositorTestServer (DisplayInfo *display_info)
 #endif /* HAVE_COMPOSITOR */
 }
 
+#ifdef HAVE_COMPOSITOR
+static gint
+compare_damage_count (gconstpointer a, gconstpointer b)
+{
+    return (*(CWindow **) b)->damage_count - (*(CWindow **) a)->damage_count;
+}
+
+static void
+dump_screen_stats (ScreenInfo *screen_info)
+{
+    DisplayInfo *display_info;
+    frame_stats *stats;
+    GPtrArray *sorted;
+    long data[19 + FRAME_STATS_BUCKETS];
+    gint i, n;
+
+    display_info = screen_info->display_info;
+    stats = &screen_info->stats;
+
+    g_print ("Compositor statistics for screen %i\n", screen_info->screen);
+    g_print ("    frames: %" G_GUINT64_FORMAT ", average %" G_GUINT64_FORMAT "μs, max %" G_GUINT64_FORMAT "μs\n",
+             stats->frames, stats->frames ? stats->frame_time / stats->frames : 0,
+             stats->frame_time_max);
+    g_print ("    frame time histogram:");
+    for (i = 0; i < FRAME_STATS_BUCKETS; i++)
+    {
+        g_print (" %s%ims: %" G_GUINT64_FORMAT, (i < FRAME_STATS_BUCKETS - 1) ? "<" : ">=",
+                 (i < FRAME_STATS_BUCKETS - 1) ? 1 << i : 1 << (i - 1),
+                 stats->frame_time_histogram[i]);
+    }
+    g_print ("\n");
+    g_print ("    CPU time: %" G_GUINT64_FORMAT "μs, average %" G_GUINT64_FORMAT "μs per frame\n",
+             stats->cpu_time, stats->frames ? stats->cpu_time / stats->frames : 0);
+    g_print ("    damaged area: %" G_GUINT64_FORMAT " pixels, average %" G_GUINT64_FORMAT " per frame\n",
+             stats->damaged_area, stats->frames ? stats->damaged_area / stats->frames : 0);
+    g_print ("    windows painted: %" G_GUINT64_FORMAT ", skipped: %" G_GUINT64_FORMAT "\n",
+             stats->windows_painted, stats->windows_skipped);
+    g_print ("    occluded damages dropped: %" G_GUINT64_FORMAT "\n", stats->damage_culled);
+    g_print ("    shadows built: %" G_GUINT64_FORMAT ", in %" G_GUINT64_FORMAT "μs\n",
+             stats->shadows_built, stats->shadow_time);
+    g_print ("    retries: %" G_GUINT64_FORMAT ", throttled: %" G_GUINT64_FORMAT "\n",
+             stats->retries, stats->throttled);
+    g_print ("    present wait: %" G_GUINT64_FORMAT "μs, GL wait: %" G_GUINT64_FORMAT "μs\n",
+             stats->present_wait, stats->gl_wait);
+    g_print ("    buffers in use: %i\n", screen_info->use_n_buffers);
+    g_print ("    X requests: %" G_GUINT64_FORMAT ", average %" G_GUINT64_FORMAT " per frame, "
+             "clip changes saved: %" G_GUINT64_FORMAT "\n",
+             stats->requests, stats->frames ? stats->requests / stats->frames : 0,
+             stats->clips_reused);
+    account_scanout_time (screen_info);
+    g_print ("    direct scanout: %" G_GUINT64_FORMAT "ms, composited: %" G_GUINT64_FORMAT "ms, "
+             "entered %" G_GUINT64_FORMAT " times, left %" G_GUINT64_FORMAT " times\n",
+             stats->scanout_time / 1000, stats->composited_time / 1000,
+             stats->scanout_entered, stats->scanout_left);
+
+    g_print ("    most damaged windows:\n");
+    sorted = g_ptr_array_sized_new (screen_info->cwindows->len);
+    for (i = 0; i < (gint) screen_info->cwindows->len; i++)
+    {
+        g_ptr_array_add (sorted, g_ptr_array_index (screen_info->cwindows, i));
+    }
+    g_ptr_array_sort (sorted, compare_damage_count);
+    for (n = 0; n < (gint) sorted->len && n < 10; n++)
+    {
+        CWindow *cw = (CWindow *) g_ptr_array_index (sorted, n);
+        if (cw->damage_count == 0)
+        {
+            break;
+        }
+        g_print ("        0x%lx - %u damages - %s\n", cw->id, cw->damage_count,
+                 WIN_HAS_CLIENT(cw) ? cw->c->name : "(unmanaged)");
+    }
+    g_ptr_array_free (sorted, TRUE);
+
+    /*
+     * Also publish the counters on the root window, frame times are in μs:
+     * frames, total frame time, max frame time, damaged area, windows
+     * painted and skipped, shadows built, retries, throttled, present and
+     * GL wait, refresh interval, repaint lead time, histogram size,
+     * the histogram itself, then the time spent in direct scanout and
+     * composited, in ms, the CPU time spent painting, in μs, the
+     * number of X requests sent while painting and the time spent
+     * building shadows, in μs.
+     */
+    data[0] = (long) stats->frames;
+    data[1] = (long) stats->frame_time;
+    data[2] = (long) stats->frame_time_max;
+    data[3] = (long) stats->damaged_area;
+    data[4] = (long) stats->windows_painted;
+    data[5] = (long) stats->windows_skipped;
+    data[6] = (long) stats->shadows_built;
+    data[7] = (long) stats->retries;
+    data[8] = (long) stats->throttled;
+    data[9] = (long) stats->present_wait;
+    data[10] = (long) stats->gl_wait;
+    data[11] = (long) screen_info->refresh_interval;
+    data[12] = (long) screen_info->params->repaint_lead_time;
+    data[13] = FRAME_STATS_BUCKETS;
+    for (i = 0; i < FRAME_STATS_BUCKETS; i++)
+    {
+        data[14 + i] = (long) stats->frame_time_histogram[i];
+    }
+    data[14 + FRAME_STATS_BUCKETS] = (long) (stats->scanout_time / 1000);
+    data[15 + FRAME_STATS_BUCKETS] = (long) (stats->composited_time / 1000);
+    data[16 + FRAME_STATS_BUCKETS] = (long) stats->cpu_time;
+    data[17 + FRAME_STATS_BUCKETS] = (long) stats->requests;
+    data[18 + FRAME_STATS_BUCKETS] = (long) stats->shadow_time;
+
+    myDisplayErrorTrapPush (display_info);
+    XChangeProperty (display_info->dpy, screen_info->xroot,
+                     display_info->atoms[XFWM4_COMPOSITOR_STATS], XA_CARDINAL,
+                     32, PropModeReplace, (unsigned char *) data, G_N_ELEMENTS (data));
+    myDisplayErrorTrapPopIgnored (display_info);
+}
+#endif /* HAVE_COMPOSITOR */
+
+void
+compositorDumpStats (DisplayInfo *display_info)
+{
+#ifdef HAVE_COMPOSITOR
+    ScreenInfo *screen_info;
+    GSList *list;
+
+    g_return_if_fail (display_info != NULL);
+    TRACE ("entering");
+
+    for (list = display_info->screens; list; list = g_slist_next (list))
+    {
+        screen_info = (ScreenInfo *) list->data;
+        if (screen_info->compositor_active)
+        {
+            dump_screen_stats (screen_info);
+        }
+    }
+#endif /* HAVE_COMPOSITOR */
+}
+
 vblankMode
 compositorParseVblankMode (const gchar *vblank_setting)
 {
@@ -5375,6 +8790,10 @@ compositorParseVblankMode (const gchar *vblank_setting)
     {
         return VBLANK_GLX;
     }
+    else if (g_ascii_strcasecmp (vblank_setting, "glx-scene") == 0)
+    {
+        return VBLANK_GLX_SCENE;
+    }
     else
 #endif /* HAVE_EPOXY */
     if (g_ascii_strcasecmp (vblank_setting, "off") == 0)
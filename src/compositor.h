@@ -52,10 +52,10 @@ void                     compositorResizeWindow                 (DisplayInfo *,
                                                                  int,
                                                                  int,
                                                                  int);
-Pixmap                   compositorGetWindowPixmapAtSize        (ScreenInfo *,
+cairo_surface_t         *compositorGetWindowThumbnail           (ScreenInfo *,
                                                                  Window,
-                                                                 guint *,
-                                                                 guint *);
+                                                                 guint,
+                                                                 guint);
 void                     compositorHandleEvent                  (DisplayInfo *,
                                                                  XEvent *);
 void                     compositorZoomIn                       (ScreenInfo *,
@@ -78,6 +78,7 @@ void                     compositorWindowSetOpacity             (DisplayInfo *,
                                                                  guint32);
 void                     compositorRebuildScreen                (ScreenInfo *);
 gboolean                 compositorTestServer                   (DisplayInfo *);
+void                     compositorDumpStats                    (DisplayInfo *);
 
 vblankMode               compositorParseVblankMode              (const gchar *);
 void                     compositorSetVblankMode                (ScreenInfo *,
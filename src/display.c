@@ -165,6 +165,7 @@ myDisplayInitAtoms (DisplayInfo *display_info)
         "WM_TRANSIENT_FOR",
         "WM_WINDOW_ROLE",
         "XFWM4_COMPOSITING_MANAGER",
+        "_XFWM4_COMPOSITOR_STATS",
         "XFWM4_TIMESTAMP_PROP",
         "_XROOTPMAP_ID",
         "_XSETROOT_ID",
@@ -212,6 +213,7 @@ myDisplayInit (GdkDisplay *gdisplay)
     display->session = NULL;
     display->quit = FALSE;
     display->reload = FALSE;
+    display->dump_stats = FALSE;
 
     /* Initialize internal atoms */
     if (!myDisplayInitAtoms (display))
@@ -336,6 +338,8 @@ myDisplayInit (GdkDisplay *gdisplay)
     display->xfilter = NULL;
     display->screens = NULL;
     display->clients = NULL;
+    display->client_windows = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                     NULL, (GDestroyNotify) g_slist_free);
     display->xgrabcount = 0;
     display->double_click_time = 250;
     display->double_click_distance = 5;
@@ -379,6 +383,9 @@ myDisplayClose (DisplayInfo *display)
     g_slist_free (display->clients);
     display->clients = NULL;
 
+    g_hash_table_destroy (display->client_windows);
+    display->client_windows = NULL;
+
     g_slist_free (display->screens);
     display->screens = NULL;
 
@@ -533,6 +540,57 @@ myDisplayUngrabServer (DisplayInfo *display)
     DBG ("grabs : %i", display->xgrabcount);
 }
 
+void
+myDisplayAddClientWindow (DisplayInfo *display, Window w, Client *c)
+{
+    GSList *list;
+
+    g_return_if_fail (c != NULL);
+    g_return_if_fail (display != NULL);
+
+    if (w == None)
+    {
+        return;
+    }
+
+    list = g_hash_table_lookup (display->client_windows, (gpointer) w);
+    if (!g_slist_find (list, c))
+    {
+        /* Steal the list first, the table would free it on replace */
+        g_hash_table_steal (display->client_windows, (gpointer) w);
+        list = g_slist_prepend (list, c);
+        g_hash_table_insert (display->client_windows, (gpointer) w, list);
+    }
+}
+
+void
+myDisplayRemoveClientWindow (DisplayInfo *display, Window w, Client *c)
+{
+    GSList *list;
+
+    g_return_if_fail (c != NULL);
+    g_return_if_fail (display != NULL);
+
+    if (w == None)
+    {
+        return;
+    }
+
+    list = g_hash_table_lookup (display->client_windows, (gpointer) w);
+    if (!g_slist_find (list, c))
+    {
+        return;
+    }
+
+    /* Other clients sharing the window keep their entry */
+    g_hash_table_steal (display->client_windows, (gpointer) w);
+    list = g_slist_remove (list, c);
+    if (list)
+    {
+        g_hash_table_insert (display->client_windows, (gpointer) w, list);
+    }
+}
+
 void
 myDisplayAddClient (DisplayInfo *display, Client *c)
 {
@@ -540,28 +598,44 @@ myDisplayAddClient (DisplayInfo *display, Client *c)
     g_return_if_fail (display != NULL);
 
     display->clients = g_slist_append (display->clients, c);
+
+    myDisplayAddClientWindow (display, c->window, c);
+    myDisplayAddClientWindow (display, c->frame, c);
+    myDisplayAddClientWindow (display, c->user_time_win, c);
 }
 
 void
 myDisplayRemoveClient (DisplayInfo *display, Client *c)
 {
+    int b;
+
     g_return_if_fail (c != None);
     g_return_if_fail (display != NULL);
 
     display->clients = g_slist_remove (display->clients, c);
+
+    myDisplayRemoveClientWindow (display, c->window, c);
+    myDisplayRemoveClientWindow (display, c->frame, c);
+    myDisplayRemoveClientWindow (display, c->user_time_win, c);
+    for (b = 0; b < BUTTON_COUNT; b++)
+    {
+        myDisplayRemoveClientWindow (display, MYWINDOW_XWINDOW (c->buttons[b]), c);
+    }
 }
 
 Client *
 myDisplayGetClientFromWindow (DisplayInfo *display, Window w, unsigned short mode)
 {
     GSList *list;
+    Client *c;
 
     g_return_val_if_fail (w != None, NULL);
     g_return_val_if_fail (display != NULL, NULL);
 
-    for (list = display->clients; list; list = g_slist_next (list))
+    list = g_hash_table_lookup (display->client_windows, (gpointer) w);
+    for (; list; list = g_slist_next (list))
     {
-        Client *c = (Client *) list->data;
+        c = (Client *) list->data;
         if (clientGetFromWindow (c, w, mode))
         {
             return (c);
@@ -269,6 +269,7 @@ enum
     WM_TRANSIENT_FOR,
     WM_WINDOW_ROLE,
     XFWM4_COMPOSITING_MANAGER,
+    XFWM4_COMPOSITOR_STATS,
     XFWM4_TIMESTAMP_PROP,
     XROOTPMAP,
     XSETROOT,
@@ -291,6 +292,7 @@ struct _DisplayInfo
     XfceSMClient *session;
     gboolean quit;
     gboolean reload;
+    gboolean dump_stats;
 
     Window timestamp_win;
     Cursor busy_cursor;
@@ -304,6 +306,10 @@ struct _DisplayInfo
     XfwmDevices *devices;
     GSList *screens;
     GSList *clients;
+    /* Clients owning each of the windows searched by
+       myDisplayGetClientFromWindow (), as a GSList per window
+       since clients may share a window (e.g. a user time window) */
+    GHashTable *client_windows;
 
     gboolean have_shape;
     gboolean have_render;
@@ -388,6 +394,12 @@ void                     myDisplayAddClient                     (DisplayInfo *,
                                                                  Client *);
 void                     myDisplayRemoveClient                  (DisplayInfo *,
                                                                  Client *);
+void                     myDisplayAddClientWindow               (DisplayInfo *,
+                                                                 Window,
+                                                                 Client *);
+void                     myDisplayRemoveClientWindow            (DisplayInfo *,
+                                                                 Window,
+                                                                 Client *);
 Client                  *myDisplayGetClientFromWindow           (DisplayInfo *,
                                                                  Window,
                                                                  unsigned short);
@@ -76,6 +76,8 @@
                                  (win == MYWINDOW_XWINDOW(c->buttons[MAXIMIZE_BUTTON])) || \
                                  (win == MYWINDOW_XWINDOW(c->buttons[SHADE_BUTTON])) || \
                                  (win == MYWINDOW_XWINDOW(c->buttons[STICK_BUTTON])))
+/* Parts of drawn frames have no window, see XFWM_FLAG_DRAWN_FRAME */
+#define WIN_IS_PART(win, part)  ((win != None) && (win == MYWINDOW_XWINDOW(part)))
 
 #define DOUBLE_CLICK_GRAB       (ButtonMotionMask | \
                                  PointerMotionMask | \
@@ -287,7 +289,17 @@ toggle_show_desktop (ScreenInfo *screen_info)
 static eventFilterStatus
 handleMotionNotify (DisplayInfo *display_info, XfwmEventMotion *event)
 {
+    Client *c;
+
     TRACE ("entering");
+
+    c = myDisplayGetClientFromWindow (display_info, event->meta.window, SEARCH_FRAME);
+    if ((c) && FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME))
+    {
+        /* No subwindow carries the resize cursors of drawn frames */
+        frameUpdateCursor (c, event->x, event->y);
+    }
+
     return EVENT_FILTER_REMOVE;
 }
 
@@ -957,7 +969,20 @@ handleButtonPress (DisplayInfo *display_info, XfwmEventButton *event)
                 clientButtonPress (c, win, event);
             }
         }
-        else if (win == MYWINDOW_XWINDOW (c->title))
+        else if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME) &&
+                 (event->meta.window == c->frame) && (win == None))
+        {
+            part = frameGetPartAt (c, event->x, event->y);
+            if (part == FRAME_PART_TITLE)
+            {
+                titleButton (c, state, event);
+            }
+            else if (part != NO_HANDLE)
+            {
+                edgeButton (c, part, event);
+            }
+        }
+        else if (WIN_IS_PART (win, c->title))
         {
             titleButton (c, state, event);
         }
@@ -995,35 +1020,35 @@ handleButtonPress (DisplayInfo *display_info, XfwmEventButton *event)
                 }
             }
         }
-        else if (win == MYWINDOW_XWINDOW (c->corners[CORNER_TOP_LEFT]))
+        else if (WIN_IS_PART (win, c->corners[CORNER_TOP_LEFT]))
         {
             edgeButton (c, CORNER_TOP_LEFT, event);
         }
-        else if (win == MYWINDOW_XWINDOW (c->corners[CORNER_TOP_RIGHT]))
+        else if (WIN_IS_PART (win, c->corners[CORNER_TOP_RIGHT]))
         {
             edgeButton (c, CORNER_TOP_RIGHT, event);
         }
-        else if (win == MYWINDOW_XWINDOW (c->corners[CORNER_BOTTOM_LEFT]))
+        else if (WIN_IS_PART (win, c->corners[CORNER_BOTTOM_LEFT]))
         {
             edgeButton (c, CORNER_BOTTOM_LEFT, event);
         }
-        else if (win == MYWINDOW_XWINDOW (c->corners[CORNER_BOTTOM_RIGHT]))
+        else if (WIN_IS_PART (win, c->corners[CORNER_BOTTOM_RIGHT]))
         {
             edgeButton (c, CORNER_BOTTOM_RIGHT, event);
         }
-        else if (win == MYWINDOW_XWINDOW (c->sides[SIDE_BOTTOM]))
+        else if (WIN_IS_PART (win, c->sides[SIDE_BOTTOM]))
         {
             edgeButton (c, CORNER_COUNT + SIDE_BOTTOM, event);
         }
-        else if (win == MYWINDOW_XWINDOW (c->sides[SIDE_TOP]))
+        else if (WIN_IS_PART (win, c->sides[SIDE_TOP]))
         {
             edgeButton (c, CORNER_COUNT + SIDE_TOP, event);
         }
-        else if (win == MYWINDOW_XWINDOW (c->sides[SIDE_LEFT]))
+        else if (WIN_IS_PART (win, c->sides[SIDE_LEFT]))
         {
             edgeButton (c, CORNER_COUNT + SIDE_LEFT, event);
         }
-        else if (win == MYWINDOW_XWINDOW (c->sides[SIDE_RIGHT]))
+        else if (WIN_IS_PART (win, c->sides[SIDE_RIGHT]))
         {
             edgeButton (c, CORNER_COUNT + SIDE_RIGHT, event);
         }
@@ -1471,6 +1496,11 @@ handleLeaveNotify (DisplayInfo *display_info, XfwmEventCrossing *event)
                                       SEARCH_FRAME | SEARCH_BUTTON);
     if (c)
     {
+        if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME) && (event->meta.window == c->frame))
+        {
+            /* Restore the default cursor, no part is at (-1, -1) */
+            frameUpdateCursor (c, -1, -1);
+        }
         for (b = 0; b < BUTTON_COUNT; b++)
         {
             if ((c->button_status[b] == BUTTON_STATE_PRELIGHT) || (c->button_status[b] == BUTTON_STATE_PRESSED))
@@ -2155,6 +2185,23 @@ handleColormapNotify (DisplayInfo *display_info, XColormapEvent * ev)
     return EVENT_FILTER_PASS;
 }
 
+static eventFilterStatus
+handleExpose (DisplayInfo *display_info, XExposeEvent * ev)
+{
+    Client *c;
+
+    TRACE ("window 0x%lx", ev->window);
+
+    c = myDisplayGetClientFromWindow (display_info, ev->window, SEARCH_FRAME);
+    if ((c) && (ev->window == c->frame) && FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME))
+    {
+        frameExpose (c, ev);
+        return EVENT_FILTER_REMOVE;
+    }
+
+    return EVENT_FILTER_PASS;
+}
+
 static eventFilterStatus
 handleReparentNotify (DisplayInfo *display_info, XReparentEvent * ev)
 {
@@ -2270,6 +2317,9 @@ handleEvent (DisplayInfo *display_info, XfwmEvent *event)
                 case ReparentNotify:
                     status = handleReparentNotify (display_info, (XReparentEvent *) event->meta.xevent);
                     break;
+                case Expose:
+                    status = handleExpose (display_info, (XExposeEvent *) event->meta.xevent);
+                    break;
                 default:
                     if ((display_info->have_shape) &&
                             (event->meta.xevent->type == display_info->shape_event_base))
@@ -2289,6 +2339,11 @@ handleEvent (DisplayInfo *display_info, XfwmEvent *event)
     }
     if (!gdk_events_pending () && !XPending (display_info->dpy))
     {
+        if (display_info->dump_stats)
+        {
+            compositorDumpStats (display_info);
+            display_info->dump_stats = FALSE;
+        }
         if (display_info->reload)
         {
             reloadSettings (display_info, UPDATE_ALL);
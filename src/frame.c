@@ -39,11 +39,40 @@
 #include "frame.h"
 #include "compositor.h"
 
-typedef struct
+#ifndef FRAME_CACHE_MAX_BYTES
+#define FRAME_CACHE_MAX_BYTES   (4 * 1024 * 1024)
+#endif /* FRAME_CACHE_MAX_BYTES */
+
+/* Parts of a drawn frame, bottom to top as stacked by clientFrame() */
+static const int frame_parts[] =
+{
+    CORNER_COUNT + SIDE_LEFT,
+    CORNER_COUNT + SIDE_RIGHT,
+    CORNER_COUNT + SIDE_BOTTOM,
+    CORNER_BOTTOM_LEFT,
+    CORNER_BOTTOM_RIGHT,
+    CORNER_TOP_LEFT,
+    CORNER_TOP_RIGHT,
+    FRAME_PART_TITLE,
+    CORNER_COUNT + SIDE_TOP
+};
+
+struct _FrameSideEntry
 {
-    xfwmPixmap pm_title;
-    xfwmPixmap pm_sides[SIDE_COUNT];
-} FramePixmap;
+    /* Key */
+    gint side;
+    gint state;
+    gint width;
+    gint height;
+
+    xfwmPixmap pixmap;
+
+    guint ref_count;
+    /* Link in the screen LRU queue, only set when unused */
+    GList *lru_link;
+    /* Dropped from the cache by a theme change, freed once released */
+    gboolean orphan;
+};
 
 static int
 frameDecorationBorderTop (ScreenInfo *screen_info)
@@ -113,6 +142,246 @@ frameButtonOffset (Client *c)
     return c->screen_info->params->button_offset;
 }
 
+/*
+ * Make pm hold width × height, keeping the pixmap when it is large enough
+ * and growing it by half otherwise, so that resizing a window does not
+ * reallocate it at every step. pm->width and pm->height give the part in
+ * use, the mask is cleared beyond so it does not add to the frame shape.
+ */
+static void
+frameReservePixmap (ScreenInfo *screen_info, xfwmPixmap * pm, gint size[2], gint width, gint height)
+{
+    DisplayInfo *display_info;
+    XGCValues gv;
+    GC gc;
+    gboolean clear_mask;
+
+    if ((width < 1) || (height < 1))
+    {
+        /* Keep the pixmap for later, but nothing of it is in use */
+        pm->width = 0;
+        pm->height = 0;
+        return;
+    }
+
+    if (xfwmPixmapNone (pm) || (size[0] < width) || (size[1] < height))
+    {
+        if (size[0] < width)
+        {
+            size[0] = MAX (width, size[0] + size[0] / 2);
+        }
+        if (size[1] < height)
+        {
+            size[1] = MAX (height, size[1] + size[1] / 2);
+        }
+        xfwmPixmapFree (pm);
+        xfwmPixmapCreate (screen_info, pm, size[0], size[1]);
+        clear_mask = TRUE;
+    }
+    else
+    {
+        clear_mask = ((pm->width < 1) || (width < pm->width) || (height < pm->height));
+    }
+    pm->width = width;
+    pm->height = height;
+
+    if (clear_mask && ((width < size[0]) || (height < size[1])))
+    {
+        display_info = screen_info->display_info;
+        gv.foreground = 0;
+        gc = XCreateGC (display_info->dpy, pm->mask, GCForeground, &gv);
+        XFillRectangle (display_info->dpy, pm->mask, gc, width, 0, size[0] - width, size[1]);
+        XFillRectangle (display_info->dpy, pm->mask, gc, 0, height, width, size[1] - height);
+        XFreeGC (display_info->dpy, gc);
+    }
+}
+
+static guint
+side_entry_hash (gconstpointer key)
+{
+    const FrameSideEntry *entry = (const FrameSideEntry *) key;
+
+    return (guint) ((entry->width << 20) ^ (entry->height << 4) ^ (entry->side << 1) ^ entry->state);
+}
+
+static gboolean
+side_entry_equal (gconstpointer a, gconstpointer b)
+{
+    const FrameSideEntry *entry_a = (const FrameSideEntry *) a;
+    const FrameSideEntry *entry_b = (const FrameSideEntry *) b;
+
+    return ((entry_a->side == entry_b->side) &&
+            (entry_a->state == entry_b->state) &&
+            (entry_a->width == entry_b->width) &&
+            (entry_a->height == entry_b->height));
+}
+
+static gsize
+side_entry_bytes (FrameSideEntry *entry)
+{
+    /* Pixmap at screen depth plus its mask, counted as 4 bytes per pixel */
+    return (gsize) entry->width * (gsize) entry->height * 4;
+}
+
+static void
+side_entry_free (FrameSideEntry *entry)
+{
+    xfwmPixmapFree (&entry->pixmap);
+    g_slice_free (FrameSideEntry, entry);
+}
+
+static void
+side_cache_trim (ScreenInfo *screen_info, gsize max_bytes)
+{
+    FrameSideEntry *entry;
+
+    /* Only unused entries are in the LRU queue, oldest at the tail */
+    while ((screen_info->frame_cache_bytes > max_bytes) &&
+           !g_queue_is_empty (screen_info->frame_lru))
+    {
+        entry = (FrameSideEntry *) g_queue_pop_tail (screen_info->frame_lru);
+        entry->lru_link = NULL;
+        g_hash_table_remove (screen_info->frame_cache, entry);
+        screen_info->frame_cache_bytes -= side_entry_bytes (entry);
+        TRACE ("evicting side %i [%ix%i]", entry->side, entry->width, entry->height);
+        side_entry_free (entry);
+    }
+}
+
+static FrameSideEntry *
+side_cache_lookup (ScreenInfo *screen_info, int side, int state, int width, int height)
+{
+    FrameSideEntry key;
+    FrameSideEntry *entry;
+
+    TRACE ("side %i [%ix%i]", side, width, height);
+
+    if ((width < 1) || (height < 1))
+    {
+        return NULL;
+    }
+
+    if (screen_info->frame_cache == NULL)
+    {
+        screen_info->frame_cache = g_hash_table_new (side_entry_hash, side_entry_equal);
+        screen_info->frame_lru = g_queue_new ();
+        screen_info->frame_cache_bytes = 0;
+    }
+
+    key.side = side;
+    key.state = state;
+    key.width = width;
+    key.height = height;
+
+    entry = g_hash_table_lookup (screen_info->frame_cache, &key);
+    if (entry)
+    {
+        if (entry->lru_link)
+        {
+            g_queue_delete_link (screen_info->frame_lru, entry->lru_link);
+            entry->lru_link = NULL;
+        }
+        entry->ref_count++;
+
+        return entry;
+    }
+
+    entry = g_slice_new0 (FrameSideEntry);
+    entry->side = side;
+    entry->state = state;
+    entry->width = width;
+    entry->height = height;
+    xfwmPixmapCreate (screen_info, &entry->pixmap, width, height);
+    xfwmPixmapFill (&screen_info->sides[side][state], &entry->pixmap, 0, 0, width, height);
+    entry->ref_count = 1;
+
+    g_hash_table_insert (screen_info->frame_cache, entry, entry);
+    screen_info->frame_cache_bytes += side_entry_bytes (entry);
+
+    return entry;
+}
+
+static void
+side_cache_release (ScreenInfo *screen_info, FrameSideEntry *entry)
+{
+    g_return_if_fail (entry != NULL);
+    g_return_if_fail (entry->ref_count > 0);
+
+    entry->ref_count--;
+    if (entry->ref_count > 0)
+    {
+        return;
+    }
+
+    if (entry->orphan)
+    {
+        side_entry_free (entry);
+    }
+    else
+    {
+        g_queue_push_head (screen_info->frame_lru, entry);
+        entry->lru_link = g_queue_peek_head_link (screen_info->frame_lru);
+        side_cache_trim (screen_info, FRAME_CACHE_MAX_BYTES);
+    }
+}
+
+static gboolean
+side_cache_remove_cb (gpointer key, gpointer value, gpointer user_data)
+{
+    FrameSideEntry *entry = (FrameSideEntry *) value;
+
+    if (entry->ref_count > 0)
+    {
+        /* Still set on some frame, freed when released */
+        entry->orphan = TRUE;
+    }
+    else
+    {
+        side_entry_free (entry);
+    }
+
+    return TRUE;
+}
+
+static xfwmPixmap *
+frameGetSidePixmap (Client * c, int state, int side, int width, int height)
+{
+    ScreenInfo *screen_info;
+    FramePixmap *frame_pix;
+    FrameSideEntry *entry;
+
+    g_return_val_if_fail (c, NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    screen_info = c->screen_info;
+    frame_pix = &c->frame_pix[state];
+    entry = frame_pix->sides[side];
+
+    /* Sides only depend on their size, keep them if it has not changed */
+    if (!entry || (entry->width != width) || (entry->height != height))
+    {
+        if (entry)
+        {
+            side_cache_release (screen_info, entry);
+        }
+        entry = side_cache_lookup (screen_info, side, state, width, height);
+        frame_pix->sides[side] = entry;
+    }
+
+    return (entry ? &entry->pixmap : NULL);
+}
+
+static Pixmap
+frameSideMask (FramePixmap * frame_pix, int side)
+{
+    if (side == SIDE_TOP)
+    {
+        return frame_pix->pm_top.mask;
+    }
+
+    return (frame_pix->sides[side] ? frame_pix->sides[side]->pixmap.mask : None);
+}
+
 static void
 frameFillTitlePixmap (Client * c, int state, int part, int x, int w, int h, xfwmPixmap * title_pm, xfwmPixmap * top_pm)
 {
@@ -136,10 +405,36 @@ frameFillTitlePixmap (Client * c, int state, int part, int x, int w, int h, xfwm
     xfwmPixmapFill (&screen_info->title[part][state], title_pm, x, 0, w, frameDecorationTop(screen_info));
 }
 
+static PangoLayout *
+frameGetTitleLayout (Client * c)
+{
+    ScreenInfo *screen_info;
+
+    screen_info = c->screen_info;
+    if ((c->title_layout) && (c->title_font_serial == screen_info->font_serial))
+    {
+        return c->title_layout;
+    }
+    frameClearTitleLayout (c);
+
+    c->title_layout = gtk_widget_create_pango_layout (myScreenGetGtkWidget (screen_info), c->name);
+    pango_layout_set_font_description (c->title_layout, myScreenGetFontDescription (screen_info));
+    pango_layout_set_auto_dir (c->title_layout, FALSE);
+    if (screen_info->pango_attr_list != NULL)
+    {
+        pango_layout_set_attributes (c->title_layout, screen_info->pango_attr_list);
+    }
+    c->title_font_serial = screen_info->font_serial;
+
+    return c->title_layout;
+}
+
 static void
-frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap * title_pm, xfwmPixmap * top_pm)
+frameCreateTitlePixmap (Client * c, int state, int left, int right, FramePixmap * frame_pix)
 {
     ScreenInfo *screen_info;
+    xfwmPixmap *title_pm;
+    xfwmPixmap *top_pm;
     cairo_surface_t *surface;
     cairo_t *cr;
     PangoLayout *layout;
@@ -149,11 +444,12 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
     int title_height, top_height;
 
     g_return_if_fail (c);
-    g_return_if_fail (title_pm);
-    g_return_if_fail (top_pm);
+    g_return_if_fail (frame_pix);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
     screen_info = c->screen_info;
+    title_pm = &frame_pix->pm_title;
+    top_pm = &frame_pix->pm_top;
 
     if (left > right)
     {
@@ -165,6 +461,8 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
     width = frameWidth (c) - frameTopLeftWidth (c, state) - frameTopRightWidth (c, state);
     if (width < 1)
     {
+        frameReservePixmap (screen_info, top_pm, frame_pix->top_size, 0, 0);
+        frameReservePixmap (screen_info, title_pm, frame_pix->title_size, 0, 0);
         return;
     }
 
@@ -196,13 +494,7 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
         voffset = screen_info->params->title_vertical_offset_inactive;
     }
 
-    layout = gtk_widget_create_pango_layout (myScreenGetGtkWidget (screen_info), c->name);
-    pango_layout_set_font_description (layout, myScreenGetFontDescription (screen_info));
-    pango_layout_set_auto_dir (layout, FALSE);
-    if (screen_info->pango_attr_list != NULL)
-    {
-        pango_layout_set_attributes (layout, screen_info->pango_attr_list);
-    }
+    layout = frameGetTitleLayout (c);
     pango_layout_get_pixel_extents (layout, NULL, &logical_rect);
 
     title_height = logical_rect.height;
@@ -289,8 +581,10 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
         }
     }
 
-    xfwmPixmapCreate (screen_info, top_pm, width, top_height);
-    xfwmPixmapCreate (screen_info, title_pm, width, frameDecorationTop(screen_info));
+    frameReservePixmap (screen_info, top_pm, frame_pix->top_size,
+                        width, top_height);
+    frameReservePixmap (screen_info, title_pm, frame_pix->title_size,
+                        width, frameDecorationTop(screen_info));
 
     surface = xfwmPixmapCreateSurface (title_pm, FALSE);
     cr = cairo_create (surface);
@@ -349,7 +643,6 @@ frameCreateTitlePixmap (Client * c, int state, int left, int right, xfwmPixmap *
     }
     cairo_destroy (cr);
     cairo_surface_destroy (surface);
-    g_object_unref (G_OBJECT (layout));
 }
 
 static int
@@ -455,15 +748,199 @@ getLetterFromButton (int i, Client * c)
     return chr;
 }
 
+static xfwmWindow *
+frameGetPart (Client * c, int part)
+{
+    if (part == FRAME_PART_TITLE)
+    {
+        return &c->title;
+    }
+    else if (part < CORNER_COUNT)
+    {
+        return &c->corners[part];
+    }
+
+    return &c->sides[part - CORNER_COUNT];
+}
+
+static gboolean
+frameGetPartArea (Client * c, int part_id, XRectangle * area)
+{
+    xfwmWindow *part;
+    int frame_height, sy, h;
+
+    part = frameGetPart (c, part_id);
+    if (!xfwmWindowVisible (part) || !part->pixmap || xfwmPixmapNone (part->pixmap))
+    {
+        return FALSE;
+    }
+
+    frame_height = frameHeight (c);
+    sy = 0;
+    h = MIN (part->height, part->pixmap->height);
+
+    /* Same as the corner shapes in frameSetShape(), for small windows */
+    if ((part_id == CORNER_TOP_LEFT) || (part_id == CORNER_TOP_RIGHT))
+    {
+        h = MIN (h, frame_height - frameBottom (c) + 1);
+    }
+    else if ((part_id == CORNER_BOTTOM_LEFT) || (part_id == CORNER_BOTTOM_RIGHT))
+    {
+        sy = MAX (0, h - (frame_height - frameTop (c) + 1));
+    }
+
+    /* Relative to the part, the copy starts at (0, y) */
+    area->x = 0;
+    area->y = sy;
+    area->width = MAX (0, MIN (part->width, part->pixmap->width));
+    area->height = MAX (0, h - sy);
+
+    return ((area->width > 0) && (area->height > 0));
+}
+
 static void
-frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTTON_COUNT])
+frameDrawParts (Client * c, XRectangle * exposed)
+{
+    ScreenInfo *screen_info;
+    DisplayInfo *display_info;
+    xfwmWindow *part;
+    XRectangle area;
+    GC gc;
+    int x0, y0, x1, y1;
+    guint i;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    screen_info = c->screen_info;
+    display_info = screen_info->display_info;
+    gc = XCreateGC (display_info->dpy, c->frame, 0, NULL);
+
+    /* Copy the parts bottom to top, straight from their own pixmaps */
+    for (i = 0; i < G_N_ELEMENTS (frame_parts); i++)
+    {
+        if (!frameGetPartArea (c, frame_parts[i], &area))
+        {
+            continue;
+        }
+        part = frameGetPart (c, frame_parts[i]);
+
+        x0 = part->x + area.x;
+        y0 = part->y + area.y;
+        x1 = x0 + area.width;
+        y1 = y0 + area.height;
+        if (exposed)
+        {
+            x0 = MAX (x0, exposed->x);
+            y0 = MAX (y0, exposed->y);
+            x1 = MIN (x1, exposed->x + exposed->width);
+            y1 = MIN (y1, exposed->y + exposed->height);
+            if ((x1 <= x0) || (y1 <= y0))
+            {
+                continue;
+            }
+        }
+
+        if ((part->pixmap->mask != None) && (display_info->have_shape))
+        {
+            XSetClipMask (display_info->dpy, gc, part->pixmap->mask);
+            XSetClipOrigin (display_info->dpy, gc, part->x, part->y);
+        }
+        else
+        {
+            XSetClipMask (display_info->dpy, gc, None);
+        }
+        XCopyArea (display_info->dpy, part->pixmap->pixmap, c->frame, gc,
+                   x0 - part->x, y0 - part->y, x1 - x0, y1 - y0, x0, y0);
+    }
+
+    XFreeGC (display_info->dpy, gc);
+}
+
+static void
+frameSetPartShapes (Client * c)
+{
+    ScreenInfo *screen_info;
+    DisplayInfo *display_info;
+    xfwmWindow *part;
+    XRectangle area;
+    Pixmap mask;
+    GC gc;
+    guint i;
+
+    screen_info = c->screen_info;
+    display_info = screen_info->display_info;
+
+    for (i = 0; i < G_N_ELEMENTS (frame_parts); i++)
+    {
+        if (!frameGetPartArea (c, frame_parts[i], &area))
+        {
+            continue;
+        }
+        part = frameGetPart (c, frame_parts[i]);
+        mask = part->pixmap->mask;
+
+        if (mask == None)
+        {
+            area.x += part->x;
+            area.y += part->y;
+            XShapeCombineRectangles (display_info->dpy, screen_info->shape_win, ShapeBounding,
+                                     0, 0, &area, 1, ShapeUnion, Unsorted);
+        }
+        else if ((area.y == 0) && (area.width == part->pixmap->width) &&
+                 (area.height == part->pixmap->height))
+        {
+            XShapeCombineMask (display_info->dpy, screen_info->shape_win, ShapeBounding,
+                               part->x, part->y, mask, ShapeUnion);
+        }
+        else
+        {
+            /* Only part of the mask is in use, e.g. trimmed corners */
+            mask = XCreatePixmap (display_info->dpy, screen_info->xroot,
+                                  area.width, area.height, 1);
+            gc = XCreateGC (display_info->dpy, mask, 0, NULL);
+            XCopyArea (display_info->dpy, part->pixmap->mask, mask, gc,
+                       area.x, area.y, area.width, area.height, 0, 0);
+            XFreeGC (display_info->dpy, gc);
+            XShapeCombineMask (display_info->dpy, screen_info->shape_win, ShapeBounding,
+                               part->x + area.x, part->y + area.y, mask, ShapeUnion);
+            XFreePixmap (display_info->dpy, mask);
+        }
+    }
+}
+
+static void
+frameSetButtonShapes (Client * c, int state, int button_x[BUTTON_COUNT])
 {
     ScreenInfo *screen_info;
     DisplayInfo *display_info;
-    XRectangle rect;
     xfwmPixmap *my_pixmap;
     int i;
 
+    screen_info = c->screen_info;
+    display_info = screen_info->display_info;
+
+    for (i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (xfwmWindowVisible (&c->buttons[i]))
+        {
+            my_pixmap = clientGetButtonPixmap (c, i, clientGetButtonState (c, i, state));
+            XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->buttons[i]),
+                               ShapeBounding, 0, 0, my_pixmap->mask, ShapeSet);
+            XShapeCombineShape (display_info->dpy, screen_info->shape_win, ShapeBounding, button_x[i],
+                                (frameTop (c) - screen_info->buttons[i][state].height + 1) / 2,
+                                MYWINDOW_XWINDOW (c->buttons[i]), ShapeBounding, ShapeUnion);
+        }
+    }
+}
+
+static void
+frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTTON_COUNT])
+{
+    ScreenInfo *screen_info;
+    DisplayInfo *display_info;
+    XRectangle rect;
+
     g_return_if_fail (c != NULL);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
@@ -507,7 +984,12 @@ frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTT
         XShapeCombineShape (display_info->dpy, screen_info->shape_win, ShapeBounding, frameLeft (c),
                             frameTop (c), c->window, ShapeBounding, ShapeSet);
     }
-    if (frame_pix)
+    if (frame_pix && FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME))
+    {
+        frameSetPartShapes (c);
+        frameSetButtonShapes (c, state, button_x);
+    }
+    else if (frame_pix)
     {
         XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->title), ShapeBounding,
                            0, 0, frame_pix->pm_title.mask, ShapeSet);
@@ -516,26 +998,26 @@ frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTT
             if (xfwmWindowVisible (&c->sides[SIDE_LEFT]))
             {
                 XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->sides[SIDE_LEFT]),
-                                   ShapeBounding, 0, 0, frame_pix->pm_sides[SIDE_LEFT].mask, ShapeSet);
+                                   ShapeBounding, 0, 0, frameSideMask (frame_pix, SIDE_LEFT), ShapeSet);
             }
 
             if (xfwmWindowVisible (&c->sides[SIDE_RIGHT]))
             {
                 XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->sides[SIDE_RIGHT]),
-                                   ShapeBounding, 0, 0, frame_pix->pm_sides[SIDE_RIGHT].mask, ShapeSet);
+                                   ShapeBounding, 0, 0, frameSideMask (frame_pix, SIDE_RIGHT), ShapeSet);
             }
         }
 
         if (xfwmWindowVisible (&c->sides[SIDE_BOTTOM]))
         {
             XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->sides[SIDE_BOTTOM]),
-                               ShapeBounding, 0, 0, frame_pix->pm_sides[SIDE_BOTTOM].mask, ShapeSet);
+                               ShapeBounding, 0, 0, frameSideMask (frame_pix, SIDE_BOTTOM), ShapeSet);
         }
 
         if (xfwmWindowVisible (&c->sides[SIDE_TOP]))
         {
             XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->sides[SIDE_TOP]),
-                               ShapeBounding, 0, 0, frame_pix->pm_sides[SIDE_TOP].mask, ShapeSet);
+                               ShapeBounding, 0, 0, frameSideMask (frame_pix, SIDE_TOP), ShapeSet);
         }
 
         if (xfwmWindowVisible (&c->corners[CORNER_BOTTOM_LEFT]))
@@ -562,16 +1044,6 @@ frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTT
                                ShapeBounding, 0, 0, screen_info->corners[CORNER_TOP_RIGHT][state].mask, ShapeSet);
         }
 
-        for (i = 0; i < BUTTON_COUNT; i++)
-        {
-            if (xfwmWindowVisible (&c->buttons[i]))
-            {
-                my_pixmap = clientGetButtonPixmap (c, i, clientGetButtonState (c, i, state));
-                XShapeCombineMask (display_info->dpy, MYWINDOW_XWINDOW (c->buttons[i]),
-                                   ShapeBounding, 0, 0, my_pixmap->mask, ShapeSet);
-            }
-        }
-
         if (xfwmWindowVisible (&c->corners[CORNER_TOP_LEFT]) &&
             (screen_info->corners[CORNER_TOP_LEFT][state].height > frameHeight (c) - frameBottom (c) + 1))
         {
@@ -687,15 +1159,7 @@ frameSetShape (Client * c, int state, FramePixmap * frame_pix, int button_x[BUTT
                                 0, MYWINDOW_XWINDOW (c->corners[CORNER_TOP_RIGHT]), ShapeBounding, ShapeUnion);
         }
 
-        for (i = 0; i < BUTTON_COUNT; i++)
-        {
-            if (xfwmWindowVisible (&c->buttons[i]))
-            {
-                XShapeCombineShape (display_info->dpy, screen_info->shape_win, ShapeBounding, button_x[i],
-                                    (frameTop (c) - screen_info->buttons[i][state].height + 1) / 2,
-                                    MYWINDOW_XWINDOW (c->buttons[i]), ShapeBounding, ShapeUnion);
-            }
-        }
+        frameSetButtonShapes (c, state, button_x);
     }
     rect.x = 0;
     rect.y = 0;
@@ -712,7 +1176,7 @@ frameDrawWin (Client * c)
 {
     ScreenInfo *screen_info;
     DisplayInfo *display_info;
-    FramePixmap frame_pix;
+    FramePixmap *frame_pix;
     xfwmPixmap *my_pixmap;
     gint state, x, button, left, right;
     gint top_width, bottom_width, left_height, right_height;
@@ -891,15 +1355,11 @@ frameDrawWin (Client * c)
         right_height = frameHeight (c) - frameTop (c) -
             screen_info->corners[CORNER_BOTTOM_RIGHT][state].height;
 
-        xfwmPixmapInit (screen_info, &frame_pix.pm_title);
-        xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_TOP]);
-        xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_BOTTOM]);
-        xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_LEFT]);
-        xfwmPixmapInit (screen_info, &frame_pix.pm_sides[SIDE_RIGHT]);
+        frame_pix = &c->frame_pix[state];
 
         /* The title is always visible */
-        frameCreateTitlePixmap (c, state, left, right, &frame_pix.pm_title, &frame_pix.pm_sides[SIDE_TOP]);
-        xfwmWindowSetBG (&c->title, &frame_pix.pm_title);
+        frameCreateTitlePixmap (c, state, left, right, frame_pix);
+        xfwmWindowSetBG (&c->title, &frame_pix->pm_title);
         xfwmWindowShow (&c->title,
             frameTopLeftWidth (c, state), 0 - frameBorderTop (c), top_width,
             frameDecorationTop(screen_info), (requires_clearing | width_changed));
@@ -938,46 +1398,40 @@ frameDrawWin (Client * c)
             }
             else
             {
-                xfwmPixmapCreate (screen_info, &frame_pix.pm_sides[SIDE_LEFT],
-                    frameLeft (c), left_height);
-                xfwmPixmapFill (&screen_info->sides[SIDE_LEFT][state],
-                    &frame_pix.pm_sides[SIDE_LEFT],
-                    0, 0, frameLeft (c), left_height);
-                xfwmWindowSetBG (&c->sides[SIDE_LEFT],
-                    &frame_pix.pm_sides[SIDE_LEFT]);
+                my_pixmap = frameGetSidePixmap (c, state, SIDE_LEFT, frameLeft (c), left_height);
+                if (my_pixmap)
+                {
+                    xfwmWindowSetBG (&c->sides[SIDE_LEFT], my_pixmap);
+                }
                 xfwmWindowShow (&c->sides[SIDE_LEFT], 0, frameTop (c),
                     frameLeft (c), left_height, (requires_clearing | height_changed));
 
-                xfwmPixmapCreate (screen_info, &frame_pix.pm_sides[SIDE_RIGHT],
-                    frameRight (c), right_height);
-                xfwmPixmapFill (&screen_info->sides[SIDE_RIGHT][state],
-                    &frame_pix.pm_sides[SIDE_RIGHT],
-                    0, 0, frameRight (c), right_height);
-                xfwmWindowSetBG (&c->sides[SIDE_RIGHT],
-                    &frame_pix.pm_sides[SIDE_RIGHT]);
+                my_pixmap = frameGetSidePixmap (c, state, SIDE_RIGHT, frameRight (c), right_height);
+                if (my_pixmap)
+                {
+                    xfwmWindowSetBG (&c->sides[SIDE_RIGHT], my_pixmap);
+                }
                 xfwmWindowShow (&c->sides[SIDE_RIGHT],
                     frameWidth (c) - frameRight (c), frameTop (c), frameRight (c),
                     right_height, (requires_clearing | height_changed));
             }
 
-            xfwmPixmapCreate (screen_info, &frame_pix.pm_sides[SIDE_BOTTOM],
-                bottom_width, frameBottom (c));
-            xfwmPixmapFill (&screen_info->sides[SIDE_BOTTOM][state],
-                &frame_pix.pm_sides[SIDE_BOTTOM],
-                0, 0, bottom_width, frameBottom (c));
-            xfwmWindowSetBG (&c->sides[SIDE_BOTTOM],
-                &frame_pix.pm_sides[SIDE_BOTTOM]);
+            my_pixmap = frameGetSidePixmap (c, state, SIDE_BOTTOM, bottom_width, frameBottom (c));
+            if (my_pixmap)
+            {
+                xfwmWindowSetBG (&c->sides[SIDE_BOTTOM], my_pixmap);
+            }
             xfwmWindowShow (&c->sides[SIDE_BOTTOM],
                 screen_info->corners[CORNER_BOTTOM_LEFT][state].width,
                 frameHeight (c) - frameBottom (c), bottom_width, frameBottom (c),
                 (requires_clearing | width_changed));
 
-            if (!xfwmPixmapNone(&frame_pix.pm_sides[SIDE_TOP]))
+            if (frame_pix->pm_top.height > 0)
             {
-                xfwmWindowSetBG (&c->sides[SIDE_TOP], &frame_pix.pm_sides[SIDE_TOP]);
+                xfwmWindowSetBG (&c->sides[SIDE_TOP], &frame_pix->pm_top);
                 xfwmWindowShow (&c->sides[SIDE_TOP],
                     screen_info->corners[CORNER_TOP_LEFT][state].width,
-                    0, top_width, frame_pix.pm_sides[SIDE_TOP].height,
+                    0, top_width, frame_pix->pm_top.height,
                     (requires_clearing | width_changed));
             }
             else
@@ -1012,13 +1466,11 @@ frameDrawWin (Client * c)
                 screen_info->corners[CORNER_BOTTOM_RIGHT][state].height,
                 requires_clearing);
         }
-        frameSetShape (c, state, &frame_pix, button_x);
-
-        xfwmPixmapFree (&frame_pix.pm_title);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_TOP]);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_BOTTOM]);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_LEFT]);
-        xfwmPixmapFree (&frame_pix.pm_sides[SIDE_RIGHT]);
+        if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME))
+        {
+            frameDrawParts (c, NULL);
+        }
+        frameSetShape (c, state, frame_pix, button_x);
     }
     else
     {
@@ -1028,14 +1480,14 @@ frameDrawWin (Client * c)
         }
         for (i = 0; i < 4; i++)
         {
-            if (MYWINDOW_XWINDOW (c->sides[i]) && xfwmWindowVisible (&c->sides[i]))
+            if (xfwmWindowVisible (&c->sides[i]))
             {
                 xfwmWindowHide (&c->sides[i]);
             }
         }
         for (i = 0; i < 4; i++)
         {
-            if (MYWINDOW_XWINDOW (c->corners[i]) && xfwmWindowVisible (&c->corners[i]))
+            if (xfwmWindowVisible (&c->corners[i]))
             {
                 xfwmWindowHide (&c->corners[i]);
             }
@@ -1054,16 +1506,46 @@ frameDrawWin (Client * c)
 }
 
 static gboolean
-update_frame_idle_cb (gpointer data)
+update_frames_idle_cb (gpointer data)
 {
+    ScreenInfo *screen_info;
     Client *c;
+    GList *list, *pending;
 
-    c = (Client *) data;
-    g_return_val_if_fail (c, FALSE);
-    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+    screen_info = (ScreenInfo *) data;
+    g_return_val_if_fail (screen_info, FALSE);
+    TRACE ("entering");
 
-    frameDrawWin (c);
-    c->frame_timeout_id = 0;
+    screen_info->frame_queue_id = 0;
+
+    /*
+     * Draw the visible frames top down first, frameDrawWin() takes each
+     * client off the queue.  Hidden clients (other workspaces, iconified)
+     * stay queued and are drawn when shown again, see clientShowSingle().
+     */
+    for (list = g_list_last (screen_info->windows_stack); list; list = g_list_previous (list))
+    {
+        c = (Client *) list->data;
+        if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAW_QUEUED) &&
+            FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE))
+        {
+            frameDrawWin (c);
+        }
+    }
+
+    /* Visible clients not in the stack yet */
+    pending = g_list_copy (screen_info->frame_queue);
+    for (list = pending; list; list = g_list_next (list))
+    {
+        c = (Client *) list->data;
+        if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE))
+        {
+            frameDrawWin (c);
+        }
+    }
+    g_list_free (pending);
+
+    XFlush (myScreenGetXDisplay (screen_info));
 
     return FALSE;
 }
@@ -1340,16 +1822,172 @@ frameExtentHeight (Client * c)
 void
 frameClearQueueDraw (Client * c)
 {
+    ScreenInfo *screen_info;
+
+    g_return_if_fail (c);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAW_QUEUED))
+    {
+        screen_info = c->screen_info;
+        screen_info->frame_queue = g_list_remove (screen_info->frame_queue, c);
+        FLAG_UNSET (c->xfwm_flags, XFWM_FLAG_DRAW_QUEUED);
+    }
+}
+
+void
+frameFreePixmaps (Client * c)
+{
+    FramePixmap *frame_pix;
+    int state, i;
+
     g_return_if_fail (c);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    if (c->frame_timeout_id)
+    for (state = 0; state < 2; state++)
     {
-        g_source_remove (c->frame_timeout_id);
-        c->frame_timeout_id = 0;
+        frame_pix = &c->frame_pix[state];
+        xfwmPixmapFree (&frame_pix->pm_title);
+        frame_pix->title_size[0] = 0;
+        frame_pix->title_size[1] = 0;
+        xfwmPixmapFree (&frame_pix->pm_top);
+        frame_pix->top_size[0] = 0;
+        frame_pix->top_size[1] = 0;
+        for (i = 0; i < SIDE_COUNT; i++)
+        {
+            if (frame_pix->sides[i])
+            {
+                side_cache_release (c->screen_info, frame_pix->sides[i]);
+                frame_pix->sides[i] = NULL;
+            }
+        }
     }
 }
 
+void
+frameExpose (Client * c, XExposeEvent * ev)
+{
+    XRectangle exposed;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (!FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME) || !CLIENT_HAS_FRAME (c))
+    {
+        return;
+    }
+
+    exposed.x = ev->x;
+    exposed.y = ev->y;
+    exposed.width = ev->width;
+    exposed.height = ev->height;
+
+    myDisplayErrorTrapPush (c->screen_info->display_info);
+    frameDrawParts (c, &exposed);
+    myDisplayErrorTrapPopIgnored (c->screen_info->display_info);
+}
+
+int
+frameGetPartAt (Client * c, int x, int y)
+{
+    xfwmWindow *part;
+    guint i;
+
+    g_return_val_if_fail (c != NULL, NO_HANDLE);
+
+    if (!FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAWN_FRAME))
+    {
+        return NO_HANDLE;
+    }
+
+    /* Topmost part first, ignoring the transparent pixels of the parts */
+    for (i = G_N_ELEMENTS (frame_parts); i-- > 0;)
+    {
+        part = frameGetPart (c, frame_parts[i]);
+        if (xfwmWindowVisible (part) &&
+            (x >= part->x) && (x < part->x + part->width) &&
+            (y >= part->y) && (y < part->y + part->height))
+        {
+            return frame_parts[i];
+        }
+    }
+
+    return NO_HANDLE;
+}
+
+void
+frameUpdateCursor (Client * c, int x, int y)
+{
+    DisplayInfo *display_info;
+    Cursor cursor;
+    int part;
+
+    g_return_if_fail (c != NULL);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    part = frameGetPartAt (c, x, y);
+    cursor = (part == NO_HANDLE) ? None : frameGetPart (c, part)->cursor;
+    if (cursor == c->frame_cursor)
+    {
+        return;
+    }
+    c->frame_cursor = cursor;
+
+    display_info = c->screen_info->display_info;
+    myDisplayErrorTrapPush (display_info);
+    if (cursor != None)
+    {
+        XDefineCursor (display_info->dpy, c->frame, cursor);
+    }
+    else
+    {
+        XUndefineCursor (display_info->dpy, c->frame);
+    }
+    myDisplayErrorTrapPopIgnored (display_info);
+}
+
+void
+frameClearTitleLayout (Client * c)
+{
+    g_return_if_fail (c);
+    TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
+
+    if (c->title_layout)
+    {
+        g_object_unref (G_OBJECT (c->title_layout));
+        c->title_layout = NULL;
+    }
+}
+
+void
+frameFlushCache (ScreenInfo *screen_info)
+{
+    Client *c;
+    guint i;
+
+    g_return_if_fail (screen_info);
+    TRACE ("entering");
+
+    /* The decorations of the theme going away cannot be reused */
+    for (c = screen_info->clients, i = 0; i < screen_info->client_count; c = c->next, i++)
+    {
+        frameFreePixmaps (c);
+    }
+
+    if (screen_info->frame_cache == NULL)
+    {
+        return;
+    }
+
+    /* The theme is going away, none of the sides can be reused */
+    g_queue_free (screen_info->frame_lru);
+    screen_info->frame_lru = NULL;
+    g_hash_table_foreach_remove (screen_info->frame_cache, side_cache_remove_cb, NULL);
+    g_hash_table_destroy (screen_info->frame_cache);
+    screen_info->frame_cache = NULL;
+    screen_info->frame_cache_bytes = 0;
+}
+
 void
 frameDraw (Client * c, gboolean clear_all)
 {
@@ -1366,23 +2004,26 @@ frameDraw (Client * c, gboolean clear_all)
 void
 frameQueueDraw (Client * c, gboolean clear_all)
 {
+    ScreenInfo *screen_info;
+
     g_return_if_fail (c);
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    /* Reschedule update */
-    if (c->frame_timeout_id)
-    {
-        frameClearQueueDraw (c);
-    }
+    screen_info = c->screen_info;
     if (clear_all)
     {
         FLAG_SET (c->xfwm_flags, XFWM_FLAG_NEEDS_REDRAW);
     }
-    /* Otherwise leave previous schedule */
-    if (c->frame_timeout_id == 0)
+    /* Batch with the other pending redraws of the screen */
+    if (!FLAG_TEST (c->xfwm_flags, XFWM_FLAG_DRAW_QUEUED))
+    {
+        FLAG_SET (c->xfwm_flags, XFWM_FLAG_DRAW_QUEUED);
+        screen_info->frame_queue = g_list_prepend (screen_info->frame_queue, c);
+    }
+    if (screen_info->frame_queue_id == 0)
     {
-        c->frame_timeout_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                                              update_frame_idle_cb, c, NULL);
+        screen_info->frame_queue_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                                      update_frames_idle_cb, screen_info, NULL);
     }
 }
 
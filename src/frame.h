@@ -32,6 +32,9 @@
 #include "mypixmap.h"
 #include "client.h"
 
+/* Part of a drawn frame under the pointer, besides corners and sides */
+#define FRAME_PART_TITLE (CORNER_COUNT + SIDE_COUNT)
+
 int                      frameDecorationLeft                    (ScreenInfo *);
 int                      frameDecorationRight                   (ScreenInfo *);
 int                      frameDecorationTop                     (ScreenInfo *);
@@ -58,5 +61,16 @@ void                     frameQueueDraw                         (Client *,
                                                                  gboolean);
 void                     frameDraw                              (Client *,
                                                                  gboolean);
+void                     frameFreePixmaps                       (Client *);
+void                     frameClearTitleLayout                  (Client *);
+void                     frameFlushCache                        (ScreenInfo *);
+void                     frameExpose                            (Client *,
+                                                                 XExposeEvent *);
+int                      frameGetPartAt                         (Client *,
+                                                                 int,
+                                                                 int);
+void                     frameUpdateCursor                      (Client *,
+                                                                 int,
+                                                                 int);
 
 #endif /* INC_FRAME_H */
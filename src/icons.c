@@ -555,68 +555,149 @@ getAppIcon (Client *c, guint width, guint height)
     return default_icon_at_size (screen_info->gscr, width, height);
 }
 
-GdkPixbuf *
+/* Takes over the given reference */
+static GdkPixbuf *
+iconified_pixbuf (GdkPixbuf *pixbuf)
+{
+    GdkPixbuf *stated;
+
+    stated = gdk_pixbuf_copy (pixbuf);
+    gdk_pixbuf_saturate_and_pixelate (pixbuf, stated, 0.55, TRUE);
+    g_object_unref (pixbuf);
+
+    return stated;
+}
+
+/*
+ * Same as gdk_pixbuf_saturate_and_pixelate (0.55, TRUE) over an opaque
+ * area, done by the server when the target is an Xlib surface.
+ */
+static void
+saturate_and_pixelate_area (cairo_t *cr, gint x, gint y, gint width, gint height)
+{
+    cairo_surface_t *checker;
+    cairo_pattern_t *pattern;
+    unsigned char *data;
+    int stride;
+
+    cairo_save (cr);
+    cairo_rectangle (cr, x, y, width, height);
+    cairo_clip (cr);
+
+    /* Gray over the saturation keeps 55% of it */
+    cairo_set_operator (cr, CAIRO_OPERATOR_HSL_SATURATION);
+    cairo_set_source_rgba (cr, 0.5, 0.5, 0.5, 0.45);
+    cairo_paint (cr);
+
+    /* Every other pixel darkened to 70% */
+    checker = cairo_image_surface_create (CAIRO_FORMAT_A8, 2, 2);
+    cairo_surface_flush (checker);
+    data = cairo_image_surface_get_data (checker);
+    stride = cairo_image_surface_get_stride (checker);
+    data[0] = 0x4c;
+    data[1] = 0x00;
+    data[stride] = 0x00;
+    data[stride + 1] = 0x4c;
+    cairo_surface_mark_dirty (checker);
+
+    pattern = cairo_pattern_create_for_surface (checker);
+    cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
+    cairo_pattern_set_filter (pattern, CAIRO_FILTER_NEAREST);
+    cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+    cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+    cairo_mask (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_surface_destroy (checker);
+
+    cairo_restore (cr);
+}
+
+/*
+ * The window preview with the application icon on top. When the
+ * compositor has a thumbnail, the icon is an Xlib surface built on the
+ * server from it.
+ */
+cairo_surface_t *
 getClientIcon (Client *c, guint width, guint height)
 {
     ScreenInfo *screen_info;
-    GdkPixbuf *app_content;
+    cairo_surface_t *app_content;
+    cairo_surface_t *icon_surface;
+    GdkPixbuf *default_icon;
     GdkPixbuf *small_icon;
-    GdkPixbuf *icon_pixbuf;
-    GdkPixbuf *icon_pixbuf_stated;
+    cairo_t *cr;
     guint small_icon_size;
-    guint app_icon_width, app_icon_height;
-    Pixmap pixmap;
+    gint app_icon_width, app_icon_height;
+    gboolean iconified;
 
     g_return_val_if_fail (c != NULL, NULL);
 
     screen_info = c->screen_info;
-    icon_pixbuf = NULL;
-    app_icon_width = width; /* Set to 0 to use gdk pixbuf scaling */
-    app_icon_height = height; /* Set to 0 to use gdk pixbuf scaling */
+    iconified = FLAG_TEST (c->flags, CLIENT_FLAG_ICONIFIED);
 
-    icon_pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, width, height);
-    gdk_pixbuf_fill (icon_pixbuf, 0x00);
-
-    pixmap = compositorGetWindowPixmapAtSize (screen_info, c->frame, &app_icon_width, &app_icon_height);
-    if (pixmap != None)
+    /* The compositor keeps the thumbnails, no need to fetch them each time */
+    app_content = compositorGetWindowThumbnail (screen_info, c->frame, width, height);
+    if (app_content)
     {
-        app_content = try_pixmap_and_mask (screen_info, pixmap, None, width, height);
-        XFreePixmap (myScreenGetXDisplay (screen_info), pixmap);
+        icon_surface = cairo_surface_create_similar (app_content, CAIRO_CONTENT_COLOR_ALPHA,
+                                                     width, height);
+        app_icon_width = cairo_xlib_surface_get_width (app_content);
+        app_icon_height = cairo_xlib_surface_get_height (app_content);
     }
     else
     {
-        app_content = default_icon_at_size (screen_info->gscr, width, height);
+        icon_surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+        app_icon_width = 0;
+        app_icon_height = 0;
     }
+    cr = cairo_create (icon_surface);
 
-    app_icon_width = (guint) gdk_pixbuf_get_width (app_content);
-    app_icon_height = (guint) gdk_pixbuf_get_height (app_content);
-
-    gdk_pixbuf_copy_area (app_content, 0, 0, app_icon_width, app_icon_height, icon_pixbuf,
-                          (width - app_icon_width) / 2, (height - app_icon_height) / 2);
-    g_object_unref (app_content);
+    if (app_content)
+    {
+        cairo_set_source_surface (cr, app_content,
+                                  (width - app_icon_width) / 2, (height - app_icon_height) / 2);
+        cairo_paint (cr);
+        cairo_surface_destroy (app_content);
+        if (iconified)
+        {
+            saturate_and_pixelate_area (cr, (width - app_icon_width) / 2, (height - app_icon_height) / 2,
+                                        app_icon_width, app_icon_height);
+        }
+    }
+    else
+    {
+        default_icon = default_icon_at_size (screen_info->gscr, width, height);
+        if (default_icon)
+        {
+            if (iconified)
+            {
+                default_icon = iconified_pixbuf (default_icon);
+            }
+            gdk_cairo_set_source_pixbuf (cr, default_icon,
+                                         (width - gdk_pixbuf_get_width (default_icon)) / 2,
+                                         (height - gdk_pixbuf_get_height (default_icon)) / 2);
+            cairo_paint (cr);
+            g_object_unref (default_icon);
+        }
+    }
 
     small_icon_size = MIN (width / 4, height / 4);
     small_icon_size = MIN (small_icon_size, 48);
 
     small_icon = getAppIcon (c, small_icon_size, small_icon_size);
+    if (iconified)
+    {
+        small_icon = iconified_pixbuf (small_icon);
+    }
 
-    gdk_pixbuf_composite (small_icon, icon_pixbuf,
-                          (width - small_icon_size) / 2, height - small_icon_size,
-                          small_icon_size, small_icon_size,
-                          (width - small_icon_size) / 2, height - small_icon_size,
-                          1.0, 1.0,
-                          GDK_INTERP_BILINEAR,
-                          0xff);
-
+    gdk_cairo_set_source_pixbuf (cr, small_icon,
+                                 (width - small_icon_size) / 2, height - small_icon_size);
+    cairo_rectangle (cr, (width - small_icon_size) / 2, height - small_icon_size,
+                     small_icon_size, small_icon_size);
+    cairo_fill (cr);
     g_object_unref (small_icon);
 
-    if (FLAG_TEST (c->flags, CLIENT_FLAG_ICONIFIED))
-    {
-        icon_pixbuf_stated = gdk_pixbuf_copy (icon_pixbuf);
-        gdk_pixbuf_saturate_and_pixelate (icon_pixbuf, icon_pixbuf_stated, 0.55, TRUE);
-        g_object_unref (icon_pixbuf);
-        icon_pixbuf = icon_pixbuf_stated;
-    }
+    cairo_destroy (cr);
 
-    return icon_pixbuf;
+    return icon_surface;
 }
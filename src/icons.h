@@ -38,7 +38,7 @@
 GdkPixbuf               *getAppIcon                             (Client *,
                                                                  guint,
                                                                  guint);
-GdkPixbuf               *getClientIcon                          (Client *,
+cairo_surface_t         *getClientIcon                          (Client *,
                                                                  guint,
                                                                  guint);
 
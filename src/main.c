@@ -166,6 +166,9 @@ handleSignal (int sig)
             case SIGUSR1:
                 display_info->reload = TRUE;
                 break;
+            case SIGUSR2:
+                display_info->dump_stats = TRUE;
+                break;
             default:
                 break;
         }
@@ -188,6 +191,7 @@ setupHandler (gboolean install)
     sigaction (SIGTERM, &act, NULL);
     sigaction (SIGHUP,  &act, NULL);
     sigaction (SIGUSR1, &act, NULL);
+    sigaction (SIGUSR2, &act, NULL);
 }
 
 static void
@@ -465,6 +469,10 @@ vblank_callback (const gchar  *name,
     {
         vblank_mode = VBLANK_GLX;
     }
+    else if (strcmp (value, "glx-scene") == 0)
+    {
+        vblank_mode = VBLANK_GLX_SCENE;
+    }
     else
 #endif /* HAVE_EPOXY */
     if (strcmp (value, "off") == 0)
@@ -72,6 +72,9 @@ xfwmWindowInit (xfwmWindow * win)
     win->y = 0;
     win->width = 1;
     win->height = 1;
+    win->is_virtual = FALSE;
+    win->pixmap = NULL;
+    win->cursor = None;
 #ifdef HAVE_RENDER
     win->pict_format = NULL;
 #endif
@@ -87,6 +90,7 @@ xfwmWindowSetCursor (xfwmWindow * win, Cursor cursor)
 
     screen_info = win->screen_info;
     display_info = screen_info->display_info;
+    win->cursor = cursor;
 
     if ((win->window != None) && (cursor != None))
     {
@@ -127,6 +131,8 @@ xfwmWindowCreate (ScreenInfo * screen_info, Visual *visual, gint depth, Window p
     win->y = 0;
     win->width = 1;
     win->height = 1;
+    win->is_virtual = FALSE;
+    win->pixmap = NULL;
     xfwmWindowSetVisual (win, visual, depth);
     xfwmWindowSetCursor (win, cursor);
 #ifdef HAVE_RENDER
@@ -139,6 +145,21 @@ xfwmWindowCreate (ScreenInfo * screen_info, Visual *visual, gint depth, Window p
 #endif
 }
 
+void
+xfwmWindowCreateVirtual (ScreenInfo * screen_info, Visual *visual, gint depth,
+                         xfwmWindow * win, Cursor cursor)
+{
+    TRACE ("virtual window %p", win);
+
+    g_return_if_fail (screen_info != NULL);
+
+    xfwmWindowInit (win);
+    win->screen_info = screen_info;
+    win->is_virtual = TRUE;
+    xfwmWindowSetVisual (win, visual, depth);
+    xfwmWindowSetCursor (win, cursor);
+}
+
 void
 xfwmWindowDelete (xfwmWindow * win)
 {
@@ -151,6 +172,8 @@ xfwmWindowDelete (xfwmWindow * win)
         win->window = None;
     }
     win->map = FALSE;
+    win->is_virtual = FALSE;
+    win->pixmap = NULL;
 }
 
 void
@@ -162,7 +185,7 @@ xfwmWindowShow (xfwmWindow * win, int x, int y, int width, int height,
 
     TRACE ("win %p (0x%lx) at (%i,%i) [%i×%i]", win, win->window, x, y, width, height);
 
-    if (!(win->window))
+    if (!(win->window) && !(win->is_virtual))
     {
         return;
     }
@@ -171,6 +194,16 @@ xfwmWindowShow (xfwmWindow * win, int x, int y, int width, int height,
         xfwmWindowHide (win);
         return;
     }
+    if (win->is_virtual)
+    {
+        /* Only keep track of the geometry, the parent draws the window */
+        win->map = TRUE;
+        win->x = x;
+        win->y = y;
+        win->width = width;
+        win->height = height;
+        return;
+    }
 
     screen_info = win->screen_info;
     display_info = screen_info->display_info;
@@ -232,8 +265,11 @@ xfwmWindowHide (xfwmWindow * win)
 
     if (win->map)
     {
-        g_assert (win->window);
-        XUnmapWindow (myScreenGetXDisplay (win->screen_info), win->window);
+        if (!(win->is_virtual))
+        {
+            g_assert (win->window);
+            XUnmapWindow (myScreenGetXDisplay (win->screen_info), win->window);
+        }
         win->map = FALSE;
     }
 }
@@ -291,6 +327,9 @@ xfwmWindowTemp (ScreenInfo *screen_info, Visual *visual,
     win->y = y;
     win->width = width;
     win->height = height;
+    win->is_virtual = FALSE;
+    win->pixmap = NULL;
+    win->cursor = None;
     xfwmWindowSetVisual (win, visual, depth);
 #ifdef HAVE_XI2
     xfwm_device_configure_xi2_event_mask (screen_info->display_info->devices,
@@ -359,6 +398,12 @@ xfwmWindowSetBG (xfwmWindow * win, xfwmPixmap * pix)
     DisplayInfo *display_info;
     gboolean done;
 
+    if (win->is_virtual)
+    {
+        win->pixmap = pix;
+        return;
+    }
+
     if ((win->width < 1) || (win->height < 1) || (pix->width < 1) || (pix->height < 1))
     {
         return;
@@ -52,6 +52,10 @@ struct _xfwmWindow
     gint x, y;
     gint width, height;
     gboolean map;
+    /* Virtual windows have no X window, their parent draws them */
+    gboolean is_virtual;
+    xfwmPixmap *pixmap;
+    Cursor cursor;
 };
 
 void                     xfwmWindowInit                         (xfwmWindow *);
@@ -64,6 +68,11 @@ void                     xfwmWindowCreate                       (ScreenInfo *,
                                                                  xfwmWindow *,
                                                                  long,
                                                                  Cursor);
+void                     xfwmWindowCreateVirtual                (ScreenInfo *,
+                                                                 Visual *,
+                                                                 gint,
+                                                                 xfwmWindow *,
+                                                                 Cursor);
 void                     xfwmWindowTemp                         (ScreenInfo *,
                                                                  Visual *,
                                                                  gint,
@@ -1631,6 +1631,7 @@ clientAddUserTimeWin (Client * c)
         myDisplayErrorTrapPush (display_info);
         XSelectInput (display_info->dpy, c->user_time_win, PropertyChangeMask);
         myDisplayErrorTrapPopIgnored (display_info);
+        myDisplayAddClientWindow (display_info, c->user_time_win, c);
     }
 }
 
@@ -1653,5 +1654,6 @@ clientRemoveUserTimeWin (Client * c)
         myDisplayErrorTrapPush (display_info);
         XSelectInput (display_info->dpy, c->user_time_win, NoEventMask);
         myDisplayErrorTrapPopIgnored (display_info);
+        myDisplayRemoveClientWindow (display_info, c->user_time_win, c);
     }
 }
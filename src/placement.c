@@ -541,10 +541,93 @@ clientAutoMaximize (Client * c, int full_w, int full_h)
 }
 
 static void
-smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
+remove_placement_rect (ScreenInfo *screen_info, Client *c)
+{
+    guint i;
+
+    for (i = 0; i < screen_info->placement_rects->len; i++)
+    {
+        if (g_array_index (screen_info->placement_rects, PlacementRect, i).c == c)
+        {
+            g_array_remove_index (screen_info->placement_rects, i);
+            return;
+        }
+    }
+}
+
+/*
+ * The frames of the visible windows are kept sorted by their left edge
+ * as windows are configured, shown and hidden, so that placing a window
+ * does not walk the whole client list, recompute the frame extents and
+ * sort them for every window placed.
+ */
+void
+clientUpdatePlacementRect (Client *c)
 {
-    Client *c2;
     ScreenInfo *screen_info;
+    PlacementRect rect;
+    GArray *rects;
+    guint lo, hi, mid;
+
+    g_return_if_fail (c != NULL);
+
+    screen_info = c->screen_info;
+    rects = screen_info->placement_rects;
+    remove_placement_rect (screen_info, c);
+
+    if ((c->type == WINDOW_DESKTOP) || !FLAG_TEST (c->xfwm_flags, XFWM_FLAG_VISIBLE))
+    {
+        return;
+    }
+
+    rect.c = c;
+    rect.x0 = frameExtentX (c);
+    rect.y0 = frameExtentY (c);
+    rect.x1 = rect.x0 + frameExtentWidth (c);
+    rect.y1 = rect.y0 + frameExtentHeight (c);
+
+    lo = 0;
+    hi = rects->len;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (g_array_index (rects, PlacementRect, mid).x0 <= rect.x0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    g_array_insert_val (rects, lo, rect);
+}
+
+void
+clientRemovePlacementRect (Client *c)
+{
+    g_return_if_fail (c != NULL);
+
+    remove_placement_rect (c->screen_info, c);
+}
+
+static gboolean
+placement_rect_ignored (Client * c, PlacementRect *r, int full_x, int full_y, int full_w, int full_h)
+{
+    if ((r->c == c) || (r->c->win_workspace != c->win_workspace))
+    {
+        return TRUE;
+    }
+    /* skip clients right-of, left-of, above-of or below-of monitor */
+    return (r->x0 >= full_x + full_w || r->x1 < full_x ||
+            r->y0 >= full_y + full_h || r->y1 < full_y);
+}
+
+static void
+smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
+{
+    PlacementRect *r;
+    GArray *rects;
     gfloat best_overlaps;
     guint i;
     gint test_x, test_y, xmax, ymax, best_x, best_y;
@@ -556,7 +639,6 @@ smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
 
     TRACE ("client \"%s\" (0x%lx)", c->name, c->window);
 
-    screen_info = c->screen_info;
     frame_height = frameExtentHeight (c);
     frame_width = frameExtentWidth (c);
     frame_left = frameExtentLeft(c);
@@ -575,7 +657,8 @@ smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
     best_x = xmin;
     best_y = ymin;
 
-    TRACE ("analyzing %i clients", screen_info->client_count);
+    rects = c->screen_info->placement_rects;
+    TRACE ("analyzing %i clients", rects->len);
 
     test_y = ymin;
     do
@@ -592,75 +675,71 @@ smartPlacement (Client * c, int full_x, int full_y, int full_w, int full_h)
             gint next_test_x = G_MAXINT;
             gint c2_next_test_x;
             gint c2_next_test_y;
-            gint c2_frame_height;
-            gint c2_frame_width;
 
             TRACE ("testing x position %d", test_x);
 
-            for (c2 = screen_info->clients, i = 0; i < screen_info->client_count; c2 = c2->next, i++)
+            for (i = 0; i < rects->len; i++)
             {
-                if ((c2 != c) && (c2->type != WINDOW_DESKTOP)
-                    && (c->win_workspace == c2->win_workspace)
-                    && FLAG_TEST (c2->xfwm_flags, XFWM_FLAG_VISIBLE))
+                r = &g_array_index (rects, PlacementRect, i);
+                if (placement_rect_ignored (c, r, full_x, full_y, full_w, full_h))
                 {
-                    c2_x = frameExtentX (c2);
-                    c2_frame_width = frameExtentWidth (c2);
-                    if (c2_x >= full_x + full_w
-                        || c2_x + c2_frame_width < full_x)
-                    {
-                        /* skip clients on right-of or left-of monitor */
-                        continue;
-                    }
-
-                    c2_y = frameExtentY (c2);
-                    c2_frame_height = frameExtentHeight (c2);
-                    if (c2_y >= full_y + full_h
-                        || c2_y + c2_frame_height < full_y)
-                    {
-                        /* skip clients on above-of or below-of monitor */
-                        continue;
-                    }
+                    continue;
+                }
 
-                    count_overlaps += overlap (test_x - frame_left,
-                                               test_y - frame_top,
-                                               test_x - frame_left + frame_width,
-                                               test_y - frame_top + frame_height,
-                                               c2_x,
-                                               c2_y,
-                                               c2_x + c2_frame_width,
-                                               c2_y + c2_frame_height);
-
-                    /* find the next x boundy for the step */
-                    if (test_x > c2_x)
-                    {
-                        /* test location is beyond the x of the window,
-                         * take the window right corner as next target */
-                        c2_x += c2_frame_width;
-                    }
-                    c2_next_test_x = MIN (c2_x, xmax);
+                if (!first_test_x && (r->x0 >= test_x - frame_left + frame_width))
+                {
+                    /* windows further right do not overlap and, as they are
+                     * sorted by x, this one holds the nearest x step left */
+                    c2_next_test_x = MIN (r->x0, xmax);
                     if (c2_next_test_x < next_test_x
                         && c2_next_test_x > test_x)
                     {
-                        /* set new optimal next x step position */
                         next_test_x = c2_next_test_x;
                     }
+                    break;
+                }
 
-                    if (first_test_x)
+                count_overlaps += overlap (test_x - frame_left,
+                                           test_y - frame_top,
+                                           test_x - frame_left + frame_width,
+                                           test_y - frame_top + frame_height,
+                                           r->x0,
+                                           r->y0,
+                                           r->x1,
+                                           r->y1);
+
+                /* find the next x boundy for the step */
+                c2_x = r->x0;
+                if (test_x > c2_x)
+                {
+                    /* test location is beyond the x of the window,
+                     * take the window right corner as next target */
+                    c2_x = r->x1;
+                }
+                c2_next_test_x = MIN (c2_x, xmax);
+                if (c2_next_test_x < next_test_x
+                    && c2_next_test_x > test_x)
+                {
+                    /* set new optimal next x step position */
+                    next_test_x = c2_next_test_x;
+                }
+
+                if (first_test_x)
+                {
+                    /* find the next y boundry step */
+                    c2_y = r->y0;
+                    if (test_y > c2_y)
                     {
-                        /* find the next y boundry step */
-                        if (test_y > c2_y)
-                        {
-                            /* test location is beyond the y of the window,
-                             * take the window bottom corner as next target */
-                            c2_y += c2_frame_height;
-                        }
-                        c2_next_test_y = MIN (c2_y, ymax);
-                        if (c2_next_test_y < next_test_y
-                            && c2_next_test_y > test_y)
-                        {
-                            /* set new optimal next y step position */
-                            next_test_y = c2_next_test_y;
-                        }
+                        /* test location is beyond the y of the window,
+                         * take the window bottom corner as next target */
+                        c2_y = r->y1;
+                    }
+                    c2_next_test_y = MIN (c2_y, ymax);
+                    if (c2_next_test_y < next_test_y
+                        && c2_next_test_y > test_y)
+                    {
+                        /* set new optimal next y step position */
+                        next_test_y = c2_next_test_y;
                     }
                 }
             }
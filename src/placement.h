@@ -35,6 +35,14 @@
 #define CLIENT_CONSTRAINED_LEFT    1<<2
 #define CLIENT_CONSTRAINED_RIGHT   1<<3
 
+/* Frame extents of a window taken into account for placement */
+typedef struct _PlacementRect PlacementRect;
+struct _PlacementRect
+{
+    Client *c;
+    gint x0, y0, x1, y1;
+};
+
 gboolean                 strutsToRectangles                     (Client *,
                                                                  GdkRectangle * /* left */,
                                                                  GdkRectangle * /* right */,
@@ -51,6 +59,8 @@ void                     clientMaxSpace                         (ScreenInfo *,
 unsigned int             clientConstrainPos                     (Client *,
                                                                  gboolean);
 void                     clientInitPosition                     (Client *);
+void                     clientUpdatePlacementRect              (Client *);
+void                     clientRemovePlacementRect              (Client *);
 void                     clientFill                             (Client *,
                                                                  int);
 
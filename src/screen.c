@@ -51,6 +51,7 @@
 #include "misc.h"
 #include "mywindow.h"
 #include "compositor.h"
+#include "placement.h"
 #include "ui_style.h"
 
 #ifndef WM_EXITING_TIMEOUT
@@ -247,6 +248,7 @@ myScreenInit (DisplayInfo *display_info, GdkScreen *gscr, unsigned long event_ma
     screen_info->windows = NULL;
     screen_info->clients = NULL;
     screen_info->client_count = 0;
+    screen_info->placement_rects = g_array_new (FALSE, FALSE, sizeof (PlacementRect));
     screen_info->client_serial = 0L;
     screen_info->button_handler_id = 0L;
 
@@ -306,6 +308,8 @@ myScreenInit (DisplayInfo *display_info, GdkScreen *gscr, unsigned long event_ma
 
     screen_info->font_desc = NULL;
     screen_info->pango_attr_list = NULL;
+    screen_info->frame_queue = NULL;
+    screen_info->frame_queue_id = 0;
     screen_info->box_gc = None;
 
     for (i = 0; i < SIDE_COUNT; i++)
@@ -351,6 +355,13 @@ myScreenClose (ScreenInfo *screen_info)
     display_info = screen_info->display_info;
 
     clientUnframeAll (screen_info);
+    if (screen_info->frame_queue_id)
+    {
+        g_source_remove (screen_info->frame_queue_id);
+        screen_info->frame_queue_id = 0;
+    }
+    g_list_free (screen_info->frame_queue);
+    screen_info->frame_queue = NULL;
     compositorUnmanageScreen (screen_info);
     closeSettings (screen_info);
 
@@ -382,6 +393,9 @@ myScreenClose (ScreenInfo *screen_info)
     g_list_free (screen_info->windows_stack);
     screen_info->windows_stack = NULL;
 
+    g_array_free (screen_info->placement_rects, TRUE);
+    screen_info->placement_rects = NULL;
+
     g_list_free (screen_info->windows);
     screen_info->windows = NULL;
 
@@ -900,5 +914,6 @@ myScreenUpdateFontAttr (ScreenInfo *screen_info)
     screen_info->pango_attr_list = pango_attr_list_new ();
     attr = pango_attr_scale_new (scale);
     pango_attr_list_insert (screen_info->pango_attr_list, attr);
+    screen_info->font_serial++;
 }
 
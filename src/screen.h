@@ -65,7 +65,7 @@
 #ifdef HAVE_COMPOSITOR
 
 #ifdef HAVE_PRESENT_EXTENSION
-#define N_BUFFERS 2
+#define N_BUFFERS 3
 #else
 #define N_BUFFERS 1
 #endif /* HAVE_PRESENT_EXTENSION */
@@ -76,6 +76,62 @@ struct _gaussian_conv {
 };
 typedef struct _gaussian_conv gaussian_conv;
 
+/* One set per opacity level of the presummed shadow tables */
+#define SHADOW_SLICE_LEVELS 26
+
+struct _shadow_slices {
+    Picture corners;
+    Picture top;
+    Picture bottom;
+    Picture left;
+    Picture right;
+    Picture center;
+#ifdef HAVE_EPOXY
+    /* The same slices in a single texture, for the GL scene */
+    GLuint texture;
+#endif /* HAVE_EPOXY */
+};
+typedef struct _shadow_slices shadow_slices;
+
+/* Frames of damage kept to repair aged GLX back buffers */
+#define GLX_DAMAGE_HISTORY 4
+
+/* Frame time histogram buckets: < 1, 2, 4, 8, 16, 32, 64 ms and above */
+#define FRAME_STATS_BUCKETS 8
+
+struct _frame_stats {
+    guint64 frames;
+    guint64 frame_time;
+    guint64 frame_time_max;
+    guint64 frame_time_histogram[FRAME_STATS_BUCKETS];
+    /* CPU time used by the compositor while painting, in μs */
+    guint64 cpu_time;
+    guint64 damaged_area;
+    guint64 windows_painted;
+    guint64 windows_skipped;
+    guint64 damage_culled;
+    guint64 shadows_built;
+    /* Time spent building them, in μs */
+    guint64 shadow_time;
+    guint64 retries;
+    guint64 throttled;
+    guint64 present_wait;
+    guint64 gl_wait;
+    /* Start of the current wait, if any */
+    gint64 present_wait_start;
+    gint64 gl_wait_start;
+    /* Time spent with a window unredirected versus composited, in μs */
+    guint64 scanout_time;
+    guint64 composited_time;
+    guint64 scanout_entered;
+    guint64 scanout_left;
+    gint64 scanout_mode_start;
+    /* X requests sent while painting, and clip changes found redundant */
+    guint64 requests;
+    guint64 clips_reused;
+};
+typedef struct _frame_stats frame_stats;
+
 #endif /* HAVE_COMPOSITOR */
 
 typedef enum
@@ -84,6 +140,7 @@ typedef enum
     VBLANK_AUTO,
     VBLANK_XPRESENT,
     VBLANK_GLX,
+    VBLANK_GLX_SCENE,
     VBLANK_ERROR,
 } vblankMode;
 
@@ -95,9 +152,14 @@ struct _ScreenInfo
     /* Window stacking, per screen */
     GList *windows_stack;
     Client *last_raise;
+    /* Clients waiting for a frame redraw, see frameQueueDraw() */
+    GList *frame_queue;
+    guint frame_queue_id;
     GList *windows;
     Client *clients;
     guint client_count;
+    /* Frames of the visible clients sorted by x, see clientUpdatePlacementRect() */
+    GArray *placement_rects;
     unsigned long client_serial;
     gint key_grabs;
     gint pointer_grabs;
@@ -111,12 +173,19 @@ struct _ScreenInfo
     xfwmPixmap title[TITLE_COUNT][2];
     xfwmPixmap top[TITLE_COUNT][2];
 
+    /* Side decorations shared by frames of the same size, see frame.c */
+    GHashTable *frame_cache;
+    GQueue *frame_lru;
+    gsize frame_cache_bytes;
+
     /* Per screen graphic contexts */
     GC box_gc;
 
     /* Title font */
     PangoFontDescription *font_desc;
     PangoAttrList *pango_attr_list;
+    /* Bumped whenever the title font changes, see frameGetTitleLayout() */
+    guint font_serial;
 
     /* Screen data */
     Colormap cmap;
@@ -187,14 +256,22 @@ struct _ScreenInfo
     Window overlay;
     Window root_overlay;
 #endif
-    GList *cwindows;
+    /* Compositor windows in stacking order, top first */
+    GPtrArray *cwindows;
     GHashTable *cwindow_hash;
+    /* Windows left with a visible part, top to bottom, not owned */
+    GPtrArray *visible_windows;
     Window output;
 
     gaussian_conv *gaussianMap;
     gint gaussianSize;
+    gdouble *gaussianSum;
     guchar *shadowCorner;
     guchar *shadowTop;
+    shadow_slices *shadowSlices[SHADOW_SLICE_LEVELS];
+    GHashTable *shadow_cache;
+    GQueue *shadow_lru;
+    gsize shadow_cache_bytes;
 
     gushort current_buffer;
     gushort use_n_buffers;
@@ -204,38 +281,82 @@ struct _ScreenInfo
     Picture rootPicture;
     Picture blackPicture;
     Picture rootTile;
-    XserverRegion screenRegion;
-    XserverRegion prevDamage;
-    XserverRegion allDamage;
+    cairo_region_t *screenRegion;
+    /* Last clip set on a picture while painting, see set_paint_clip_region () */
+    Picture clip_picture;
+    cairo_region_t *clip_region;
+    gboolean clip_valid;
+    /* Damage each root buffer missed since it was last painted */
+    cairo_region_t *bufferDamage[N_BUFFERS];
+    /* Zoomed view and cursor each root buffer was last presented with */
+    XTransform bufferTransform[N_BUFFERS];
+    XRectangle bufferCursor[N_BUFFERS];
+    cairo_region_t *allDamage;
+    /* Window damage collected on the server, fetched once per frame */
+    XserverRegion windowDamage;
+    XserverRegion damageParts;
+    gboolean windowDamagePending;
     unsigned long cursorSerial;
     Picture cursorPicture;
     gint cursorOffsetX;
     gint cursorOffsetY;
     XRectangle cursorLocation;
     gboolean cursor_is_zoomed;
+    /* Cursor images by serial, the current one is cursorPicture */
+    GHashTable *cursor_cache;
+    /* Zoomed cursor drawn over the output, outside of the scene */
+    XRectangle cursorOutput;
+    gboolean cursor_damaged;
 
     guint wins_unredirected;
+    /* Fullscreen window unredirected by the scanout policy, and the next in line */
+    Window scanout_window;
+    Window scanout_candidate;
+    gint64 scanout_candidate_time;
+    guint scanout_candidate_damage;
+    gint64 scanout_retry_time;
+    guint scanout_timeout_id;
+    guint wins_culled;
     gboolean compositor_active;
     gboolean clipChanged;
 
     gboolean damages_pending;
 
     guint compositor_timeout_id;
+    gint64 vblank_time;
+    guint64 vblank_msc;
+    gint64 refresh_interval;
+    frame_stats stats;
 
     XTransform transform;
     gboolean zoomed;
     guint zoom_timeout_id;
+    /* Pointer motion is reported by XI2 raw events instead of polled */
+    gboolean zoom_raw_motion;
+    /* Offset of the zoomed view and pending shift of the last frame, in pixels */
+    gint zoom_offset_x;
+    gint zoom_offset_y;
+    gint zoom_shift_x;
+    gint zoom_shift_y;
     gboolean use_glx;
     gboolean use_present;
 
     vblankMode vblank_mode;
 
 #ifdef HAVE_EPOXY
+    /* Windows are drawn by GL from their own pixmaps */
+    gboolean use_glx_scene;
+    gboolean glx_background_valid;
     gboolean texture_inverted;
     gboolean has_mesa_swap_control;
     gboolean has_ext_swap_control;
     gboolean has_ext_swap_control_tear;
     gboolean has_ext_arb_sync;
+    gboolean has_ext_buffer_age;
+    gboolean has_mesa_copy_sub_buffer;
+    gboolean has_oml_sync_control;
+    /* Damage of the last frames, most recent first */
+    cairo_region_t *glx_damage[GLX_DAMAGE_HISTORY];
 
     GLuint rootTexture;
     GLenum texture_format;
@@ -244,6 +365,7 @@ struct _ScreenInfo
     GLfloat texture_filter;
     GLXDrawable glx_drawable[N_BUFFERS];
     GLXFBConfig glx_fbconfig;
+    GLXFBConfig glx_fbconfig_argb;
     GLXContext glx_context;
     GLXWindow glx_window;
     GLsync gl_sync;
@@ -253,7 +375,14 @@ struct _ScreenInfo
 #endif /* HAVE_EPOXY */
 
 #ifdef HAVE_PRESENT_EXTENSION
-    gboolean present_pending;
+    /* Number of presents not completed yet */
+    guint present_pending;
+    gint64 present_start[N_BUFFERS];
+    /* Adaptive buffering, measured since the last decision */
+    guint adapt_frames;
+    gint64 adapt_latency;
+    gint64 adapt_paint_time;
+    guint64 adapt_area;
 #endif /* HAVE_PRESENT_EXTENSION */
 
 #endif /* HAVE_COMPOSITOR */
@@ -42,6 +42,7 @@
 #include "focus.h"
 #include "workspaces.h"
 #include "compositor.h"
+#include "frame.h"
 #include "ui_style.h"
 
 #define CHANNEL_XFWM            "xfwm4"
@@ -672,6 +673,7 @@ loadSettings (ScreenInfo *screen_info)
         {"button_offset", NULL, G_TYPE_INT, TRUE},
         {"button_spacing", NULL, G_TYPE_INT, TRUE},
         {"click_to_focus", NULL, G_TYPE_BOOLEAN, TRUE},
+        {"composited_decorations", NULL, G_TYPE_BOOLEAN, TRUE},
         {"cycle_apps_only", NULL, G_TYPE_BOOLEAN, TRUE},
         {"cycle_draw_frame", NULL, G_TYPE_BOOLEAN, TRUE},
         {"cycle_raise", NULL, G_TYPE_BOOLEAN, TRUE},
@@ -708,6 +710,7 @@ loadSettings (ScreenInfo *screen_info)
         {"raise_on_click", NULL, G_TYPE_BOOLEAN, TRUE},
         {"raise_on_focus", NULL, G_TYPE_BOOLEAN, TRUE},
         {"raise_with_any_button", NULL, G_TYPE_BOOLEAN, TRUE},
+        {"repaint_lead_time", NULL, G_TYPE_INT, TRUE},
         {"repeat_urgent_blink", NULL, G_TYPE_BOOLEAN, TRUE},
         {"resize_opacity", NULL, G_TYPE_INT, TRUE},
         {"scroll_workspaces", NULL, G_TYPE_BOOLEAN, TRUE},
@@ -736,6 +739,7 @@ loadSettings (ScreenInfo *screen_info)
         {"title_vertical_offset_active", NULL, G_TYPE_INT, TRUE},
         {"title_vertical_offset_inactive", NULL, G_TYPE_INT, TRUE},
         {"toggle_workspaces", NULL, G_TYPE_BOOLEAN, TRUE},
+        {"unredirect_fullscreen", NULL, G_TYPE_BOOLEAN, TRUE},
         {"unredirect_overlays", NULL, G_TYPE_BOOLEAN, TRUE},
         {"urgent_blink", NULL, G_TYPE_BOOLEAN, TRUE},
         {"use_compositing", NULL, G_TYPE_BOOLEAN, TRUE},
@@ -769,6 +773,8 @@ loadSettings (ScreenInfo *screen_info)
         getBoolValue ("box_move", rc);
     screen_info->params->click_to_focus =
         getBoolValue ("click_to_focus", rc);
+    screen_info->params->composited_decorations =
+        getBoolValue ("composited_decorations", rc);
     screen_info->params->cycle_apps_only =
         getBoolValue ("cycle_apps_only", rc);
     screen_info->params->cycle_minimum =
@@ -807,6 +813,8 @@ loadSettings (ScreenInfo *screen_info)
         getBoolValue ("raise_on_click", rc);
     screen_info->params->raise_with_any_button =
         getBoolValue ("raise_with_any_button", rc);
+    screen_info->params->repaint_lead_time =
+        CLAMP (getIntValue ("repaint_lead_time", rc), 0, 50);
     screen_info->params->repeat_urgent_blink =
         getBoolValue ("repeat_urgent_blink", rc);
     screen_info->params->urgent_blink =
@@ -845,6 +853,8 @@ loadSettings (ScreenInfo *screen_info)
         getBoolValue ("tile_on_move", rc);
     screen_info->params->toggle_workspaces =
         getBoolValue ("toggle_workspaces", rc);
+    screen_info->params->unredirect_fullscreen =
+        getBoolValue ("unredirect_fullscreen", rc);
     screen_info->params->unredirect_overlays =
         getBoolValue ("unredirect_overlays", rc);
     screen_info->params->use_compositing =
@@ -928,6 +938,7 @@ unloadTheme (ScreenInfo *screen_info)
 
     TRACE ("entering");
 
+    frameFlushCache (screen_info);
     if (screen_info->font_desc != NULL)
     {
         pango_font_description_free (screen_info->font_desc);
@@ -1236,6 +1247,10 @@ cb_xfwm4_channel_property_changed(XfconfChannel *channel, const gchar *property_
                 {
                     screen_info->params->cycle_tabwin_mode = CLAMP (g_value_get_int(value), 0, 1);
                 }
+                else if (!strcmp (name, "repaint_lead_time"))
+                {
+                    screen_info->params->repaint_lead_time = CLAMP (g_value_get_int(value), 0, 50);
+                }
                 else if ((!strcmp (name, "button_offset"))
                       || (!strcmp (name, "button_spacing"))
                       || (!strcmp (name, "double_click_time"))
@@ -1352,6 +1367,11 @@ cb_xfwm4_channel_property_changed(XfconfChannel *channel, const gchar *property_
                 {
                     screen_info->params->cycle_workspaces = g_value_get_boolean (value);
                 }
+                else if (!strcmp (name, "composited_decorations"))
+                {
+                    /* Applies to the windows framed from now on */
+                    screen_info->params->composited_decorations = g_value_get_boolean (value);
+                }
                 else if (!strcmp (name, "cycle_apps_only"))
                 {
                     screen_info->params->cycle_apps_only = g_value_get_boolean (value);
@@ -1412,6 +1432,10 @@ cb_xfwm4_channel_property_changed(XfconfChannel *channel, const gchar *property_
                 {
                     screen_info->params->toggle_workspaces = g_value_get_boolean (value);
                 }
+                else if (!strcmp (name, "unredirect_fullscreen"))
+                {
+                    screen_info->params->unredirect_fullscreen = g_value_get_boolean (value);
+                }
                 else if (!strcmp (name, "unredirect_overlays"))
                 {
                     screen_info->params->unredirect_overlays = g_value_get_boolean (value);
@@ -193,6 +193,7 @@ struct _XfwmParams
     int placement_ratio;
     int popup_opacity;
     int raise_delay;
+    int repaint_lead_time;
     int resize_opacity;
     int shadow_delta_height;
     int shadow_delta_width;
@@ -209,6 +210,7 @@ struct _XfwmParams
     gboolean box_move;
     gboolean box_resize;
     gboolean click_to_focus;
+    gboolean composited_decorations;
     gboolean cycle_apps_only;
     gboolean cycle_draw_frame;
     gboolean cycle_raise;
@@ -239,6 +241,7 @@ struct _XfwmParams
     gboolean title_vertical_offset_active;
     gboolean title_vertical_offset_inactive;
     gboolean toggle_workspaces;
+    gboolean unredirect_fullscreen;
     gboolean unredirect_overlays;
     gboolean urgent_blink;
     gboolean use_compositing;
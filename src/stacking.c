@@ -36,6 +36,7 @@
 #include "client.h"
 #include "stacking.h"
 #include "netwm.h"
+#include "placement.h"
 #include "transients.h"
 #include "frame.h"
 #include "focus.h"
@@ -650,6 +651,7 @@ clientRemoveFromList (Client * c)
 
     screen_info->windows = g_list_remove (screen_info->windows, c);
     screen_info->windows_stack = g_list_remove (screen_info->windows_stack, c);
+    clientRemovePlacementRect (c);
 
     clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST], screen_info->windows);
     clientSetNetClientList (screen_info, display_info->atoms[NET_CLIENT_LIST_STACKING], screen_info->windows_stack);
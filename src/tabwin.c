@@ -317,27 +317,36 @@ tabwinSelectWidget (Tabwin *tabwin)
 }
 
 static GtkWidget *
-createWindowIcon (GdkScreen *screen, GdkPixbuf *icon_pixbuf, gint size, gint scale)
+createWindowIcon (GdkScreen *screen, cairo_surface_t *icon_surface, gint size, gint scale)
 {
     GtkIconTheme *icon_theme;
     GtkWidget * icon;
+    GdkPixbuf *icon_pixbuf;
     cairo_surface_t *surface;
 
     TRACE ("entering");
 
-    if (icon_pixbuf == NULL)
+    icon = gtk_image_new ();
+    if (icon_surface != NULL)
     {
-        icon_theme = gtk_icon_theme_get_for_screen (screen);
-        icon_pixbuf = gtk_icon_theme_load_icon (icon_theme, "xfwm4-default",
-                                                size * scale, 0, NULL);
+        gtk_image_set_from_surface (GTK_IMAGE (icon), icon_surface);
+        return icon;
     }
 
-    icon = gtk_image_new ();
+    icon_theme = gtk_icon_theme_get_for_screen (screen);
+    icon_pixbuf = gtk_icon_theme_load_icon (icon_theme, "xfwm4-default",
+                                            size * scale, 0, NULL);
+    if (icon_pixbuf == NULL)
+    {
+        return icon;
+    }
     surface = gdk_cairo_surface_create_from_pixbuf (icon_pixbuf, scale, NULL);
     if (surface != NULL) {
         gtk_image_set_from_surface (GTK_IMAGE (icon), surface);
         cairo_surface_destroy (surface);
     }
+    g_object_unref (icon_pixbuf);
+
     return icon;
 }
 
@@ -470,7 +479,7 @@ createWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
     GtkWidget *buttonbox;
     GtkWidget *buttonlabel;
     GtkWidget *selected_label;
-    GdkPixbuf *icon_pixbuf;
+    cairo_surface_t *icon_surface;
     gint packpos;
     gint label_width;
     gint size_request;
@@ -499,7 +508,7 @@ createWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
     {
         c = (Client *) client_list->data;
         TRACE ("adding \"%s\" (0x%lx)", c->name, c->window);
-        icon_pixbuf = (GdkPixbuf *) icon_list->data;
+        icon_surface = (cairo_surface_t *) icon_list->data;
         icon_list = g_list_next (icon_list);
 
         window_button = gtk_button_new ();
@@ -511,7 +520,7 @@ createWindowlist (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
                           G_CALLBACK (cb_window_button_leave), tabwin_widget);
         gtk_widget_add_events (window_button, GDK_ENTER_NOTIFY_MASK);
 
-        icon = createWindowIcon (screen_info->gscr, icon_pixbuf, tabwin->icon_size, tabwin->icon_scale);
+        icon = createWindowIcon (screen_info->gscr, icon_surface, tabwin->icon_size, tabwin->icon_scale);
         if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
         {
             gtk_widget_set_size_request (GTK_WIDGET (window_button), size_request, size_request);
@@ -641,6 +650,7 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
 {
     Tabwin *tabwin;
     GdkPixbuf *icon_pixbuf;
+    cairo_surface_t *icon_surface;
     PangoLayout *layout;
     GList *client_list;
     gint size_request;
@@ -731,26 +741,26 @@ computeTabwinData (ScreenInfo *screen_info, TabwinWidget *tabwin_widget)
     {
         Client *c = (Client *) client_list->data;
 
-        if (screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID)
+        /* No preview in list mode */
+        if ((screen_info->params->cycle_tabwin_mode == STANDARD_ICON_GRID) && (preview))
         {
-            if (preview)
-            {
-                icon_pixbuf = getClientIcon (c, tabwin->icon_size * tabwin->icon_scale,
-                                             tabwin->icon_size * tabwin->icon_scale);
-            }
-            else
-            {
-                icon_pixbuf = getAppIcon (c, tabwin->icon_size * tabwin->icon_scale,
+            /* Drawn from the thumbnail kept on the server */
+            icon_surface = getClientIcon (c, tabwin->icon_size * tabwin->icon_scale,
                                           tabwin->icon_size * tabwin->icon_scale);
-            }
+            cairo_surface_set_device_scale (icon_surface, tabwin->icon_scale, tabwin->icon_scale);
         }
         else
         {
-            /* No preview in list mode */
             icon_pixbuf = getAppIcon (c, tabwin->icon_size * tabwin->icon_scale,
                                       tabwin->icon_size * tabwin->icon_scale);
+            icon_surface = NULL;
+            if (icon_pixbuf)
+            {
+                icon_surface = gdk_cairo_surface_create_from_pixbuf (icon_pixbuf, tabwin->icon_scale, NULL);
+                g_object_unref (icon_pixbuf);
+            }
         }
-        tabwin->icon_list = g_list_append(tabwin->icon_list, icon_pixbuf);
+        tabwin->icon_list = g_list_append(tabwin->icon_list, icon_surface);
     }
 }
 
@@ -1323,6 +1333,6 @@ tabwinDestroy (Tabwin *tabwin)
         g_list_free (tabwin_widget->widgets);
         gtk_widget_destroy (GTK_WIDGET (tabwin_widget));
     }
-    g_list_free_full (tabwin->icon_list, g_object_unref);
+    g_list_free_full (tabwin->icon_list, (GDestroyNotify) cairo_surface_destroy);
     g_list_free (tabwin->tabwin_list);
 }